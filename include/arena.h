@@ -0,0 +1,79 @@
+/** @file arena.h
+ *  @brief Function prototypes for the arena the AST is allocated from.
+ *
+ *  Every exp, stmt and payload (exp_binary, stmt_if, array
+ *  literals, ...) of a parse comes from one arena, bumped out
+ *  of big blocks instead of a calloc each, so the nodes sit
+ *  next to each other in the order they were parsed. Nothing
+ *  in the tree is freed on its own: the whole arena goes at
+ *  once, with free_stmt on the root, or killReader if the
+ *  parse didn't finish.
+ *
+ *  The root statement is part of the arena itself, which is
+ *  how free_stmt finds the arena from it.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "structs.h"
+
+#define AST_BLOCK_SIZE (1 << 16)
+#define AST_ALIGN (sizeof(void *))
+
+struct ast_arena;
+
+/** @brief makes an empty arena, with its root statement
+ *
+ * @return the arena, or NULL if out of memory
+*/
+struct ast_arena *ast_arena_init(void);
+
+/** @brief the arena's root statement, zeroed (so STMT_EMPTY) to start with
+*/
+struct stmt *ast_arena_root(struct ast_arena *arena);
+
+/** @brief the arena a root statement belongs to
+ *
+ * @param root a root from ast_arena_root (what parse_file and
+ * 	friends return), and not any other statement
+*/
+struct ast_arena *ast_arena_of(struct stmt *root);
+
+/** @brief allocates size zeroed bytes from the arena
+ *
+ * @param arena the arena
+ * @param size how many bytes
+ * @return the memory, or NULL if out of memory
+*/
+void *ast_alloc(struct ast_arena *arena, size_t size);
+
+/** @brief resizes an allocation, growing or shrinking it in place if
+ * 	it's the last one made (as the array literal being parsed is)
+ *
+ * anything past old_size is zeroed, same as ast_alloc.
+ *
+ * @param arena the arena ptr came from
+ * @param ptr the allocation, or NULL to make a new one
+ * @param old_size the size it was allocated with
+ * @param size the size it should be
+ * @return the (maybe moved) allocation, or NULL if out of memory,
+ * 	in which case ptr is left alone
+*/
+void *ast_realloc(struct ast_arena *arena, void *ptr, size_t old_size, size_t size);
+
+/** @brief how many bytes have been allocated from the arena
+*/
+size_t ast_arena_used(const struct ast_arena *arena);
+
+/** @brief frees the arena, and so every node allocated from it
+ *
+ * @param arena the arena (can be NULL)
+*/
+void ast_arena_free(struct ast_arena *arena);
+
+#endif //ARENA_H
@@ -0,0 +1,100 @@
+/** @file bytecode.h
+ *  @brief Function prototypes for compiling brainf into bytecode.
+ *
+ *  There are two formats:
+ *  - the wide format, an array of struct bf_op, with runs of
+ *  	+-<> folded into one instruction and [-] turned into BF_CLEAR.
+ *  - the compact format, a byte stream where each instruction is
+ *  	one byte, the opcode in the top 3 bits and a 5 bit operand.
+ *  	An operand of BC_EXT means a varint (7 bits per byte, low
+ *  	bits first) follows with the real value.
+ *
+ *  In the compact format, add/move counts are zigzag encoded, and
+ *  both BF_JZ and BF_JNZ store the byte distance between the end
+ *  of the BF_JZ and the end of the BF_JNZ.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stddef.h>
+#include "structs.h"
+
+#define BC_OP_BITS 5
+#define BC_EXT 31
+#define BC_OP(byte) ((enum bf_opcode) ((byte) >> BC_OP_BITS))
+#define BC_SMALL(byte) ((unsigned int) ((byte) & BC_EXT))
+
+/** @brief reads a varint operand and moves the code pointer past it
+ *
+ * @param code the pointer to the first varint byte, updated in place
+ * @return the decoded operand
+ */
+static inline unsigned int bc_read_varint(const unsigned char **code) {
+	const unsigned char *p = *code;
+	unsigned int out = 0;
+	int shift = 0;
+	do {
+		out |= (unsigned int) (*p & 0x7f) << shift;
+		shift += 7;
+	} while (*p++ & 0x80);
+	*code = p;
+	return out;
+}
+
+static inline int bc_unzigzag(unsigned int v) {
+	return (int) (v >> 1) ^ -(int) (v & 1);
+}
+
+/** @brief reads a whole brainf source file into a null terminated buffer
+ *
+ * @param filename the file to read
+ * @param len set to the length of the source (can be NULL)
+ * @return the malloc'd source, or NULL if it can't be read
+ */
+char *bf_read_source(const char *filename, long *len);
+
+/** @brief compiles a brainf program into the wide format
+ *
+ * characters other than the 8 instructions are ignored,
+ * and the ops always end in a BF_END.
+ *
+ * @param src the brainf source
+ * @param len the length of the source
+ * @param prog the program to fill in
+ * @return ERR_OK, ERR_UNMATCHED_BRACKET or ERR_NO_MEM
+ */
+enum err_type bf_compile(const char *src, int len, struct bf_program *prog);
+
+/** @brief encodes the wide ops of a program into the compact format
+ *
+ * sets prog->code and prog->code_len
+ *
+ * @param prog the compiled program
+ * @return ERR_OK or ERR_NO_MEM
+ */
+enum err_type bf_encode_compact(struct bf_program *prog);
+
+/** @brief works out the tape window of every loop
+ *
+ * one pass with a stack of open loops. loops[i] is filled in
+ * for every BF_JZ i, and is only meaningful when pure is set.
+ * A loop is only pure if all its children are.
+ *
+ * @param ops the wide ops
+ * @param len the number of ops
+ * @param loops len entries to fill in
+ * @return the deepest loop nesting, or -1 if out of memory
+ */
+int bf_analyze_loops(const struct bf_op *ops, int len, struct bf_loop_info *loops);
+
+/** @brief frees the ops and code of a program
+ *
+ * @param prog the program to free the contents of
+ */
+void bf_free_program(struct bf_program *prog);
+
+#endif //BYTECODE_H
@@ -0,0 +1,83 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+/** @file debug.h
+ *  @brief Function prototypes for breakpoints and watchpoints.
+ *
+ *  The debugger patches BF_TRAP over the ops it cares about in
+ *  the compiled program, and keeps the originals so the
+ *  interpreter can run them after it's reported the trap.
+ *  Breakpoints patch the op at a source offset, watchpoints
+ *  patch every op that can write a cell (+, -, [-] and ',') and
+ *  check the pointer after it runs. Unpatched programs never
+ *  see a BF_TRAP, so they run exactly as before.
+ *
+ *  Debugged runs have to use the wide format, without memo.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include "structs.h"
+
+#define TRAP_BREAK 1
+#define TRAP_WATCH 2
+
+struct bf_debugger;
+
+/** @brief sets up a debugger for prog
+ *
+ * @param prog the program to patch, which has to outlive the debugger
+ * @return the debugger, or NULL if out of memory
+*/
+struct bf_debugger *debug_init(struct bf_program *prog);
+
+/** @brief sets a breakpoint on the last op starting at or before a source offset
+ *
+ * runs of +-<> are folded into one op, so a breakpoint inside
+ * a run stops at the start of it, before any of it has run.
+ *
+ * @param dbg the debugger
+ * @param src_offset the offset in the brainf source
+ * @return the patched op index, or -1 if there's no op at or before it
+*/
+int debug_break(struct bf_debugger *dbg, int src_offset);
+
+/** @brief stops the run whenever a tape cell changes
+ *
+ * @param dbg the debugger
+ * @param cell the tape index to watch (0 to BUFF_SIZE - 1)
+ * @return ERR_OK, or ERR_INV_VAL if cell is off the tape
+*/
+enum err_type debug_watch(struct bf_debugger *dbg, int cell);
+
+/** @brief points a run set up by interp_init at the patched program
+ *
+ * @param dbg the debugger
+ * @param ctx the run
+*/
+void debug_attach(const struct bf_debugger *dbg, struct interp_ctx *ctx);
+
+/** @brief prints what a run that returned INTERP_TRAP stopped on
+ *
+ * @param dbg the debugger
+ * @param ctx the run
+ * @param out where to print it
+*/
+void debug_report(struct bf_debugger *dbg, const struct interp_ctx *ctx, FILE *out);
+
+/** @brief prints how many times the traps were hit
+ *
+ * @param dbg the debugger
+ * @param out where to print it
+*/
+void debug_summary(const struct bf_debugger *dbg, FILE *out);
+
+/** @brief unpatches the program and frees the debugger
+ *
+ * @param dbg the debugger (can be NULL)
+*/
+void debug_free(struct bf_debugger *dbg);
+
+#endif //DEBUG_H
@@ -0,0 +1,35 @@
+#ifndef ELF_EMIT_H
+#define ELF_EMIT_H
+
+/** @file elf_emit.h
+ *  @brief Function prototypes for compiling brainf into a native executable.
+ *
+ *  This turns the wide bytecode (see bytecode.h) straight into
+ *  x86-64 machine code, and writes it out as a static ELF64
+ *  executable for linux, with no assembler, linker or libc.
+ *
+ *  The executable behaves like bfInterp without the final stack
+ *  dump: BUFF_SIZE int cells in .bss, a pointer that wraps around
+ *  the ends, ',' reading -1 at EOF, and io through raw read/write
+ *  syscalls.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include "structs.h"
+
+#define ELF_BASE_ADDR 0x400000
+#define ELF_PAGE_SIZE 0x1000
+
+/** @brief writes prog out as an executable at path
+ *
+ * the file is created (or truncated) with mode 0755.
+ *
+ * @param prog a program from bf_compile
+ * @param path where to write the executable
+ * @return ERR_OK, ERR_NO_FILE if path can't be written, or ERR_NO_MEM
+*/
+enum err_type bf_emit_elf(const struct bf_program *prog, const char *path);
+
+#endif //ELF_EMIT_H
@@ -19,17 +19,6 @@
 
 #define DEFAULT_CAP_SIZE 8
 
-/** @brief Frees a malloc'd expression.
- *  by default it's called by free_stmt.
- * It should set any internal variables
- * to null, and it should free any 
- * subexpressions, as well as any strings 
- * that are malloc'd
- * 
- * @param exp the expression to free
- */
-void free_exp(struct exp  *exp);
-
 /** @brief Prints an expression.
  * 
  * By default it's called by print_stmt.
@@ -37,18 +26,27 @@ void free_exp(struct exp  *exp);
  * the expression, along with any arguments
  * it holds.
  * 
+ * It goes through ast_walk (see walk.h), so
+ * it doesn't recurse however deep exp goes.
+ * 
  * @param exp the expression to free
  */
 void print_exp(const struct exp  *exp);
 
-/** @brief Malloc's and initializes an expression
+/** @brief the callbacks print_exp walks the tree with,
+ * 	which print_stmt passes the exps it comes across to
+ */
+extern const struct ast_visitor print_exp_visitor;
+
+/** @brief Allocates and initializes an expression
  * 
  * by default it's called by parser
  * functions that are creating subexpressions.
  * 
- * It should malloc the exp, set it's type to
- * EXP_EMPTY, and save a few things for error
- * printing 
+ * It should allocate the exp from lex->arena (see arena.h),
+ * set it's type to EXP_EMPTY, and save a few things for error
+ * printing. Nothing from the arena is freed on its own, it all
+ * goes with the root statement.
  * 
  * @param r the reader struct for if it fails
  * 	and to get the location from
@@ -70,7 +68,7 @@ struct exp *init_exp(struct lexer_ctx *lex);
  * @param exp the expression to update
  * @param tp the type of subexpression
  * 	(EXP_BINOP or EXPASSIGNOP, NOT EXP_UNARY)
- * @param left exp->op->left so the program errors it gets freed
+ * @param left exp->op->left
  * @throw ERR_NO_MEM if it fails to malloc the subexpression
  */
 void init_binary(struct lexer_ctx *lex, struct exp *exp, enum exp_type tp, struct exp *left);
@@ -102,7 +100,7 @@ void init_exp_unary(struct lexer_ctx *lex, struct exp *exp, bool is_prefix);
  * 
  * @param r the reader struct, for if it fails
  * @param exp the expression to update
- * @param name exp->array_ref->name so the program errors it gets freed
+ * @param name exp->array_ref->name
  * @throw ERR_NO_MEM if it fails to malloc the subexpression
  */
 void init_exp_array_ref(struct lexer_ctx *lex, struct exp *exp, struct exp *name);
@@ -125,13 +123,22 @@ void init_exp_array_ref(struct lexer_ctx *lex, struct exp *exp, struct exp *name
  */
 void init_exp_array_lit(struct lexer_ctx *lex, struct exp *exp, int size);
 
+/** @brief doubles the number of exps an array_lit has room for
+ *  called by parseArrayLit when it runs out.
+ * 
+ * @param r for if there's an error
+ * @param exp the exp to update (must be of type EXP_ARRAY_LIT)
+ * @throw ERR_NO_MEM if the arena is out of memory.
+ */
+void grow_exp_arraylit(struct lexer_ctx *lex, struct exp *exp);
+
 /** @brief sets the length of the array_lit to a final value
  *  called at the end of parseString and parseArrayLit to shorten the amount of memory used.
  * 
  * @param r for if there's an error
  * @param exp the exp to update (must be of type EXP_ARRAY_LIT)
  * @param final_len the final length to set it to.
- * @throw ERR_NO_MEM if the realloc fails.
+ * @throw ERR_NO_MEM if the arena is out of memory.
  */
 void set_exp_arraylit_len(struct lexer_ctx *lex, struct exp *exp, int final_len);
 
@@ -151,22 +158,10 @@ void set_exp_arraylit_len(struct lexer_ctx *lex, struct exp *exp, int final_len)
  */
 void init_exp_call(struct lexer_ctx *lex, struct exp *exp, enum key_type key);
 
-/** @brief swaps the  contents of two functions
- * 
- * by default it's called by a few
- * parse functions that update the "in" exp to
- * contain the previous in exp
- * 
- * It should swap the contents of the two functions
- * 
- * @param exp1 the two expressions to swap
- * @param exp2 the two expressions to swap
- */
-void swap_exps(struct exp *exp1, struct exp *exp2);
-
 /** @brief checks if two exps are equivalent
  * 
- * recursivly checks if the exp subexpressions are equal.
+ * checks if the exp subexpressions are equal, by walking
+ * the two side by side (see ast_walks_match in walk.h).
  * 
  * @param exp1 the first expression to check
  * @param exp2 the second expression to check
@@ -174,6 +169,15 @@ void swap_exps(struct exp *exp1, struct exp *exp2);
 
 bool exps_match(struct exp  *exp1, struct exp  *exp2);
 
+/** @brief checks if two exps are equivalent on their own,
+ * 	without looking at their subexpressions
+ * 
+ * @param exp1 the first expression to check
+ * @param exp2 the second expression to check
+ * @throw ERR_INV_EXP if they're not a type of exp
+ */
+bool exp_nodes_match(const struct exp *exp1, const struct exp *exp2);
+
 /** @brief confirms that either both exp1 and exp2 are ints or arrays
  * 
  * checks exp1 and exp2 and goes through each to get the type
@@ -0,0 +1,65 @@
+/** @file flat_ast.h
+ *  @brief Function prototypes for the flat (struct of arrays) AST.
+ *
+ *  The parser builds a tree of pointers to unions, with a heap
+ *  block for every payload. The passes after it (the semantic
+ *  checker and the IR lowering) walk a copy of it laid out as
+ *  parallel arrays instead: a node is an index, its kind, operator,
+ *  position and children are each in their own array, and the
+ *  children are 32 bit indices rather than pointers. A walk only
+ *  touches the arrays it reads, and those are contiguous.
+ *
+ *  Node 0 is never used, so FLAT_NONE (0) stands for a missing
+ *  child, and the root statement is always FLAT_ROOT.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <stdint.h>
+#include "structs.h"
+
+#define FLAT_NONE 0
+#define FLAT_ROOT 1
+#define FLAT_START_CAP 64
+
+/** @brief copies a parsed program into a flat_ast
+ *
+ * the names are still the interned ones, so the stmt tree
+ * can be freed straight after.
+ *
+ * @param root the root statement (what parse_file returns)
+ * @return the flat copy, or NULL if out of memory
+*/
+struct flat_ast *flatten_stmt(const struct stmt *root);
+
+/** @brief frees a flat_ast, or unmaps one loaded from a cache (see flat_cache.h)
+ *
+ * @param ast the flat_ast (can be NULL)
+*/
+void free_flat_ast(struct flat_ast *ast);
+
+/** @brief the name of a FLAT_NAME node
+*/
+static inline char *flat_name(const struct flat_ast *ast, uint32_t node) {
+	return ast->names[ast->a[node]];
+}
+
+/** @brief prints a block of statements the same way print_stmt does
+ *
+ * @param ast the flat_ast
+ * @param stmt the first statement of the block
+*/
+void print_flat_stmt(const struct flat_ast *ast, uint32_t stmt);
+
+/** @brief prints an exp the same way print_exp does
+ *
+ * @param ast the flat_ast
+ * @param exp the exp
+*/
+void print_flat_exp(const struct flat_ast *ast, uint32_t exp);
+
+#endif //FLAT_AST_H
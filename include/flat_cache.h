@@ -0,0 +1,87 @@
+/** @file flat_cache.h
+ *  @brief Function prototypes for the on-disk cache of the flat AST.
+ *
+ *  With caching on, parsing a file for its flat AST (see flat_ast.h)
+ *  writes that AST next to it, as <file>.ast, along with a copy of the
+ *  source. Next time, if the source is the same (the hash is checked
+ *  first, then the copy), the cache is mapped in and used as is instead
+ *  of lexing, parsing and flattening it again: the header says where
+ *  each of the arrays starts in the file, so they're pointed straight
+ *  at the mapping. The only thing built on load is the table of
+ *  (distinct, so few) names, which are interned so they still compare
+ *  by pointer.
+ *
+ *  It's a cache, not an interchange format: it's in the byte order of
+ *  the machine that wrote it, and anything that doesn't check out
+ *  is just a miss. That's the header (the magic, the version, the key,
+ *  the lengths) and one pass over the nodes, so a corrupt cache can't
+ *  send anything that reads it out of bounds: each kind has to be
+ *  one there is, each child and next has to be a later node (so
+ *  there are no cycles either), and each name has to be in names.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef FLAT_CACHE_H
+#define FLAT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+
+#define FLAT_CACHE_MAGIC "BFAC"
+#define FLAT_CACHE_VERSION 2
+#define FLAT_CACHE_SUFFIX ".ast"
+#define FLAT_CACHE_ALIGN 8
+
+/** @brief turns the AST cache on or off (it's off to start with)
+*/
+void setAstCaching(bool on);
+
+/** @brief the hash a cache is keyed by
+ *
+ * @param src the source
+ * @param len its length
+*/
+uint64_t hash_source(const char *src, size_t len);
+
+/** @brief parses a file into a flat_ast, going through its cache
+ *
+ * with caching off (or for "-", which has nowhere to put one),
+ * this is just flatten_stmt(parse_file(filename)). With it on, a
+ * cache that matches the source is mapped instead (and ast->map
+ * is set), and if there wasn't one, one is written after parsing.
+ * Failing to write it isn't an error, it's only a cache.
+ *
+ * @param filename the file to parse
+ * @throw any errors from parse_file
+ * @throw ERR_NO_MEM if flattening it runs out of memory
+ * @return the flat_ast, which free_flat_ast frees either way
+*/
+struct flat_ast *parse_file_flat(const char *filename);
+
+/** @brief maps a cache in, if it was written from this source
+ *
+ * @param path the cache file
+ * @param src the source
+ * @param src_len its length
+ * @return the flat_ast, or NULL if there's no valid cache there that matches
+*/
+struct flat_ast *load_flat_cache(const char *path, const char *src, size_t src_len);
+
+/** @brief writes a flat_ast out as a cache
+ *
+ * it's written to a temporary file that's renamed over path,
+ * so no one ever maps a half written cache.
+ *
+ * @param ast the flat_ast
+ * @param path where to write it
+ * @param src the source it came from
+ * @param src_len its length
+ * @return true if it was written
+*/
+bool write_flat_cache(const struct flat_ast *ast, const char *path, const char *src, size_t src_len);
+
+#endif //FLAT_CACHE_H
@@ -0,0 +1,40 @@
+/** @file intern.h
+ *  @brief Function prototypes for the identifier intern table.
+ *
+ *  Every name the lexer reads is interned, so each spelling
+ *  has exactly one copy, and the parser, semantics and IR can
+ *  compare names by pointer instead of with strcmp. The copies
+ *  live in a string arena owned by the table, not by the AST,
+ *  so nothing else frees them.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+#define INTERN_START_CAP 1024
+#define INTERN_BLOCK_SIZE (1 << 16)
+
+/** @brief gets the canonical copy of a name
+ *
+ * the name doesn't have to be null terminated, so the lexer
+ * can pass a slice of the source. The copy is.
+ *
+ * @param str the name
+ * @param len the length of the name
+ * @return the interned copy, or NULL if out of memory
+*/
+const char *intern(const char *str, size_t len);
+
+/** @brief frees every interned name
+ *
+ * any pointer intern returned is dangling after this, so
+ * only call it once the trees using them are gone.
+*/
+void intern_free(void);
+
+#endif //INTERN_H
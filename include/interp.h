@@ -6,24 +6,137 @@
  *
  *  This contains the prototypes for
  *  interpreting brainf code.
- * 
+ *
  *  eventually, it'll also be able to interprate the ir into brainf
  *
  *  @author Hawkins Peterson (hawkins03)
  *  @bug No known bugs.
  */
 
+#include <stdbool.h>
+#include "structs.h"
+
 #define BUFF_SIZE 2048
+#define STATS_SHM_PREFIX "/bf_stats."
+#define STATS_SHM_NAME_LEN 32
+#define PROFILE_TOP_LOOPS 16
 
 /** @brief interprates a string of brainf code,
  * and takes input and prints output as required
- * 
+ *
  * interprates a string of brainf code,
  * and takes input and prints output as required
- * 
+ *
  * @param input_buf a buffer of a maximum 2048
  * characters containing a brainf program.
 */
 void interp(char *input_buff);
 
+/** @brief interp, but with the runtime options turned on
+ *
+ * with opts->stats set, the counters in struct interp_stats
+ * are published to a shared memory segment named
+ * STATS_SHM_PREFIX<pid> for the lifetime of the run, and
+ * SIGUSR1 dumps the loop profile to stderr.
+ *
+ * everything is counted locally and only written out at
+ * loop back-edges, so straight-line code pays nothing extra.
+ *
+ * with opts->memo set, loops with no io and a bounded tape
+ * window are cached (see memo.h) and the hit/miss counters
+ * are printed to stderr at the end.
+ *
+ * the program is compiled into bytecode first (see bytecode.h).
+ * with opts->compact set, it runs the compact encoding, unless
+ * memo or profile are also set, as those keep per instruction
+ * tables that only the wide format has.
+ *
+ * with opts->parallel set, groups of adjacent loops that
+ * touch disjoint parts of the tape run on threads (see
+ * parallel.h), unless memo, profile or trace are also set.
+ *
+ * with opts->trace set, the last steps are kept in a ring
+ * (see trace.h) that's dumped to opts->trace if the process
+ * is killed, or on SIGUSR2. This also runs the wide format.
+ *
+ * @param input_buff the brainf program.
+ * @param opts the runtime options (NULL for none).
+ * @return ERR_OK, or ERR_UNMATCHED_BRACKET / ERR_NO_MEM / ERR_NO_FILE
+*/
+enum err_type interp_with_opts(char *input_buff, const struct interp_opts *opts);
+
+/** @brief runs an already compiled program on the given tape
+ *
+ * this is interp_with_opts without the compiling and the final
+ * stack dump, for callers that run a program more than once.
+ *
+ * @param prog the compiled program (encoded too, for opts->compact)
+ * @param opts the runtime options (NULL for none).
+ * @param tape the tape, BUFF_SIZE cells long
+ * @param ptr the starting tape index, updated to the final one
+ * @return ERR_OK, ERR_NO_MEM or ERR_NO_FILE
+*/
+enum err_type interp_program(const struct bf_program *prog, const struct interp_opts *opts, int *tape, int *ptr);
+
+/** @brief sets up a resumable run of prog on the given tape
+ *
+ * all the allocation (profile counters, memo tables, the stats
+ * segment) happens here, so interp_resume never allocates. The
+ * run starts at tape index 0, with no input fed yet.
+ *
+ * @param ctx the context to fill in
+ * @param prog the compiled program (encoded too, for opts->compact)
+ * @param opts the runtime options (NULL for none).
+ * @param tape the tape, BUFF_SIZE cells long
+ * @return ERR_OK, ERR_NO_MEM, or ERR_NO_FILE if the trace file can't be opened
+*/
+enum err_type interp_init(struct interp_ctx *ctx, const struct bf_program *prog,
+		const struct interp_opts *opts, int *tape);
+
+/** @brief runs until the program ends or has to wait on the caller
+ *
+ * NEED_INPUT means a ',' ran out of fed input: feed more (or EOF)
+ * and call again, and the ',' is retried. OUTPUT_READY means
+ * ctx->out is full. YIELD means the run went ctx->quantum steps
+ * (checked at loop back-edges, so straight-line code can overrun
+ * it a little) and can be resumed whenever. Any status can come back with output in
+ * ctx->out[0, out_len), which the caller drains by resetting out_len.
+ *
+ * @param ctx a context set up by interp_init
+ * @return INTERP_DONE, INTERP_NEED_INPUT, INTERP_OUTPUT_READY or INTERP_YIELD
+*/
+enum interp_status interp_resume(struct interp_ctx *ctx);
+
+/** @brief hands the run more input
+ *
+ * buf is borrowed, not copied, and has to stay alive until the
+ * run asks for input again (or finishes).
+ *
+ * @param ctx the run
+ * @param buf the input bytes
+ * @param len the number of bytes in buf
+*/
+void interp_feed(struct interp_ctx *ctx, const unsigned char *buf, size_t len);
+
+/** @brief marks the input as finished, so ',' reads EOF from now on
+ *
+ * @param ctx the run
+*/
+void interp_feed_eof(struct interp_ctx *ctx);
+
+/** @brief frees whatever interp_init allocated
+ *
+ * @param ctx the run
+*/
+void interp_free(struct interp_ctx *ctx);
+
+/** @brief writes the shared memory name for a given pid into buf
+ *
+ * shared between the interpreter and bfStats, so they agree on it.
+ *
+ * @param pid the pid of the interpreter process
+ * @param buf the output buffer (at least STATS_SHM_NAME_LEN long)
+*/
+void interp_stats_name(int pid, char *buf);
+
 #endif //BF_H
@@ -7,8 +7,11 @@
  * 
  * realistally, for an expression, the two arguments will need to be in adjacent cells
  * 
+ * it lowers the flat copy of the tree (see flat_ast.h), so stmts and exps are node indices.
  */
 
+#include <stdint.h>
+
 void init_ir_ctx(struct ir_ctx *ctx, struct stmt *root);
 
 struct ir_node *init_node(struct ir_ctx *ctx);
@@ -17,6 +20,6 @@ void free_ir_node(struct ir_node *node);
 
 void print_ir_node(struct ir_node *node);
 
-struct ir_node *convert_stmt(struct ir_ctx *ctx, struct stmt *stmt, struct ir_node *node);
+struct ir_node *convert_stmt(struct ir_ctx *ctx, uint32_t stmt, struct ir_node *node);
 
-struct ir_node *convert_exp(struct ir_ctx *ctx, struct exp *exp, struct ir_node *node);
\ No newline at end of file
+struct ir_node *convert_exp(struct ir_ctx *ctx, uint32_t exp, struct ir_node *node);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef LEX_CHUNKS_H
+#define LEX_CHUNKS_H
+
+/** @file lex_chunks.h
+ *  @brief Function prototypes for lexing a big file on several threads.
+ *
+ *  The source is split into one chunk per thread, each ending just
+ *  after a newline, and every chunk is lexed at the same time as if
+ *  it started outside of any comment, string or character. A chunk
+ *  has the tokens that start in it, and the last one can run on
+ *  past its end.
+ *
+ *  That guess is wrong when something crosses into the chunk (a
+ *  block comment, or a string or character with a newline in it),
+ *  so the chunks are then checked in order. The lexer only depends
+ *  on where it is between tokens, so a chunk's tokens are right
+ *  from the first one that starts where the chunk before left off.
+ *  If none do, that chunk is lexed again from there. The tokens are
+ *  then copied into one array, with each chunk's line numbers moved
+ *  down by the newlines before it, so the lines, columns and errors
+ *  all come out the same as lexing the file in one go.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include "structs.h"
+
+#define LEX_MIN_CHUNK (1 << 16)	// smaller files aren't worth the threads
+
+/** @brief lexes the reader's source into lex->toks on several threads
+ *
+ * @param lex the reader, which hasn't been lexed yet
+ * @param threads how many threads to use at most (the calling one included)
+ * @return false if it didn't, as the file's too small (or out of memory),
+ * 	so it has to be lexed the usual way
+*/
+bool lex_chunks_tokenize(struct lexer_ctx *lex, int threads);
+
+#endif //LEX_CHUNKS_H
@@ -0,0 +1,86 @@
+#ifndef LEX_PIPE_H
+#define LEX_PIPE_H
+
+/** @file lex_pipe.h
+ *  @brief Function prototypes for handing tokens from a lexer thread to the parser.
+ *
+ *  With pipelined lexing on (see setPipelinedLexing), the lexer runs
+ *  on its own thread and the parser takes tokens as they come, so
+ *  the two overlap instead of the whole file being lexed first.
+ *
+ *  The tokens go through a ring of TOK_PIPE_SIZE slots with one
+ *  writer (the lexer thread) and one reader (the parser). Each side
+ *  owns its index on its own cache line and only looks at the other's
+ *  when the ring seems full or empty, so there are no locks, and the
+ *  lines only move between cores when they have to. The lexer thread
+ *  waits while the ring is full, so it never gets more than the ring
+ *  ahead of the parser.
+ *
+ *  The last token (the lexer's sentinel, the only one that's
+ *  VAL_EMPTY) carries the error that stopped the lexer, if any,
+ *  which the parser raises when it gets there, same as without
+ *  the thread.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "structs.h"
+
+#define TOK_PIPE_SIZE 1024	// has to be a power of two
+#define CACHE_LINE 64
+
+struct tok_pipe;
+
+/** @brief makes an empty pipe
+ *
+ * @return the pipe, or NULL if out of memory
+*/
+struct tok_pipe *tok_pipe_init(void);
+
+/** @brief starts the lexer thread
+ *
+ * @param pipe the pipe it writes to
+ * @param lex_fn the thread's function, which has to end with tok_pipe_finish
+ * @param arg its argument
+ * @return false if the thread couldn't be started
+*/
+bool tok_pipe_run(struct tok_pipe *pipe, void *(*lex_fn)(void *), void *arg);
+
+/** @brief adds a token, waiting while the ring is full (lexer thread only)
+ *
+ * @param pipe the pipe
+ * @param tok the token
+ * @return false if the parser has gone (tok_pipe_free), so the lexer should stop
+*/
+bool tok_pipe_push(struct tok_pipe *pipe, const struct token *tok);
+
+/** @brief adds the sentinel, and with it the lexer's error (lexer thread only)
+ *
+ * @param pipe the pipe
+ * @param tok the sentinel, which has to be VAL_EMPTY
+ * @param err what stopped the lexer, or ERR_OK
+*/
+void tok_pipe_finish(struct tok_pipe *pipe, const struct token *tok, enum err_type err);
+
+/** @brief takes the next token, waiting for the lexer if it has to (parser only)
+ *
+ * @param pipe the pipe
+ * @return the token, which stays valid until the next call.
+ * 	Once the sentinel's taken, it's returned from then on.
+*/
+const struct token *tok_pipe_next(struct tok_pipe *pipe);
+
+/** @brief the error the lexer stopped on, once the sentinel's been taken
+*/
+enum err_type tok_pipe_error(const struct tok_pipe *pipe);
+
+/** @brief stops the lexer thread if it's still going, waits for it, and frees the pipe
+ *
+ * @param pipe the pipe (can be NULL)
+*/
+void tok_pipe_free(struct tok_pipe *pipe);
+
+#endif //LEX_PIPE_H
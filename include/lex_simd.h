@@ -0,0 +1,65 @@
+#ifndef LEX_SIMD_H
+#define LEX_SIMD_H
+
+/** @file lex_simd.h
+ *  @brief Function prototypes for the lexer's vectorized skipping kernels.
+ *
+ *  The lexer spends most of its time on indentation and comments,
+ *  so those are skipped 16 (SSE2) or 32 (AVX2) bytes at a time
+ *  instead of one advance() per character. The kernels count the
+ *  newlines they pass, so the lexer's line bookkeeping stays exact.
+ *
+ *  The best level the cpu supports is picked at startup, and can
+ *  be turned down with lex_simd_set (the benchmark does this).
+ *  Other architectures only get the scalar kernels.
+ *
+ *  A '\0' counts as the end of the source, same as in the lexer.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+enum lex_simd_level {
+	LEX_SCALAR, LEX_SSE2, LEX_AVX2
+};
+
+/** @brief picks which kernels to use
+ *
+ * @param level the highest level to use
+ * @return the level actually used, which is lower if the cpu can't do it
+*/
+enum lex_simd_level lex_simd_set(enum lex_simd_level level);
+
+/** @brief the name of a level, for printing
+*/
+const char *lex_simd_name(enum lex_simd_level level);
+
+/** @brief skips whitespace
+ *
+ * @param p where to start
+ * @param end the end of the source
+ * @param lines incremented for every newline skipped
+ * @param line_start set to just after the last newline skipped, if any
+ * @return the first character that isn't whitespace, or end
+*/
+const char *lex_skip_space(const char *p, const char *end, unsigned int *lines, const char **line_start);
+
+/** @brief finds the end of a // comment
+ *
+ * @param p the first character of the comment, after the //
+ * @param end the end of the source
+ * @return the newline (or '\0') ending it, or end
+*/
+const char *lex_line_end(const char *p, const char *end);
+
+/** @brief finds the end of a block comment
+ *
+ * @param p the first character of the comment, after the opening /\*
+ * @param end the end of the source
+ * @param lines incremented for every newline in the comment
+ * @param line_start set to just after the last newline in it, if any
+ * @return the '*' of the closing *\/, or a '\0' or end if it isn't closed
+*/
+const char *lex_comment_end(const char *p, const char *end, unsigned int *lines, const char **line_start);
+
+#endif //LEX_SIMD_H
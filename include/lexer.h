@@ -25,61 +25,103 @@
 #define LEXER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "structs.h"
 
 #define DEFAULT_LINE_CAP 256
 #define MAX_LINE_LEN 4096
 #define MAX_WORD_LEN 32
 #define MAX_NUM_LEN 10
-#define MAX_OP_LEN 3
-#define DELIMS ";()[]{}'\","
-#define OP_START "=+-*/%!~<>&^|"
 #define ASSIGN_OP_PRIO 0
 
 #define KEYWORDS (const char*[]) {"var", "val", "while", "for", "if", "else", "print", "input", "break", "true", "false", NULL}
 #define KEYWORDS_COUNT 11
-#define NUM_PRIOS 10
-
-#define OP_STRINGS (const char *[]) 	{"+", "-", 		\
-					"*", "/", "%",		\
-					"~", "|", "^", "&", 	\
-					"<<", ">>", 		\
-					"<", "<=", ">", ">=", 	\
-					"==", "!=", 		\
-					"!", "&&", "||", 	\
-					"=", "+=", "-=", 	\
-					"*=", "/=", "%=", 	\
-					"<<=", ">>=",		\
-					"&=", "^=", "|=", 	\
-					"++", "--"}		\
-
-#define PREFIX_OPS (enum operator []) {OP_LOGICAL_NOT, OP_BITWISE_NOT, OP_INCREMENT, OP_DECREMENT, OP_MINUS, OP_UNKNOWN}
-#define SUFFIX_OPS (enum operator []) {OP_INCREMENT, OP_DECREMENT, OP_UNKNOWN}
-#define ASSIGN_OPS (enum operator []) { OP_ASSIGN, OP_PLUS_ASSIGN, OP_MINUS_ASSIGN, \
-    				OP_MULTIPLY_ASSIGN, OP_DIVIDE_ASSIGN, OP_MODULO_ASSIGN, \
-    				OP_LEFT_SHIFT_ASSIGN, OP_RIGHT_SHIFT_ASSIGN, \
-    				OP_BITWISE_AND_ASSIGN, OP_BITWISE_XOR_ASSIGN, OP_BITWISE_OR_ASSIGN, \
-				OP_UNKNOWN}
 
 // reading from the file object
 
 /** @brief creates the initial reader struct
  * 
  * also initializes the root statement,
- * copies the filename, and reads in
- * the first line, along with the first
- * token/value.
+ * copies the filename, and maps in
+ * the whole file. The lexer walks the
+ * mapped file with a cursor, so lines can
+ * be any length, and reads every value
+ * into an array up front, so moving to
+ * the next value is just an index.
+ * The first value is loaded into lex->val.
  * 
- * @param filename the file to read from.
+ * @param filename the file to read from, or "-" for stdin.
  * @return the reader struct for the file
 */
 struct lexer_ctx *readInFile(const char *filename);
 
+/** @brief creates a reader for a source already in memory
+ * 
+ * same as readInFile, but the lexer walks
+ * the caller's buffer instead of a file, so
+ * nothing touches the disk. The buffer doesn't
+ * need a '\0' on the end, and isn't copied,
+ * so it has to outlive the reader (the parsed
+ * statements don't point into it).
+ * 
+ * @param src the source
+ * @param len the length of the source
+ * @param name what to call it in errors (NULL for "<buffer>")
+ * @return the reader struct, or NULL if out of memory or too long
+*/
+struct lexer_ctx *readInBuffer(const char *src, size_t len, const char *name);
+
+/** @brief creates a reader for an open file descriptor
+ * 
+ * regular files are mapped in like readInFile,
+ * anything else (a pipe, a terminal, a socket)
+ * is read until eof. The fd isn't closed.
+ * 
+ * @param fd the file descriptor to read from
+ * @param name what to call it in errors
+ * @return the reader struct, or NULL if it couldn't be read
+*/
+struct lexer_ctx *readInFd(int fd, const char *name);
+
+/** @brief turns lexing on another thread on or off for new readers
+ * 
+ * when on, the readers made after this lex on a
+ * thread of their own, which hands the values to
+ * the parser as it goes (see lex_pipe.h), instead
+ * of reading them all in up front. Errors still
+ * come out when the parser reaches them. If the
+ * thread can't be started, it lexes up front anyway.
+ * 
+ * @param on whether to
+*/
+void setPipelinedLexing(bool on);
+
+/** @brief sets how many threads new readers can lex on
+ * 
+ * sources of at least LEX_MIN_CHUNK bytes a thread
+ * are split up and lexed in parallel (see lex_chunks.h).
+ * This comes before pipelined lexing, which is only
+ * used for the files that aren't split.
+ * 
+ * @param threads how many, 1 (the default) to not split files up
+*/
+void setLexThreads(int threads);
+
+/** @brief lexes the tokens that start in one chunk of the source
+ * 
+ * the chunk's tokens are put in chunk->toks, with
+ * their lines counted from chunk->start. Nothing in
+ * lex is changed, so chunks can be lexed at once.
+ * 
+ * @param lex the reader, with its source set
+ * @param chunk the chunk, with start, limit and from set
+*/
+void lexChunk(const struct lexer_ctx *lex, struct lex_chunk *chunk);
+
 /** @brief frees the reader struct and its contents
  * 
  * also frees the root structure,
- * the current line in focus,
- * the file pointer, and if r->val
+ * unmaps (or frees) the source, and if r->val
  * is a string/name, that too.
  * 
  * @param lexer the lexer to free (in oop this would just be the overall container class)
@@ -112,48 +154,19 @@ const char *getKeyStr(enum key_type key);
 
 //checking op values
 
-/** @brief gets the priority of a given binary operation
- *  
- * check BINARY_OPS in reader.c to
- * see the list of priorities
- * 
- * lower number means lower priority, and
- * if the priority doesn't match the priority
- * of the previous operation, the previous operation
- * becomes the new left value. Otherwise the currrent
- * operation becomes the previous right operation.
- * 
- * @param op the operation to get the priority of
- * @return the integer priority of the operation (-1 if it's not a binary operation)
- */
-int getPrio(const enum operator op);
-
-/** @brief checks to see if the operation is an assign operation
- * 
- * i.e. x += y
- * 
- * see ASSIGN_OPS above to see a list of all assign operations
- * it's important because assign ops are always highest priority,
- * and the fact that they're handled differently in terms of semantics
- * 
- * @param op the possible assign operation
- * @return if op is an assign operation
- */
-bool isAssignOp(const enum operator op);
-
-/** @brief checks if the op is a non-assign binary operation
- * 
- * i.e. x * y
- * 
- * basically just checks if getPrio(op) >= 0
- * 
- * @param op the possible binary operation
- * @return if the op is a binary operation
+/** @brief gets how tightly an op binds on each side
+ *
+ * see OP_INFO in lexer.c for the table, and what the powers mean.
+ * parse_exp goes by these, so they're the only place
+ * the ops' priorities and associativity are kept.
+ *
+ * @param op the operation
+ * @return its binding powers ({-1, -1, false} if it doesn't bind at all)
 */
-bool isBinaryOp(const enum operator op);
+struct binding_power getBindingPower(const enum operator op);
 
 /** @brief checks if the op is a suffix unary operation
- * (basically just ++ and --, but see SUFFIX_OPS for if that changes)
+ * (basically just ++ and --, but see OP_INFO in lexer.c for if that changes)
  * 
  * is_suffix and is_prefix aren't
  * combined because they're atomic
@@ -163,7 +176,7 @@ bool isBinaryOp(const enum operator op);
 bool is_suffix_unary(enum operator op);
 
 /** @brief checks if the op is a prefix unary operation
- * see PREFix_OPS for the full list
+ * see OP_INFO in lexer.c for the full list
  * 
  * is_suffix and is_prefix aren't
  * combined because they're atomic
@@ -178,8 +191,9 @@ bool is_prefix_unary(enum operator op);
  *  since r->val is the only
  *  token handled, it doesn't return it or anything.
  * 
- *  calls a number of static inline functions for
- *  readability's sake
+ *  the values were all read in by readInFile, so
+ *  this just copies the next one into r->val. At
+ *  the end of the file r->val keeps the last value.
  *  
  *  @param lex the lexer to read from
  *  no return value, just call peakValue
@@ -208,31 +222,35 @@ struct value peekValue(struct lexer_ctx *lex);
  */
 void acceptValue(struct lexer_ctx *lex, enum value_type type, const char *expected);
 
-/** @brief returns r->val->str and sets it to null
+/** @brief returns the string in r->val and moves on to the next value
  *  
- * that way it's not freed if there's an error,
- * as well as defines the ownership of the string
- * 
  * note the difference between string and name,
  * as string is a literal string, quotes and everything
  * and gets handled as an array_lit
  * 
+ * the string isn't copied unless it has escapes in
+ * it, so it isn't null terminated and the caller
+ * doesn't own it. It's good until the next call
+ * or until the lexer is freed.
+ * 
  * @param lex the lexer to read from
- * @return r->val->str if it's a string
+ * @param len set to the length of the string
+ * @return the string, without the quotes
  * @throw ERR_INV_VAL if the value isn't a string
  */
-char *stealNextString(struct lexer_ctx *lex);
+const char *stealNextString(struct lexer_ctx *lex, size_t *len);
 
-/** @brief returns r->val->str and sets it to null
- * 
- * that way it's not freed if there's an error,
- * as well as defines the ownership of the string
+/** @brief returns r->val->str and moves on to the next value
  * 
  * note the difference between string and name,
  * as string is a literal string, quotes and everything
  * and gets handled as an array_lit. Name in this case
  * is a variable name
  * 
+ * names are interned (see intern.h), so the caller
+ * doesn't own it and mustn't free it, and two names
+ * are the same if they're the same pointer.
+ * 
  * @param lex the lexer to read from
  * @return r->val->str if it's a name value
  * @throw ERR_INV_VAL if the value isn't a name
@@ -0,0 +1,74 @@
+/** @file memo.h
+ *  @brief Function prototypes for memoizing pure brainf loops.
+ *
+ *  A loop is memoizable when it (and every loop nested in it)
+ *  does no io and leaves the pointer where it found it. Then
+ *  the cells it can touch are a fixed window around the
+ *  pointer, and the result only depends on that window.
+ *
+ *  On entry the window is hashed and looked up. A hit applies
+ *  the cached write-set and skips the loop, a miss runs it and
+ *  records the write-set when the loop falls through.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdbool.h>
+#include "structs.h"
+
+#define MEMO_MAX_WINDOW 64
+#define MEMO_TABLE_SIZE 4096
+
+struct memo_ctx;
+
+/** @brief analyzes the loops in a program and sets up the cache
+ *
+ * @param ops the program, in the wide format
+ * @param len the number of ops
+ * @param tape_len the length of the (wrapping) tape
+ * @return the memo context, or NULL if it fails to malloc
+ */
+struct memo_ctx *memo_init(const struct bf_op *ops, int len, int tape_len);
+
+/** @brief called when a loop is entered with a non-zero cell
+ *
+ * on a hit the cached writes are applied to the tape, and the
+ * caller should jump to the matching BF_JNZ.
+ * on a miss for an eligible loop, the window is saved until memo_exit.
+ *
+ * @param memo the memo context
+ * @param pc the index of the BF_JZ
+ * @param tape the tape
+ * @param ptr the current tape index
+ * @return if the loop was skipped
+ */
+bool memo_enter(struct memo_ctx *memo, int pc, int *tape, int ptr);
+
+/** @brief called when a loop falls through its BF_JNZ
+ *
+ * if the loop is the one memo_enter last missed on,
+ * its write-set is recorded in the cache.
+ *
+ * @param memo the memo context
+ * @param pc the index of the matching BF_JZ
+ * @param tape the tape
+ */
+void memo_exit(struct memo_ctx *memo, int pc, const int *tape);
+
+/** @brief prints the hit and miss counters to stderr
+ *
+ * @param memo the memo context
+ */
+void memo_report(const struct memo_ctx *memo);
+
+/** @brief frees the memo context and every cached entry
+ *
+ * @param memo the memo context
+ */
+void memo_free(struct memo_ctx *memo);
+
+#endif //MEMO_H
@@ -0,0 +1,70 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/** @file parallel.h
+ *  @brief Function prototypes for running independent loops in parallel.
+ *
+ *  A group is a run of adjacent sibling loops, with only pointer
+ *  moves between them, where every loop is pure (no io, and
+ *  leaves the pointer where it started) and the tape windows
+ *  they can touch don't overlap. The loops in a group can run in
+ *  any order, so they run at the same time, one per thread, and
+ *  the run carries on after the last one once they've all finished.
+ *
+ *  The first '[' of each group is patched to BF_PAR in a private
+ *  copy of the program. A group runs on the calling thread until
+ *  it's seen at least two of its loops take PAR_MIN_STEPS steps,
+ *  as handing loops to threads costs more than a short loop does.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include "structs.h"
+
+#define PAR_MAX_GROUP 16
+#define PAR_MIN_STEPS (1 << 15)
+
+struct par_ctx;
+
+/** @brief finds the groups in prog and starts the worker threads
+ *
+ * @param prog the compiled program, which has to outlive the par_ctx
+ * @param tape_len the length of the tape, which windows can't wrap around
+ * @return the context, or NULL if out of memory
+*/
+struct par_ctx *par_init(const struct bf_program *prog, int tape_len);
+
+/** @brief the copy of the program with the BF_PAR ops patched in
+ *
+ * @param par the context
+ * @return the program to run
+*/
+const struct bf_program *par_program(const struct par_ctx *par);
+
+/** @brief runs the group a BF_PAR op starts
+ *
+ * @param par the context
+ * @param group the BF_PAR op's arg
+ * @param tape the tape
+ * @param ptr the pointer at the first '[', updated to the one after the last ']'
+ * @param high_water updated with the highest cell the group can touch
+ * @param steps incremented by the steps the loops took
+ * @return the index of the op after the group
+*/
+int par_run(struct par_ctx *par, int group, int *tape, int *ptr, long *high_water, unsigned long long *steps);
+
+/** @brief prints how many groups there are and how they ran to stderr
+ *
+ * @param par the context
+*/
+void par_report(const struct par_ctx *par);
+
+/** @brief stops the threads and frees the context
+ *
+ * @param par the context (can be NULL)
+*/
+void par_free(struct par_ctx *par);
+
+#endif //PARALLEL_H
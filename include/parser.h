@@ -4,6 +4,11 @@
  *  This contains the prototypes for parsing individual values into stmts.
  *  there are a lot of subfunctions that are called by the ones here,
  *  but these are the "levers" that can be pulled from outside the file.
+ *
+ *  None of them recurse: anything nested (blocks, parentheses,
+ *  right sides, indexes, array elements) waits on a work stack
+ *  in the lexer_ctx, so how deep a program can nest is only
+ *  limited by memory.
  *  
  *  @author Hawkins Peterson (hawkins03)
  *  @bug No known bugs.
@@ -16,25 +21,26 @@
 #include "utils.h"
 #include "structs.h"
 
+#define PARSE_FRAMES_START_CAP 64
+
 /** @brief parses values into an assignable value
  * 
  * parses names, array refrences, and unary expressions only.
  * (this exists mainly to catch someone trying to do 1++)
  * 
  * @param r the reader struct for throwing errors and getting values.
- * @param exp the expression the output is returned to
  * 
  * @throw ERR_INV_OP if an invalid op is used as a unary op.
  * @throw ERR_NO_MEM if an init function fails 
+ * @return the expression, or NULL if the next value can't start an assignable one
 */
-bool parse_assignable(struct lexer_ctx *lex, struct exp *exp);
+struct exp *parse_assignable(struct lexer_ctx *lex);
 
-/** @brief parses values into an atomic expression and stores it in the in argument
+/** @brief parses values into an atomic expression
  * 
  * parses names, array_lits/refs, unary expressions, numbers and strings
  * 
  * @param r the reader struct for throwing errors and getting values.
- * @param exp the expression the output is returned to
  * 
  * @throw ERR_TO_LONG if the string is too long
  * @throw ERR_INV_VAL if there is an unexpected
@@ -42,24 +48,29 @@ bool parse_assignable(struct lexer_ctx *lex, struct exp *exp);
  * 	or an invalid keyword is invoked (i.e. else for example)
  * @throw ERR_INV_OP if an invalid op is used as a unary op in parse_assignable.
  * @throw ERR_NO_MEM if an init function fails.
+ * @return the expression (EXP_EMPTY if there wasn't one)
 */
-void parse_atom(struct lexer_ctx *lex, struct exp *exp);
+struct exp *parse_atom(struct lexer_ctx *lex);
 
 /** @brief parses expressions, usually in the form of <Atom> <op> <Atom>
  * 
  * parses expressions, usually in the form of <Atom> <op> <Atom>
  * specifically binary ops and assign-ops.
  * 
+ * it's a Pratt parser, driven by the ops' binding powers (see getBindingPower),
+ * and every node is allocated once, where it ends up. It runs on the
+ * work stack, so parentheses and the like can nest as deep as memory allows.
+ * 
  * @param minPrio used to ensure that the
  * 	operators are of the correct arangement.
  * 	i.e. x + 1 * 2 ~= x + (1 * 2), not (x + 1) * 2 and so on
  * @param r the reader struct for throwing errors and getting values.
- * @param exp the expression to return to
  *
  * @throw any errors from parse_atom
  * @throw ERR_INV_EXP if you try to set a non-assignable value (1=x for example)
+ * @return the expression
 */
-void parse_exp(int minPrio, struct lexer_ctx *lex, struct exp *exp);
+struct exp *parse_exp(int minPrio, struct lexer_ctx *lex);
 
 /** @brief parses values into a single statement
  * 
@@ -85,22 +96,62 @@ void parse_single_stmt(struct lexer_ctx *lex, struct stmt *stmt);
 /** @brief calls parse_single_stmt for an
  * 	infinitely large series of statements
  * 
+ * blocks (and else if chains) go on the work stack, so
+ * they can nest as deep as memory allows.
+ * 
  *  @param r the reader struct for throwing errors and getting values
  * @param stmt the statement the output is returned to
  * @throw any errors from parse_single_stmt
  */
 void parse_stmt(struct lexer_ctx *lex, struct stmt *stmt);
 
+/** @brief parses the values a lexer has read in
+ * 
+ * this is the second half of parse_file, so the
+ * lexing and the parsing can be timed apart.
+ * 
+ * @param lex the lexer from readInFile, which gets freed
+ * @throw any errors form parse_stmt
+ * @return the statement linked list
+ */
+struct stmt *parse_tokens(struct lexer_ctx *lex);
+
 /** @brief creates a reader and initial stmt
  * 	and then calls parse_stmt on it
  * 
  * @param filename the name of the file to
- * 	parse into a statement
+ * 	parse into a statement, or "-" for stdin
  * @throw any errors form parse_stmt
  * @return the statement linked list
  * 	interpretation of the file.
  */
 struct stmt *parse_file(const char *filename);
 
+/** @brief parses a source that's already in memory
+ * 
+ * same as parse_file, without touching the disk.
+ * The statements don't point into src, so it
+ * can be freed as soon as this returns.
+ * 
+ * @param src the source (doesn't need a '\0' on the end)
+ * @param len the length of the source
+ * @param name what to call it in errors (NULL for "<buffer>")
+ * @throw any errors form parse_stmt
+ * @return the statement linked list
+ */
+struct stmt *parse_buffer(const char *src, size_t len, const char *name);
+
+/** @brief parses everything read from a file descriptor
+ * 
+ * for pipes and stdin (parse_file("-") is
+ * parse_fd(STDIN_FILENO, "<stdin>")).
+ * 
+ * @param fd the file descriptor, which is left open
+ * @param name what to call it in errors
+ * @throw any errors form parse_stmt
+ * @return the statement linked list
+ */
+struct stmt *parse_fd(int fd, const char *name);
+
 
 #endif //PARSER_H
\ No newline at end of file
@@ -16,6 +16,7 @@
 #define SEMANTICS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "structs.h"
 
 #define STARTING_ENV_CAP 8
@@ -34,7 +35,7 @@
  */
 void setup_env(struct env *env, struct env *parent);
 
-/** @brief frees the env variable buffer and root stmt
+/** @brief frees the env variable buffer, root stmt and flat ast
  * 
  * also calls free_env(env->parent)
  * 
@@ -65,9 +66,11 @@ bool define_var(struct env *env, char *name, bool is_mutable, int array_depth);
 /** @brief fetches a name from the env
  * 
  * see structs for the var_data struct.
+ * names are compared by pointer, so name has
+ * to be interned (which every name in the tree is).
  * 
  * @param env the env to get the variable from.
- * @param name the name of the variable
+ * @param name the interned name of the variable
  * @return the variable metadata
  */
 struct var_data *get_var(const struct env *env, const char *name);
@@ -90,13 +93,13 @@ struct var_data *get_var(const struct env *env, const char *name);
   * 6: print and input take and return int values only.
  * 
  * @param env the env to use
- * @param exp the exp to check
+ * @param exp the exp to check, a node of env->ast (see flat_ast.h)
  *
  * @throw ERR_INV_ARR if an array is used in an inpropper place (non-assign binary operations for example)
  * @throw ERR_NO_VAR if a name expression fails to find the variable in env
  * @throw ERR_INV_EXP if an operation is used in an invalid manner.
  */
-void check_exp_semantics(struct env *env, struct exp *exp);
+void check_exp_semantics(struct env *env, uint32_t exp);
 
 /** @brief checks the semantics of a statement.
  *  
@@ -111,17 +114,19 @@ void check_exp_semantics(struct env *env, struct exp *exp);
  *   3.4 see assignment rules
  * 
  * @param env the env to use
- * @param exp the exp to check
+ * @param stmt the first statement of the block to check, a node of env->ast
  * 
  * @throw ERR_INV_ARR if an array is used in an inpropper place (non-assign binary operations for example)
  * @throw ERR_REDEF if define_variable fails.
- * @throw ERR_INV_STMT shouldn't be called, but if stmt->type is STMT_EMPTY
+ * @throw ERR_INV_STMT shouldn't be called, but if stmt is a FLAT_STMT_EMPTY
  */
-void check_stmt_semantics(struct env *env, struct stmt *stmt);
+void check_stmt_semantics(struct env *env, uint32_t stmt);
 
 /** @brief checks the semantics of a file.
  *  
- * runs check_stmt_semantics on parse_file_semantics(filename)
+ * runs check_stmt_semantics on parse_file_flat(filename), so
+ * the flat copy of it, which comes from its cache if that's on
+ * (see flat_cache.h).
  * 
  * @param filename the file to check the semantics of.
  * @throw see check_stmt_semantics for thrown error
@@ -0,0 +1,40 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+/** @file serve.h
+ *  @brief The protocol between bfServe and its clients.
+ *
+ *  bfServe listens on a unix stream socket. A connection
+ *  sends any number of requests, one at a time:
+ *
+ *    RUN <tenant> <src_len> <input_len>\n<src><input>
+ *      -> OK <out_len> <steps>\n<output>
+ *      -> ERR <reason>\n
+ *    STATS\n
+ *      -> STATS <jobs> jobs, <hits> hits, <misses> misses, <tenants> tenants\n
+ *    QUIT\n
+ *      -> stops the server
+ *
+ *  the whole input is sent up front, and ',' reads EOF once
+ *  it runs out.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#define SERVE_LINE_LEN 128
+#define SERVE_TENANT_LEN 32
+#define SERVE_MAX_TENANTS 64
+#define SERVE_CACHE_SIZE 256
+#define SERVE_MAX_SRC (1 << 20)
+#define SERVE_MAX_INPUT (1 << 20)
+
+#define SERVE_DEFAULT_WORKERS 4
+#define SERVE_DEFAULT_QUANTUM 10000
+#define SERVE_DEFAULT_TAPES 16			// tapes a tenant can hold at once
+#define SERVE_DEFAULT_MAX_STEPS 100000000ULL	// steps a job can run for
+#define SERVE_DEFAULT_TENANT_STEPS 1000000000ULL	// steps a tenant's jobs can run for, together, each period
+#define SERVE_BUDGET_PERIOD_MS 1000
+#define SERVE_DEFAULT_MAX_OUT (1 << 20)
+
+#endif //SERVE_H
@@ -13,26 +13,29 @@
 #include <stdbool.h>
 #include "structs.h"
 
-/** @brief frees a statement and it's relevent substructures
+/** @brief frees a parsed program
  * 
- * see the function itself if you want to know what it frees
- * @param stmt the statement to free
+ * every node of it is in the same arena (see arena.h),
+ * so this frees the arena, however big the tree is.
+ * @param stmt the root statement (what parse_file returns),
+ * 	not one from the middle of the tree
  */
 void free_stmt(struct stmt *stmt);
 
 /** @brief prints the string interpretation of a stmt
+ * 	and the ones after it
+ * 
+ * it goes through ast_walk (see walk.h), so it doesn't
+ * recurse however long or deeply nested the program is.
  * 
  * @param stmt the statement to print
  */
 void print_stmt(const struct stmt *stmt);
 
 
-/** @brief malloc's a stmt struct
+/** @brief allocates a stmt struct from lex->arena
  * 
  * also sets stmt->type to STMT_EMPTY
- * can't really be malloc'd because
- * for any given file, there will
- * be n many of them.
  * 
  * @param r for errors.
  * @throw ERR_NO_MEM if it fails to malloc the stmt
@@ -82,6 +85,9 @@ void init_expStmt(struct stmt *stmt, struct exp *exp);
 
 
 /** @brief checks to see if two statements are equivalent
+ * 
+ * it walks the two side by side (see ast_walks_match in
+ * walk.h), so it doesn't recurse however long or deep they are.
  * 
  * @param stmt1 the first statement to check
  * @param stmt2 the second statement to check
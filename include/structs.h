@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 enum key_type {
 	KW_VAR, KW_VAL, KW_WHILE, KW_FOR, 
@@ -27,6 +28,11 @@ enum stmt_type {
 	STMT_EMPTY, STMT_VAR, STMT_LOOP, STMT_IF, STMT_EXPR
 };
 
+// who owns lexer_ctx.src, and so how killReader lets go of it
+enum src_kind {
+	SRC_BORROWED, SRC_MAPPED, SRC_READ
+};
+
 enum err_type {
 	ERR_OK = 0,
 	
@@ -84,17 +90,45 @@ enum operator {
 	OP_UNKNOWN//34
 };
 
+// how tightly an op binds on each side, for parse_exp (see OP_INFO in lexer.c)
+struct binding_power {
+	signed char left, right;
+	bool assign;
+};
+
 //TODO: only malloc one value, and pass stuff through it. (i.e. peek only, getValue just changes its contents)
 struct value {
 	enum value_type type;
 	int start_pos;
 	union {
-		char *str;
+		// names and strings, as the part of the source they're in.
+		// A string's slice is inside the quotes, before escapes are replaced.
+		struct { unsigned int off, len : 31, escaped : 1; } slice;
 		int num;
 		char ch;
 	};
 };
 
+// a value read ahead of time, with where it was in the source.
+// line, line_start and end are where the lexer stands right after it.
+struct token {
+	struct value val;
+	unsigned int offset, end;	// where it starts and ends in the source
+	unsigned int line, line_start;	// the line it ends on, and the offset of that line
+};
+
+// a piece of the source lexed on its own, see lex_chunks.h
+struct lex_chunk {
+	unsigned int start, limit;	// it has the tokens that start in [start, limit)
+	unsigned int from;		// where it started lexing, start unless it was redone
+	struct token *toks;		// lines counted from start, so line 1 is start's line
+	size_t num_toks;
+	bool ended;			// it got to the end (or an error), so toks[num_toks] is the sentinel
+	unsigned int stop;		// if not, where the next token starts
+	enum err_type err;		// if it ended on an error, which
+	unsigned int newlines;		// in [start, limit)
+};
+
 //TODO: change op into a enum.
 // exp_binary, exp_unary, exp_array_ref, exp_array_lit, exp_call
 struct exp_binary { struct exp *left; struct exp *right; enum operator op; };
@@ -107,7 +141,7 @@ struct exp {
 	int line_num, start_col;
 	union {
 		int num;
-		char *name;
+		char *name;	// interned, see intern.h
 		struct exp_binary *op;
 		struct exp_unary *unary;
 		struct exp_array_ref *array_ref;
@@ -132,23 +166,165 @@ struct stmt {
 	struct stmt *next;
 };
 
+// a stmt or an exp, as ast_walk sees them, see walk.h
+struct ast_node {
+	bool is_stmt;
+	union {
+		const struct stmt *stmt;
+		const struct exp *exp;
+	};
+};
+
+enum walk_event {
+	WALK_PRE,	// on the way into a node, before its children
+	WALK_IN,	// between two of its children
+	WALK_POST,	// on the way out, after all of them
+};
+
+struct walk_step {
+	enum walk_event event;
+	struct ast_node node;
+	int child;	// for WALK_IN, the child that's next
+};
 
+struct walk_frame {
+	struct ast_node node;
+	int pos;	// how far through its children it is, see ast_walk_next
+};
+
+struct ast_walk {
+	struct walk_frame *frames;	// a node, and the ones it's inside of
+	size_t num_frames, frames_cap;
+};
+
+struct ast_visitor {
+	void (*pre)(struct ast_node node, void *data);
+	void (*in)(struct ast_node node, int child, void *data);
+	void (*post)(struct ast_node node, void *data);
+};
+
+// what a node of a flat_ast is, and so what its a, b and c hold
+enum flat_kind {
+	FLAT_EMPTY,		// an empty exp
+	FLAT_NAME,		// a: the index of its name in names
+	FLAT_NUM,		// a: the number
+	FLAT_ARRAY_REF,		// a: name, b: index (or FLAT_NONE)
+	FLAT_ARRAY_LIT,		// a: the first element (chained by next), b: how many
+	FLAT_ASSIGN_OP,		// a: left, b: right, op
+	FLAT_BINARY_OP,		// a: left, b: right, op
+	FLAT_PREFIX,		// a: operand, op
+	FLAT_SUFFIX,		// a: operand, op
+	FLAT_CALL,		// a: the argument (or FLAT_NONE), op: the key_type
+	FLAT_STMT_EMPTY,	// the statements are chained by next
+	FLAT_VAR,		// a: name, b: value (or FLAT_NONE)
+	FLAT_VAL,		// a: name, b: value (or FLAT_NONE)
+	FLAT_LOOP,		// a: cond, b: the first statement of the body
+	FLAT_IF,		// a: cond, b: then, c: else
+	FLAT_EXPR,		// a: the exp
+};
+
+// the tree as parallel arrays indexed by node (see flat_ast.h), with the
+// nodes in the order they come in the source, so walks go through memory in order
+struct flat_ast {
+	uint8_t *kind;		// enum flat_kind
+	uint8_t *op;		// enum operator, or enum key_type for FLAT_CALL
+	int32_t *line, *col;
+	uint32_t *a, *b, *c;	// children, see flat_kind
+	uint32_t *next;		// the next statement in the block, or element in the array
+	uint32_t len, cap;
+
+	char **names;		// interned, so compared by pointer
+	uint32_t num_names, names_cap;
+
+	// if it was loaded from a cache (see flat_cache.h), the arrays
+	// point into this mapping of it, and only names was allocated
+	void *map;
+	size_t map_len;
+};
+
+// the start of an AST cache file (see flat_cache.h). The offsets are
+// from the start of the file, so it can be used where it's mapped.
+struct flat_cache_header {
+	char magic[4];		// FLAT_CACHE_MAGIC
+	uint32_t version;	// FLAT_CACHE_VERSION
+	uint64_t src_hash;	// hash_source of the source it was parsed from
+	uint64_t src_len;
+	uint64_t file_len;	// the whole cache file, header and all
+	uint32_t len;		// nodes, including node 0
+	uint32_t num_names;	// distinct ones
+	// where each array of the flat_ast starts. names are offsets into
+	// strs, of '\0' terminated strings, and FLAT_NAME's a indexes names.
+	uint64_t kind, op, line, col, a, b, c, next;
+	uint64_t names, strs, strs_len;
+	uint64_t src;		// a copy of the source, src_len long, which is the real key
+};
+
+// what a parse_frame is waiting on, see the work stack in parser.c
+enum parse_frame_type {
+	PF_EXP,		// the bottom of a run of expressions, which returns the last one
+	PF_RIGHT,	// exp: a binary op, waiting on its right side
+	PF_PAREN,	// a ( waiting on its expression and )
+	PF_CALL_ARG,	// exp: a print, waiting on its argument and )
+	PF_INDEX,	// exp: an array ref, waiting on its index and ]
+	PF_ELEM,	// exp: an array literal, waiting on its element len
+	PF_PREFIX,	// exp: a prefix op, waiting on its operand
+	PF_STMTS,	// the bottom of a run of statements
+	PF_BLOCK,	// stmt: the last statement in a block, the next one goes after it
+	PF_BRACE,	// a while or else body, waiting on its }
+	PF_IF_THEN,	// stmt: an if, waiting on its then block's } (and maybe an else)
+	PF_FOR_INIT,	// stmt: a for, waiting on its first statement (len is where the for started)
+	PF_FOR_BODY,	// stmt: a for's loop, waiting on its body's }
+};
+
+struct parse_frame {
+	enum parse_frame_type type;
+	int min_prio;	// what the expression being waited on's part of was parsed at
+	int len;
+	union {
+		struct exp *exp;
+		struct stmt *stmt;
+	};
+};
+
+struct tok_pipe;
+struct ast_arena;
 struct lexer_ctx {
 	struct value val;
-	fpos_t line_start_pos;
 
-	FILE *fp;
 	char *filename;
 	struct stmt *root;
-	char *line_buf;
+	struct ast_arena *arena;	// where the tree is allocated, see arena.h
+
+	// the whole source is in memory (mapped, read in from a pipe, or
+	// the caller's buffer). cur is the next character, and line_start
+	// is the start of the line it's on.
+	const char *src, *cur, *end;
+	const char *line_start;
+	size_t src_len;
+	enum src_kind src_kind;
+
+	// every value in the file, read up front, and a sentinel holding
+	// where the lexer ends up. next_tok is the one after val.
+	struct token *toks;
+	size_t num_toks, tok_cap, next_tok;
+	enum err_type tok_err;		// what stopped the lexer early, if anything
+	struct tok_pipe *pipe;		// if another thread's lexing, see lex_pipe.h
+
+	// where stealNextString puts strings that had escapes in them
+	char *esc_buf;
+	size_t esc_cap;
+
+	// the parser's work stack, so nesting doesn't use the C stack, see parser.c
+	struct parse_frame *frames;
+	size_t num_frames, frames_cap;
 
 	int ch;
-	unsigned int line_cap, line_pos, line_num;
+	unsigned int line_pos, line_num;
 };
 
 struct env;
 struct var_data {
-	char *name;
+	char *name;	// interned, so it's compared by pointer
 	bool is_mutable;
 	int array_depth;
 	//don't need is_defined because variables are default assigned to 0
@@ -156,6 +332,7 @@ struct var_data {
 
 struct env {
 	struct stmt *root;
+	struct flat_ast *ast;	// what's being checked, see flat_ast.h
 	struct env *parent;
 	char *filename;
 	struct var_data *vars;
@@ -212,8 +389,109 @@ struct ir_node {
 
 struct ir_ctx {
 	struct stmt *root;
+	struct flat_ast *ast;	// root, flattened, which is what gets lowered
 	struct ir_node *ir_root;
 	unsigned int var_num;
 };
 
+
+// live runtime counters, published to shared memory at loop back-edges.
+// seq is odd while the interpreter is writing, so readers retry on odd/changed seq.
+struct interp_stats {
+	volatile unsigned int seq;
+	int pid;
+	bool running;
+	unsigned long long steps;
+	unsigned long long out_bytes;
+	long pc;
+	long ptr;
+	long high_water;
+};
+
+enum bf_opcode {
+	BF_ADD, BF_MOVE, BF_OUT, BF_IN,
+	BF_JZ, BF_JNZ, BF_CLEAR, BF_END,
+	BF_TRAP,	// patched in by the debugger, never emitted by bf_compile
+	BF_PAR		// patched in by par_init, starts a group of parallel loops
+};
+
+// the wide (decoded) format: one fixed size struct per folded instruction.
+// for BF_JZ/BF_JNZ, arg is the index of the matching bracket.
+struct bf_op {
+	enum bf_opcode op;
+	int arg;
+	int src;	// offset of the instruction in the source
+};
+
+// what a loop does to the tape, relative to the pointer at its '['
+struct bf_loop_info {
+	int lo, hi;	// the range of offsets it (and its children) can touch
+	bool pure;	// no io, and leaves the pointer where it started
+};
+
+struct bf_program {
+	struct bf_op *ops;
+	int len;
+	unsigned char *code;	// compact encoding (see bytecode.h), NULL until encoded
+	size_t code_len;
+};
+
+struct interp_opts {
+	bool stats;	// publish interp_stats to STATS_SHM_PREFIX<pid>
+	bool profile;	// dump the loop profile to stderr when finished
+	bool memo;	// cache the results of pure loops (see memo.h)
+	bool compact;	// run the compact encoding instead of the wide one
+	bool parallel;	// run independent loops on threads (see parallel.h)
+	const char *trace;		// keep a trace ring (see trace.h) and dump it here, NULL for none
+	unsigned long trace_len;	// records in the ring, 0 for TRACE_DEFAULT_LEN
+};
+
+enum interp_status {
+	INTERP_DONE,		// hit the end of the program
+	INTERP_NEED_INPUT,	// stopped on ',' with no input left, resume after interp_feed
+	INTERP_OUTPUT_READY,	// the output buffer is full, drain it and resume
+	INTERP_YIELD,		// used up its quantum, resume whenever
+	INTERP_TRAP,		// hit a breakpoint or watchpoint, see trap_kind
+};
+
+#define INTERP_OUT_CAP 256
+
+// everything a suspended run needs. Nothing is allocated between
+// resumes, so a caller can keep one of these per session.
+struct interp_ctx {
+	const struct bf_program *prog;
+	int *tape;
+	int ptr;
+	long pc;		// op index, or byte offset for the compact encoding
+	bool compact;
+	enum interp_status status;
+
+	// input is borrowed from the caller until it's consumed
+	const unsigned char *in;
+	size_t in_len;
+	bool in_eof;
+	unsigned char out[INTERP_OUT_CAP];
+	int out_len;
+
+	unsigned long long steps;
+	unsigned long long quantum;	// steps per resume before yielding, 0 for no limit
+	long high_water;
+	struct interp_stats local;
+	struct interp_stats *shared;
+	unsigned long long *iters;
+	unsigned long long *entries;
+	struct memo_ctx *memo;
+	struct trace_ring *trace;
+	struct par_ctx *par;
+
+	// only set by debug_attach, for runs with BF_TRAP patched in
+	const struct bf_op *orig;	// the unpatched ops
+	const unsigned char *traps;	// TRAP_BREAK | TRAP_WATCH for each op
+	const unsigned char *watch;	// nonzero for each watched cell
+	long trap_pc;			// breakpoint already reported, run the real op next
+	long trap_op;			// the op that trapped last
+	int trap_kind;
+	int watch_old;			// what the watched cell was before it changed
+};
+
 #endif //STRUCT_H
\ No newline at end of file
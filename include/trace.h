@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/** @file trace.h
+ *  @brief Function prototypes for the execution trace ring buffer.
+ *
+ *  With tracing on, the interpreter writes one 8 byte record
+ *  (op index, pointer, cell) per step into a fixed size ring,
+ *  so only the last trace_len steps are kept. The ring is dumped
+ *  to a file when the process dies on a signal, or at the next
+ *  loop back-edge after a SIGUSR2.
+ *
+ *  A dump is a struct trace_header, the program's ops (so the
+ *  decoder can map op indexes back to source offsets without the
+ *  source), then the records, oldest first.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include "structs.h"
+
+#define TRACE_MAGIC "BFTR"
+#define TRACE_VERSION 1
+#define TRACE_DEFAULT_LEN (1 << 22)
+
+struct trace_rec {
+	uint32_t pc;	// op index
+	uint16_t ptr;
+	int16_t cell;	// the low 16 bits, before the op runs
+};
+
+struct trace_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t rec_size;
+	uint32_t num_ops;
+	uint64_t total;		// steps recorded over the whole run
+	uint64_t num_recs;	// records in this dump
+};
+
+struct trace_ring {
+	struct trace_rec *recs;
+	uint64_t mask;		// length - 1, the length is a power of two
+	uint64_t total;
+	const struct bf_program *prog;
+	int fd;
+};
+
+extern volatile sig_atomic_t trace_dump_requested;
+
+/** @brief records one step. Called before the op at pc runs.
+*/
+static inline void trace_push(struct trace_ring *ring, int pc, int ptr, int cell) {
+	struct trace_rec *rec = ring->recs + (ring->total++ & ring->mask);
+	rec->pc = pc;
+	rec->ptr = ptr;
+	rec->cell = cell;
+}
+
+/** @brief sets up a ring and opens the dump file
+ *
+ * this also takes over the fatal signals and SIGUSR2, so the
+ * ring gets dumped before the process goes down. Only one ring
+ * can be live at a time.
+ *
+ * @param prog the program being traced
+ * @param len the number of records to keep, rounded up to a power of two
+ * @param path where to dump it
+ * @return the ring, or NULL if out of memory or the file can't be opened
+*/
+struct trace_ring *trace_init(const struct bf_program *prog, unsigned long len, const char *path);
+
+/** @brief writes the ring out to its file, replacing any earlier dump
+ *
+ * only uses async signal safe calls, so it can run in a handler.
+ *
+ * @param ring the ring
+ * @return true if the whole dump was written
+*/
+bool trace_dump(const struct trace_ring *ring);
+
+/** @brief puts the signal handlers back and frees the ring
+ *
+ * @param ring the ring (can be NULL)
+*/
+void trace_free(struct trace_ring *ring);
+
+#endif //TRACE_H
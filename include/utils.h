@@ -14,6 +14,7 @@
 #define UTILS_H
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "structs.h"
 
 extern void (*error_exit_handler)(enum err_type err_code);
@@ -24,8 +25,7 @@ void reset_strlen_if_needed(char **str, const int len, int *cap, struct lexer_ct
 
 void _raise_error(enum err_type err, const char *func, const char *file, int line);
 void _raise_syntax_error(enum err_type err, const char *func, const char *file, int line, struct lexer_ctx *lex);
-void _raise_exp_semantic_error(enum err_type err, const struct exp *exp, const char *func, const char *file, int line, struct env *env);
-void _raise_stmt_semantic_error(enum err_type err, const struct stmt *stmt, const char *func, const char *file, int line, struct env *env);
+void _raise_node_semantic_error(enum err_type err, uint32_t node, const char *func, const char *file, int line, struct env *env);
 void _raise_ir_error(enum err_type err, const char *func, const char *file, int line, struct ir_ctx *lex);
 
 #define raise_error(err) \
@@ -34,11 +34,9 @@ void _raise_ir_error(enum err_type err, const char *func, const char *file, int
 #define raise_syntax_error(err, lex) \
 	_raise_syntax_error(err, __func__, __FILE__, __LINE__, lex)
 
-#define raise_exp_semantic_error(err, exp, env) \
-	_raise_exp_semantic_error(err, exp, __func__, __FILE__, __LINE__, env)
-
-#define raise_stmt_semantic_error(err, stmt, env) \
-	_raise_stmt_semantic_error(err, stmt, __func__, __FILE__, __LINE__, env)
+// node is an exp or stmt of env->ast (see flat_ast.h)
+#define raise_semantic_error(err, node, env) \
+	_raise_node_semantic_error(err, node, __func__, __FILE__, __LINE__, env)
 
 #define raise_ir_error(err, ctx) \
 	_raise_ir_error(err, __func__, __FILE__, __LINE__, ctx)
@@ -0,0 +1,81 @@
+/** @file walk.h
+ *  @brief Function prototypes for walking the stmt tree without recursing.
+ *
+ *  ast_walk goes through a tree depth first, keeping the nodes
+ *  it's inside of on a stack of its own rather than the C stack.
+ *  A statement's next isn't one of its children: the walk goes on
+ *  to it in the same frame, so a block of any length takes one
+ *  frame, and the stack only grows with how deep the tree nests.
+ *
+ *  A node's children are, in order:
+ *  	VAR: name, value	LOOP: cond, body	IF: cond, then, else
+ *  	EXPR: exp		OP: left, right		UNARY: operand
+ *  	CALL: arg		ARR: name, index	ARR_LIT: each element
+ *  and a NULL child is skipped, but still counts.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdbool.h>
+#include "structs.h"
+
+#define WALK_START_CAP 32
+
+static inline struct ast_node stmt_node(const struct stmt *stmt) {
+	return (struct ast_node) { .is_stmt = true, .stmt = stmt };
+}
+
+static inline struct ast_node exp_node(const struct exp *exp) {
+	return (struct ast_node) { .is_stmt = false, .exp = exp };
+}
+
+/** @brief starts a walk at root
+ *
+ * @param walk the walk, which ast_walk_end frees
+ * @param root where to start (a NULL one is an empty walk)
+*/
+void ast_walk_start(struct ast_walk *walk, struct ast_node root);
+
+/** @brief takes the next step of a walk
+ *
+ * every node gets a WALK_PRE, then a WALK_IN before each
+ * of its children after the first, then a WALK_POST.
+ *
+ * @param walk the walk
+ * @param step where the step goes
+ * @throw ERR_NO_MEM if the stack can't grow
+ * @return false once the walk's over
+*/
+bool ast_walk_next(struct ast_walk *walk, struct walk_step *step);
+
+/** @brief frees a walk's stack
+*/
+void ast_walk_end(struct ast_walk *walk);
+
+/** @brief walks the whole tree under root, calling the visitor on each step
+ *
+ * @param root where to start
+ * @param visitor the callbacks (any of which can be NULL)
+ * @param data passed on to the callbacks
+*/
+void ast_walk(struct ast_node root, const struct ast_visitor *visitor, void *data);
+
+/** @brief walks two trees side by side, to see if they're the same
+ *
+ * the walks have to take the same steps, so the trees have the same
+ * shape, and match has to be true for each pair of nodes they go into.
+ *
+ * @param a one tree
+ * @param b the other
+ * @param match compares two nodes on their own, not what's under them
+ * 	(which the walks take care of), and must be false if they'd
+ * 	have a different number of children
+ * @return true if they match
+*/
+bool ast_walks_match(struct ast_node a, struct ast_node b, bool (*match)(struct ast_node, struct ast_node));
+
+#endif //WALK_H
@@ -0,0 +1,126 @@
+/** @file arena.c
+ *  @brief Functions for the arena the AST is allocated from.
+ *
+ *  This contains the blocks (calloc'd, so everything bumped
+ *  out of them is already zeroed) and the bump allocator.
+ *  Allocations too big to be worth starting a new block for
+ *  get a block of their own, behind the one being bumped.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+struct ast_block {
+	struct ast_block *next;
+	size_t used, cap;
+	char data[] __attribute__((aligned(AST_ALIGN)));
+};
+
+struct ast_arena {
+	struct ast_block *blocks;	// the first is the one being bumped
+	void *last;			// the last allocation, which can be resized in place
+	size_t used;
+	struct stmt root;
+};
+
+static inline size_t align_up(size_t size) {
+	return (size + AST_ALIGN - 1) & ~(AST_ALIGN - 1);
+}
+
+static struct ast_block *new_block(size_t cap) {
+	struct ast_block *block = calloc(1, sizeof(*block) + cap);
+	if (block)
+		block->cap = cap;
+	return block;
+}
+
+struct ast_arena *ast_arena_init(void) {
+	struct ast_arena *arena = calloc(1, sizeof(*arena));
+	if (!arena)
+		return NULL;
+	arena->blocks = new_block(AST_BLOCK_SIZE);
+	if (!arena->blocks) {
+		free(arena);
+		return NULL;
+	}
+	return arena;
+}
+
+struct stmt *ast_arena_root(struct ast_arena *arena) {
+	return &arena->root;
+}
+
+struct ast_arena *ast_arena_of(struct stmt *root) {
+	return (struct ast_arena *) ((char *) root - offsetof(struct ast_arena, root));
+}
+
+void *ast_alloc(struct ast_arena *arena, size_t size) {
+	size = align_up(size ? size : 1);
+	struct ast_block *block = arena->blocks;
+	if (block->cap - block->used < size) {
+		if (size > AST_BLOCK_SIZE / 4) {
+			// too big to throw away what's left of the current block for
+			struct ast_block *own = new_block(size);
+			if (!own)
+				return NULL;
+			own->used = size;
+			own->next = block->next;
+			block->next = own;
+			arena->used += size;
+			return own->data;
+		}
+		block = new_block(AST_BLOCK_SIZE);
+		if (!block)
+			return NULL;
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+
+	void *out = block->data + block->used;
+	block->used += size;
+	arena->used += size;
+	arena->last = out;
+	return out;
+}
+
+void *ast_realloc(struct ast_arena *arena, void *ptr, size_t old_size, size_t size) {
+	if (!ptr)
+		return ast_alloc(arena, size);
+
+	struct ast_block *block = arena->blocks;
+	size_t old = align_up(old_size ? old_size : 1), want = align_up(size ? size : 1);
+	if ((ptr == arena->last) && (block->used - old + want <= block->cap)) {
+		// it's on the end of the current block, so it can just move the end
+		if (want < old)
+			memset(block->data + block->used - old + want, 0, old - want);
+		block->used = block->used - old + want;
+		arena->used = arena->used - old + want;
+		return ptr;
+	}
+	if (size <= old_size)
+		return ptr;
+
+	void *out = ast_alloc(arena, size);
+	if (out)
+		memcpy(out, ptr, old_size);
+	return out;
+}
+
+size_t ast_arena_used(const struct ast_arena *arena) {
+	return arena->used;
+}
+
+void ast_arena_free(struct ast_arena *arena) {
+	if (!arena)
+		return;
+	while (arena->blocks) {
+		struct ast_block *next = arena->blocks->next;
+		free(arena->blocks);
+		arena->blocks = next;
+	}
+	free(arena);
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bytecode.h"
+#include "interp.h"
+#include "utils.h"
+
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+static double time_run(const struct bf_program *prog, const struct interp_opts *opts, int runs) {
+	static int tape[BUFF_SIZE];
+	double best = -1;
+	for (int i = 0; i < runs; i++) {
+		memset(tape, 0, sizeof(tape));
+		int ptr = 0;
+		double start = now_ms();
+		if (interp_program(prog, opts, tape, &ptr) != ERR_OK)
+			raise_error(ERR_NO_MEM);
+		double elapsed = now_ms() - start;
+		if ((best < 0) || (elapsed < best))
+			best = elapsed;
+	}
+	return best;
+}
+
+// usage: bfBench [-n runs] file.bf...
+// program output goes to /dev/null, the results are printed on stderr.
+int main(int argc, char *argv[]) {
+	if (argc <= 1)
+		raise_error(ERR_NO_ARGS);
+
+	int runs = 3;
+	if (!freopen("/dev/null", "w", stdout))
+		raise_error(ERR_NO_FILE);
+
+	fprintf(stderr, "%-32s %10s %12s %12s %7s %10s %10s %7s\n",
+		"program", "ops", "wide bytes", "compact", "ratio", "wide ms", "compact ms", "speed");
+	for (int i = 1; (i < argc) && (argv[i] != NULL); i++) {
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+			runs = atoi(argv[++i]);
+			continue;
+		}
+
+		long len;
+		char *src = bf_read_source(argv[i], &len);
+		if (!src)
+			raise_error(ERR_NO_FILE);
+
+		struct bf_program prog;
+		enum err_type err = bf_compile(src, len, &prog);
+		free(src);
+		if (err == ERR_OK)
+			err = bf_encode_compact(&prog);
+		if (err != ERR_OK)
+			raise_error(err);
+
+		struct interp_opts wide = {0};
+		struct interp_opts compact = { .compact = true };
+		double wide_ms = time_run(&prog, &wide, runs);
+		double compact_ms = time_run(&prog, &compact, runs);
+
+		size_t wide_bytes = prog.len * sizeof(*prog.ops);
+		fprintf(stderr, "%-32s %10d %12zu %12zu %6.2fx %10.2f %10.2f %6.2fx\n",
+			argv[i], prog.len, wide_bytes, prog.code_len,
+			(double) wide_bytes / prog.code_len, wide_ms, compact_ms,
+			compact_ms > 0 ? wide_ms / compact_ms : 0.0);
+		bf_free_program(&prog);
+	}
+	return 0;
+}
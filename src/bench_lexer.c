@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lex_simd.h"
+#include "lexer.h"
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT "B/cycle"
+static unsigned long long ticks(void) {
+	return __rdtsc();
+}
+#else
+#define TICK_UNIT "B/ns"
+static unsigned long long ticks(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+#endif
+
+// best of runs, in ticks, to read in and lex the whole file
+static unsigned long long time_lex(const char *filename, int runs, size_t *bytes, size_t *tokens) {
+	unsigned long long best = 0;
+	for (int i = 0; i < runs; i++) {
+		unsigned long long start = ticks();
+		struct lexer_ctx *lex = readInFile(filename);
+		unsigned long long elapsed = ticks() - start;
+		if (!lex)
+			raise_error(ERR_NO_FILE);
+		*bytes = lex->src_len;
+		*tokens = lex->num_toks;
+		killReader(lex);
+		if (!best || (elapsed < best))
+			best = elapsed;
+	}
+	return best ? best : 1;
+}
+
+// lexes the file split up between threads, and checks it came out the same as lexing it in one go
+static bool same_as_serial(const char *filename, int threads) {
+	setLexThreads(1);
+	struct lexer_ctx *serial = readInFile(filename);
+	setLexThreads(threads);
+	struct lexer_ctx *split = readInFile(filename);
+	if (!serial || !split)
+		raise_error(ERR_NO_FILE);
+
+	bool same = (serial->num_toks == split->num_toks) && (serial->tok_err == split->tok_err);
+	for (size_t i = 0; same && (i <= serial->num_toks); i++) {
+		const struct token *a = serial->toks + i, *b = split->toks + i;
+		same = (a->offset == b->offset) && (a->end == b->end) && (a->line == b->line) &&
+			(a->line_start == b->line_start) && (a->val.type == b->val.type) &&
+			(a->val.start_pos == b->val.start_pos);
+	}
+	killReader(serial);
+	killReader(split);
+	return same;
+}
+
+// writes kb kilobytes of deeply indented code under comment banners, like our generated sources
+static char *gen_source(int kb) {
+	static char path[] = "/tmp/lexBench.XXXXXX";
+	int fd = mkstemp(path);
+	FILE *fp = (fd < 0) ? NULL : fdopen(fd, "w");
+	if (!fp)
+		raise_error(ERR_NO_FILE);
+
+	for (int i = 0; ftell(fp) < kb * 1024L; i++) {
+		fprintf(fp, "/*****************************************************************\n");
+		fprintf(fp, " * block %d, generated, do not edit\n", i);
+		fprintf(fp, " *****************************************************************/\n");
+		for (int depth = 1; depth <= 8; depth++) {
+			fprintf(fp, "%*s// step %d of block %d\n", depth * 8, "", depth, i);
+			fprintf(fp, "%*sx%d = x%d + %d;\n", depth * 8, "", depth, depth - 1, i);
+		}
+		fprintf(fp, "s = \"block %d\n    spans lines\n\";\n", i);
+	}
+	fclose(fp);
+	return path;
+}
+
+// usage: lexBench [-n runs] [-t threads] [-g kb] file...
+// lexes each file with every kernel level the cpu has, the results are printed on stderr.
+// -g lexes a generated source of about kb kilobytes too, and -t lexes them
+// split up between threads as well (see lex_chunks.h), checking it matches.
+int main(int argc, char *argv[]) {
+	if (argc <= 1)
+		raise_error(ERR_NO_ARGS);
+
+	int runs = 5, threads = 1;
+	bool all_same = true;
+	char *generated = NULL;
+	fprintf(stderr, "%-32s %10s %9s %8s %12s %12s %8s\n",
+		"file", "bytes", "tokens", "kernels", "ticks", TICK_UNIT, "speed");
+	for (int i = 1; (i < argc) && (argv[i] != NULL); i++) {
+		const char *filename = argv[i];
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+			runs = atoi(argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "-t") && (i + 1 < argc)) {
+			threads = atoi(argv[++i]);
+			continue;
+		}
+		if (!strcmp(argv[i], "-g") && (i + 1 < argc)) {
+			filename = generated = gen_source(atoi(argv[++i]));
+		}
+
+		const char *name = (filename == generated) ? "(generated)" : filename;
+		unsigned long long scalar = 0;
+		size_t bytes = 0, tokens = 0;
+		for (int level = LEX_SCALAR; level <= LEX_AVX2; level++) {
+			if (lex_simd_set(level) != level)
+				continue;
+			unsigned long long t = time_lex(filename, runs, &bytes, &tokens);
+			if (level == LEX_SCALAR)
+				scalar = t;
+			fprintf(stderr, "%-32s %10zu %9zu %8s %12llu %12.3f %7.2fx\n",
+				name, bytes, tokens, lex_simd_name(level), t, (double) bytes / t, (double) scalar / t);
+		}
+		enum lex_simd_level best = lex_simd_set(LEX_AVX2);
+
+		if (threads > 1) {
+			setLexThreads(threads);
+			unsigned long long t = time_lex(filename, runs, &bytes, &tokens);
+			bool same = same_as_serial(filename, threads);
+			setLexThreads(1);
+			all_same &= same;
+
+			char label[32];
+			snprintf(label, sizeof(label), "%s x%d", lex_simd_name(best), threads);
+			fprintf(stderr, "%-32s %10zu %9zu %8s %12llu %12.3f %7.2fx %s\n",
+				name, bytes, tokens, label, t, (double) bytes / t, (double) scalar / t,
+				same ? "same as serial" : "DIFFERENT FROM SERIAL");
+		}
+	}
+	if (generated)
+		unlink(generated);
+	return all_same ? 0 : 1;
+}
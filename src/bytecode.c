@@ -0,0 +1,279 @@
+/** @file bytecode.c
+ *  @brief Functions for compiling brainf into bytecode
+ *
+ *  This contains the compiler from brainf source into
+ *  the wide format, and the encoder from the wide
+ *  format into the compact one. See bytecode.h for
+ *  the layout of both.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+
+char *bf_read_source(const char *filename, long *len) {
+	FILE *fp = fopen(filename, "r");
+	if (!fp)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	char *buf = (size >= 0) ? calloc(size + 1, sizeof(*buf)) : NULL;
+	if (buf && (fread(buf, 1, size, fp) != (size_t) size)) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	if (buf && len)
+		*len = size;
+	return buf;
+}
+
+static inline bool is_run_op(enum bf_opcode op) {
+	return (op == BF_ADD) || (op == BF_MOVE);
+}
+
+static inline void emit_op(struct bf_program *prog, enum bf_opcode op, int arg, int src) {
+	struct bf_op *last = prog->len ? prog->ops + prog->len - 1 : NULL;
+	if (is_run_op(op) && last && (last->op == op)) {
+		last->arg += arg;
+		if (last->arg == 0)
+			prog->len--;
+		return;
+	}
+	prog->ops[prog->len++] = (struct bf_op) { op, arg, src };
+}
+
+// [-] and [+] always end with the cell at zero
+static inline bool is_clear_loop(const struct bf_program *prog, int open) {
+	return (prog->len == open + 2) && (prog->ops[open + 1].op == BF_ADD) &&
+		((prog->ops[open + 1].arg == 1) || (prog->ops[open + 1].arg == -1));
+}
+
+enum err_type bf_compile(const char *src, int len, struct bf_program *prog) {
+	memset(prog, 0, sizeof(*prog));
+	prog->ops = calloc(len + 1, sizeof(*prog->ops));
+	int *stack = calloc(len + 1, sizeof(*stack));
+	if (!prog->ops || !stack) {
+		free(stack);
+		bf_free_program(prog);
+		return ERR_NO_MEM;
+	}
+
+	int depth = 0;
+	for (int i = 0; i < len; i++) {
+		switch (src[i]) {
+		case '+':
+			emit_op(prog, BF_ADD, 1, i);
+			break;
+		case '-':
+			emit_op(prog, BF_ADD, -1, i);
+			break;
+		case '>':
+			emit_op(prog, BF_MOVE, 1, i);
+			break;
+		case '<':
+			emit_op(prog, BF_MOVE, -1, i);
+			break;
+		case '.':
+			emit_op(prog, BF_OUT, 0, i);
+			break;
+		case ',':
+			emit_op(prog, BF_IN, 0, i);
+			break;
+		case '[':
+			stack[depth++] = prog->len;
+			emit_op(prog, BF_JZ, 0, i);
+			break;
+		case ']':
+			if (depth == 0) {
+				free(stack);
+				bf_free_program(prog);
+				return ERR_UNMATCHED_BRACKET;
+			}
+			int open = stack[--depth];
+			if (is_clear_loop(prog, open)) {
+				prog->len = open;
+				emit_op(prog, BF_CLEAR, 0, prog->ops[open].src);
+				break;
+			}
+			prog->ops[open].arg = prog->len;
+			emit_op(prog, BF_JNZ, open, i);
+			break;
+		}
+	}
+	free(stack);
+
+	if (depth != 0) {
+		bf_free_program(prog);
+		return ERR_UNMATCHED_BRACKET;
+	}
+	prog->ops[prog->len++] = (struct bf_op) { BF_END, 0, len };
+	return ERR_OK;
+}
+
+static inline unsigned int zigzag(int v) {
+	return ((unsigned int) v << 1) ^ (unsigned int) (v >> 31);
+}
+
+static inline int varint_len(unsigned int v) {
+	int n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static inline int encoded_len(unsigned int operand) {
+	return (operand < BC_EXT) ? 1 : 1 + varint_len(operand);
+}
+
+static inline unsigned char *write_op(unsigned char *out, enum bf_opcode op, unsigned int operand) {
+	if (operand < BC_EXT) {
+		*out++ = (unsigned char) ((op << BC_OP_BITS) | operand);
+		return out;
+	}
+	*out++ = (unsigned char) ((op << BC_OP_BITS) | BC_EXT);
+	while (operand >= 0x80) {
+		*out++ = (unsigned char) (operand | 0x80);
+		operand >>= 7;
+	}
+	*out++ = (unsigned char) operand;
+	return out;
+}
+
+static inline unsigned int plain_operand(const struct bf_op *op) {
+	return is_run_op(op->op) ? zigzag(op->arg) : 0;
+}
+
+enum err_type bf_encode_compact(struct bf_program *prog) {
+	int n = prog->len;
+	size_t *pos = calloc(n + 1, sizeof(*pos));
+	unsigned int *operand = calloc(n + 1, sizeof(*operand));
+	if (!pos || !operand) {
+		free(pos);
+		free(operand);
+		return ERR_NO_MEM;
+	}
+
+	for (int i = 0; i < n; i++)
+		operand[i] = plain_operand(prog->ops + i);
+
+	// jump distances depend on the size of the code between them,
+	// which depends on the distances. Sizes (and so distances) only
+	// ever grow, so recomputing until nothing changes terminates, and
+	// the last pass leaves every operand equal to its distance.
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		pos[0] = 0;
+		for (int i = 0; i < n; i++)
+			pos[i + 1] = pos[i] + encoded_len(operand[i]);
+
+		for (int i = 0; i < n; i++) {
+			if (prog->ops[i].op != BF_JZ)
+				continue;
+			int close = prog->ops[i].arg;
+			unsigned int dist = pos[close + 1] - pos[i + 1];
+			if (dist > operand[i]) {
+				changed = changed || (encoded_len(dist) != encoded_len(operand[i]));
+				operand[i] = dist;
+				operand[close] = dist;
+			}
+		}
+	}
+
+	free(prog->code);
+	prog->code_len = pos[n];
+	prog->code = malloc(prog->code_len + 1);
+	if (!prog->code) {
+		free(pos);
+		free(operand);
+		return ERR_NO_MEM;
+	}
+
+	unsigned char *out = prog->code;
+	for (int i = 0; i < n; i++)
+		out = write_op(out, prog->ops[i].op, operand[i]);
+
+	free(pos);
+	free(operand);
+	return ERR_OK;
+}
+
+struct loop_frame {
+	int pc;
+	long open_off, min, max;
+	bool ok;
+};
+
+int bf_analyze_loops(const struct bf_op *ops, int len, struct bf_loop_info *loops) {
+	struct loop_frame *stack = calloc(len + 1, sizeof(*stack));
+	if (!stack)
+		return -1;
+
+	int depth = 0, max_depth = 0;
+	long off = 0;
+	for (int i = 0; i < len; i++) {
+		struct loop_frame *top = depth ? stack + depth - 1 : NULL;
+		switch (ops[i].op) {
+		case BF_MOVE:
+			off += ops[i].arg;
+			if (top && (off < top->min))
+				top->min = off;
+			if (top && (off > top->max))
+				top->max = off;
+			break;
+		case BF_OUT:
+		case BF_IN:
+			if (top)
+				top->ok = false;
+			break;
+		case BF_JZ:
+			stack[depth++] = (struct loop_frame) { i, off, off, off, true };
+			if (depth > max_depth)
+				max_depth = depth;
+			break;
+		case BF_JNZ:
+			if (!top || (ops[i].arg != top->pc))
+				break;
+			depth--;
+			top->ok = top->ok && (off == top->open_off);
+			loops[top->pc] = (struct bf_loop_info) {
+				top->min - top->open_off, top->max - top->open_off, top->ok
+			};
+			if (depth) {
+				struct loop_frame *parent = stack + depth - 1;
+				parent->ok = parent->ok && top->ok;
+				if (top->min < parent->min)
+					parent->min = top->min;
+				if (top->max > parent->max)
+					parent->max = top->max;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	free(stack);
+	return max_depth;
+}
+
+void bf_free_program(struct bf_program *prog) {
+	if (!prog)
+		return;
+	free(prog->ops);
+	prog->ops = NULL;
+	free(prog->code);
+	prog->code = NULL;
+	prog->len = 0;
+	prog->code_len = 0;
+}
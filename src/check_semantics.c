@@ -2,21 +2,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "flat_cache.h"
 #include "interp.h"
+#include "intern.h"
 #include "parser.h"
 #include "semantics.h"
 #include "utils.h"
 #include "stmt.h"
 
+// usage: semChecker [--cache] file...
+// --cache checks the flat copy of each file mapped from a cache next to it,
+// if it hasn't changed since the cache was written (see flat_cache.h).
 int main(int argc, char *argv[]) {
 	if (argc <= 1)
 		raise_error(ERR_NO_ARGS);
     	for (int i = 1; (i < argc) && (argv[i] != NULL); i++) {
 		if (!argv[i])
 			raise_error(ERR_NO_ARGS);
+		if (!strcmp(argv[i], "--cache")) {
+			setAstCaching(true);
+			continue;
+		}
 
 		check_file_semantics(argv[i]);
     	}
 
+	intern_free();
 	return 0;
 }
\ No newline at end of file
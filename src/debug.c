@@ -0,0 +1,111 @@
+/** @file debug.c
+ *  @brief Functions for breakpoints and watchpoints.
+ *
+ *  This contains the patching of BF_TRAP into the wide
+ *  bytecode, and the reporting of the traps the interpreter
+ *  stops on. See interp.c for how a BF_TRAP runs.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "interp.h"
+
+struct bf_debugger {
+	struct bf_program *prog;
+	struct bf_op *orig;		// the ops before any patching
+	unsigned char *traps;		// TRAP_BREAK | TRAP_WATCH for each op
+	unsigned char watch[BUFF_SIZE];
+	bool watching;
+	unsigned long long break_hits, watch_hits;
+};
+
+struct bf_debugger *debug_init(struct bf_program *prog) {
+	struct bf_debugger *dbg = calloc(1, sizeof(*dbg));
+	if (!dbg)
+		return NULL;
+
+	dbg->prog = prog;
+	dbg->orig = malloc(prog->len * sizeof(*dbg->orig));
+	dbg->traps = calloc(prog->len, sizeof(*dbg->traps));
+	if (!dbg->orig || !dbg->traps) {
+		debug_free(dbg);
+		return NULL;
+	}
+	memcpy(dbg->orig, prog->ops, prog->len * sizeof(*dbg->orig));
+	return dbg;
+}
+
+static void patch(struct bf_debugger *dbg, int pc, int kind) {
+	dbg->traps[pc] |= kind;
+	dbg->prog->ops[pc].op = BF_TRAP;
+}
+
+// the ops are in source order, and a folded run's src is where it starts
+int debug_break(struct bf_debugger *dbg, int src_offset) {
+	int pc = -1;
+	for (int i = 0; (i < dbg->prog->len) && (dbg->orig[i].src <= src_offset); i++)
+		if (dbg->orig[i].op != BF_END)
+			pc = i;
+	if (pc >= 0)
+		patch(dbg, pc, TRAP_BREAK);
+	return pc;
+}
+
+static bool writes_cell(enum bf_opcode op) {
+	return (op == BF_ADD) || (op == BF_CLEAR) || (op == BF_IN);
+}
+
+enum err_type debug_watch(struct bf_debugger *dbg, int cell) {
+	if ((cell < 0) || (cell >= BUFF_SIZE))
+		return ERR_INV_VAL;
+	dbg->watch[cell] = 1;
+
+	// every writer gets patched once, the cell check happens at runtime
+	if (!dbg->watching) {
+		for (int i = 0; i < dbg->prog->len; i++)
+			if (writes_cell(dbg->orig[i].op))
+				patch(dbg, i, TRAP_WATCH);
+		dbg->watching = true;
+	}
+	return ERR_OK;
+}
+
+void debug_attach(const struct bf_debugger *dbg, struct interp_ctx *ctx) {
+	ctx->orig = dbg->orig;
+	ctx->traps = dbg->traps;
+	ctx->watch = dbg->watch;
+	ctx->trap_pc = -1;
+	ctx->trap_op = -1;
+}
+
+void debug_report(struct bf_debugger *dbg, const struct interp_ctx *ctx, FILE *out) {
+	const struct bf_op *op = dbg->orig + ctx->trap_op;
+	if (ctx->trap_kind == TRAP_BREAK) {
+		dbg->break_hits++;
+		fprintf(out, "break @%d: ptr %d, cell %d, step %llu\n",
+			op->src, ctx->ptr, ctx->tape[ctx->ptr], ctx->steps);
+	} else {
+		dbg->watch_hits++;
+		fprintf(out, "watch cell %d: %d -> %d @%d, step %llu\n",
+			ctx->ptr, ctx->watch_old, ctx->tape[ctx->ptr], op->src, ctx->steps);
+	}
+}
+
+void debug_summary(const struct bf_debugger *dbg, FILE *out) {
+	fprintf(out, "debug: %llu breaks, %llu watch hits\n", dbg->break_hits, dbg->watch_hits);
+}
+
+void debug_free(struct bf_debugger *dbg) {
+	if (!dbg)
+		return;
+	if (dbg->orig)
+		memcpy(dbg->prog->ops, dbg->orig, dbg->prog->len * sizeof(*dbg->orig));
+	free(dbg->orig);
+	free(dbg->traps);
+	free(dbg);
+}
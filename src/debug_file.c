@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "debug.h"
+#include "interp.h"
+#include "utils.h"
+
+// usage: bfDebug [--break offset]... [--watch cell]... [--stop-after n] file.bf
+int main(int argc, char *argv[]) {
+	const char *file = NULL;
+	int breaks[argc], watches[argc];
+	int num_breaks = 0, num_watches = 0;
+	long stop_after = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--break") && (i + 1 < argc))
+			breaks[num_breaks++] = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--watch") && (i + 1 < argc))
+			watches[num_watches++] = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--stop-after") && (i + 1 < argc))
+			stop_after = atol(argv[++i]);
+		else
+			file = argv[i];
+	}
+	if (!file)
+		raise_error(ERR_NO_ARGS);
+
+	long len;
+	char *src = bf_read_source(file, &len);
+	if (!src)
+		raise_error(ERR_NO_FILE);
+	struct bf_program prog;
+	enum err_type err = bf_compile(src, len, &prog);
+	free(src);
+	if (err != ERR_OK)
+		raise_error(err);
+
+	struct bf_debugger *dbg = debug_init(&prog);
+	if (!dbg)
+		raise_error(ERR_NO_MEM);
+	for (int i = 0; i < num_breaks; i++)
+		if (debug_break(dbg, breaks[i]) < 0)
+			fprintf(stderr, "warning: no instruction at or after offset %d\n", breaks[i]);
+	for (int i = 0; i < num_watches; i++)
+		if (debug_watch(dbg, watches[i]) != ERR_OK)
+			raise_error(ERR_INV_VAL);
+
+	int tape[BUFF_SIZE] = {0};
+	struct interp_ctx ctx;
+	if (interp_init(&ctx, &prog, NULL, tape) != ERR_OK)
+		raise_error(ERR_NO_MEM);
+	debug_attach(dbg, &ctx);
+
+	long hits = 0;
+	unsigned char byte;
+	enum interp_status status;
+	do {
+		status = interp_resume(&ctx);
+		fwrite(ctx.out, 1, ctx.out_len, stdout);
+		ctx.out_len = 0;
+
+		if (status == INTERP_TRAP) {
+			fflush(stdout);
+			debug_report(dbg, &ctx, stderr);
+			if (stop_after && (++hits >= stop_after))
+				break;
+		} else if (status == INTERP_NEED_INPUT) {
+			fflush(stdout);
+			int ch = getchar();
+			byte = ch;
+			if (ch == EOF)
+				interp_feed_eof(&ctx);
+			else
+				interp_feed(&ctx, &byte, 1);
+		}
+	} while (status != INTERP_DONE);
+
+	fflush(stdout);
+	debug_summary(dbg, stderr);
+	interp_free(&ctx);
+	debug_free(dbg);
+	bf_free_program(&prog);
+	return 0;
+}
@@ -0,0 +1,253 @@
+/** @file elf_emit.c
+ *  @brief Functions for compiling brainf into a native executable
+ *
+ *  Every op compiles to a fixed size sequence, so all the jump
+ *  targets are known before anything is emitted. Registers:
+ *  rbx holds the tape address and r12d the cell index, and the
+ *  read/write syscalls live in two shared subroutines after the
+ *  program, so ',' and '.' are a 5 byte call each.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "elf_emit.h"
+#include "interp.h"
+
+#define TAPE_BYTES (BUFF_SIZE * sizeof(int))
+#define CODE_OFFSET (sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr))
+#define PROLOGUE_SIZE 10
+
+// write(1, &tape[ptr], 1)
+static const unsigned char out_sub[] = {
+	0x4a, 0x8d, 0x34, 0xa3,			// lea rsi, [rbx + r12 * 4]
+	0xb8, 0x01, 0x00, 0x00, 0x00,		// mov eax, 1
+	0xbf, 0x01, 0x00, 0x00, 0x00,		// mov edi, 1
+	0xba, 0x01, 0x00, 0x00, 0x00,		// mov edx, 1
+	0x0f, 0x05,				// syscall
+	0xc3,					// ret
+};
+
+// tape[ptr] = read(0, ...) ? byte : -1
+static const unsigned char in_sub[] = {
+	0x4a, 0x8d, 0x34, 0xa3,			// lea rsi, [rbx + r12 * 4]
+	0xc7, 0x06, 0xff, 0xff, 0xff, 0xff,	// mov dword [rsi], -1
+	0x31, 0xc0,				// xor eax, eax
+	0x31, 0xff,				// xor edi, edi
+	0xba, 0x01, 0x00, 0x00, 0x00,		// mov edx, 1
+	0x0f, 0x05,				// syscall
+	0x85, 0xc0,				// test eax, eax
+	0x7e, 0x05,				// jle ret
+	0x0f, 0xb6, 0x06,			// movzx eax, byte [rsi]
+	0x89, 0x06,				// mov [rsi], eax
+	0xc3,					// ret
+};
+
+static const char shstrtab[] = "\0.text\0.bss\0.shstrtab";
+
+static int op_size(enum bf_opcode op) {
+	switch (op) {
+	case BF_ADD:
+	case BF_CLEAR:
+		return 8;
+	case BF_MOVE:
+		return 14;
+	case BF_OUT:
+	case BF_IN:
+		return 5;
+	case BF_JZ:
+	case BF_JNZ:
+		return 11;
+	case BF_END:
+		return 9;
+	case BF_TRAP:
+	case BF_PAR:
+		break;
+	}
+	return 0;
+}
+
+static inline unsigned char *put(unsigned char *out, const unsigned char *bytes, size_t len) {
+	memcpy(out, bytes, len);
+	return out + len;
+}
+
+static inline unsigned char *put32(unsigned char *out, unsigned int v) {
+	for (int i = 0; i < 4; i++)
+		*out++ = (v >> (8 * i)) & 0xff;
+	return out;
+}
+
+static inline unsigned char *put_jump(unsigned char *out, unsigned char cc, long from_end, long to) {
+	static const unsigned char cmp[] = { 0x42, 0x83, 0x3c, 0xa3, 0x00 };	// cmp dword [rbx + r12 * 4], 0
+	out = put(out, cmp, sizeof(cmp));
+	*out++ = 0x0f;
+	*out++ = cc;
+	return put32(out, (unsigned int) (to - from_end));
+}
+
+// pos[i] is the offset of op i from the start of the code
+static unsigned char *emit_ops(unsigned char *out, const struct bf_program *prog, const long *pos,
+		long out_at, long in_at, long bss_rel) {
+	static const unsigned char lea_tape[] = { 0x48, 0x8d, 0x1d };		// lea rbx, [rip + rel32]
+	static const unsigned char zero_ptr[] = { 0x45, 0x31, 0xe4 };		// xor r12d, r12d
+	static const unsigned char add_cell[] = { 0x42, 0x81, 0x04, 0xa3 };	// add dword [rbx + r12 * 4], imm32
+	static const unsigned char add_ptr[] = { 0x41, 0x81, 0xc4 };		// add r12d, imm32
+	static const unsigned char wrap_ptr[] = { 0x41, 0x81, 0xe4 };		// and r12d, imm32
+	static const unsigned char clear[] = { 0x42, 0xc7, 0x04, 0xa3 };	// mov dword [rbx + r12 * 4], imm32
+	static const unsigned char exit0[] = {
+		0xb8, 0x3c, 0x00, 0x00, 0x00,	// mov eax, 60
+		0x31, 0xff,			// xor edi, edi
+		0x0f, 0x05,			// syscall
+	};
+
+	out = put(out, lea_tape, sizeof(lea_tape));
+	out = put32(out, (unsigned int) (bss_rel - 7));
+	out = put(out, zero_ptr, sizeof(zero_ptr));
+
+	for (int i = 0; i < prog->len; i++) {
+		const struct bf_op *op = prog->ops + i;
+		long end = pos[i] + op_size(op->op);
+		switch (op->op) {
+		case BF_ADD:
+			out = put(out, add_cell, sizeof(add_cell));
+			out = put32(out, (unsigned int) op->arg);
+			break;
+		case BF_MOVE:
+			// BUFF_SIZE is a power of two, so the mask is move_ptr's wrap around
+			out = put(out, add_ptr, sizeof(add_ptr));
+			out = put32(out, (unsigned int) op->arg);
+			out = put(out, wrap_ptr, sizeof(wrap_ptr));
+			out = put32(out, BUFF_SIZE - 1);
+			break;
+		case BF_CLEAR:
+			out = put(out, clear, sizeof(clear));
+			out = put32(out, 0);
+			break;
+		case BF_OUT:
+		case BF_IN:
+			*out++ = 0xe8;	// call rel32
+			out = put32(out, (unsigned int) (((op->op == BF_OUT) ? out_at : in_at) - end));
+			break;
+		case BF_JZ:
+			out = put_jump(out, 0x84, end, pos[op->arg + 1]);	// je past the ]
+			break;
+		case BF_JNZ:
+			out = put_jump(out, 0x85, end, pos[op->arg + 1]);	// jne past the [
+			break;
+		case BF_END:
+			out = put(out, exit0, sizeof(exit0));
+			break;
+		case BF_TRAP:
+		case BF_PAR:
+			break;
+		}
+	}
+	out = put(out, out_sub, sizeof(out_sub));
+	return put(out, in_sub, sizeof(in_sub));
+}
+
+static void fill_headers(unsigned char *file, size_t code_len, size_t shoff, Elf64_Addr bss_addr) {
+	Elf64_Ehdr *eh = (Elf64_Ehdr *) file;
+	memcpy(eh->e_ident, ELFMAG, SELFMAG);
+	eh->e_ident[EI_CLASS] = ELFCLASS64;
+	eh->e_ident[EI_DATA] = ELFDATA2LSB;
+	eh->e_ident[EI_VERSION] = EV_CURRENT;
+	eh->e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	eh->e_type = ET_EXEC;
+	eh->e_machine = EM_X86_64;
+	eh->e_version = EV_CURRENT;
+	eh->e_entry = ELF_BASE_ADDR + CODE_OFFSET;
+	eh->e_phoff = sizeof(Elf64_Ehdr);
+	eh->e_shoff = shoff;
+	eh->e_ehsize = sizeof(Elf64_Ehdr);
+	eh->e_phentsize = sizeof(Elf64_Phdr);
+	eh->e_phnum = 2;
+	eh->e_shentsize = sizeof(Elf64_Shdr);
+	eh->e_shnum = 4;
+	eh->e_shstrndx = 3;
+
+	Elf64_Phdr *ph = (Elf64_Phdr *) (file + sizeof(Elf64_Ehdr));
+	ph[0].p_type = PT_LOAD;
+	ph[0].p_flags = PF_R | PF_X;
+	ph[0].p_offset = 0;
+	ph[0].p_vaddr = ph[0].p_paddr = ELF_BASE_ADDR;
+	ph[0].p_filesz = ph[0].p_memsz = CODE_OFFSET + code_len;
+	ph[0].p_align = ELF_PAGE_SIZE;
+
+	// nothing in the file, the loader zero fills it
+	ph[1].p_type = PT_LOAD;
+	ph[1].p_flags = PF_R | PF_W;
+	ph[1].p_offset = 0;
+	ph[1].p_vaddr = ph[1].p_paddr = bss_addr;
+	ph[1].p_filesz = 0;
+	ph[1].p_memsz = TAPE_BYTES;
+	ph[1].p_align = ELF_PAGE_SIZE;
+
+	size_t strtab_off = CODE_OFFSET + code_len;
+	Elf64_Shdr *sh = (Elf64_Shdr *) (file + shoff);
+	sh[1].sh_name = 1;
+	sh[1].sh_type = SHT_PROGBITS;
+	sh[1].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+	sh[1].sh_addr = ELF_BASE_ADDR + CODE_OFFSET;
+	sh[1].sh_offset = CODE_OFFSET;
+	sh[1].sh_size = code_len;
+	sh[1].sh_addralign = 16;
+
+	sh[2].sh_name = 7;
+	sh[2].sh_type = SHT_NOBITS;
+	sh[2].sh_flags = SHF_ALLOC | SHF_WRITE;
+	sh[2].sh_addr = bss_addr;
+	sh[2].sh_offset = strtab_off;
+	sh[2].sh_size = TAPE_BYTES;
+	sh[2].sh_addralign = 16;
+
+	sh[3].sh_name = 12;
+	sh[3].sh_type = SHT_STRTAB;
+	sh[3].sh_offset = strtab_off;
+	sh[3].sh_size = sizeof(shstrtab);
+	sh[3].sh_addralign = 1;
+}
+
+enum err_type bf_emit_elf(const struct bf_program *prog, const char *path) {
+	long *pos = calloc(prog->len + 1, sizeof(*pos));
+	if (!pos)
+		return ERR_NO_MEM;
+
+	pos[0] = PROLOGUE_SIZE;
+	for (int i = 0; i < prog->len; i++)
+		pos[i + 1] = pos[i] + op_size(prog->ops[i].op);
+	long out_at = pos[prog->len];
+	long in_at = out_at + sizeof(out_sub);
+	size_t code_len = in_at + sizeof(in_sub);
+
+	size_t shoff = (CODE_OFFSET + code_len + sizeof(shstrtab) + 7) & ~(size_t) 7;
+	size_t file_len = shoff + 4 * sizeof(Elf64_Shdr);
+	Elf64_Addr code_addr = ELF_BASE_ADDR + CODE_OFFSET;
+	Elf64_Addr bss_addr = (ELF_BASE_ADDR + CODE_OFFSET + code_len + 2 * ELF_PAGE_SIZE - 1) & ~(Elf64_Addr) (ELF_PAGE_SIZE - 1);
+
+	unsigned char *file = calloc(file_len, 1);
+	if (!file) {
+		free(pos);
+		return ERR_NO_MEM;
+	}
+
+	emit_ops(file + CODE_OFFSET, prog, pos, out_at, in_at, (long) (bss_addr - code_addr));
+	memcpy(file + CODE_OFFSET + code_len, shstrtab, sizeof(shstrtab));
+	fill_headers(file, code_len, shoff, bss_addr);
+	free(pos);
+
+	FILE *fp = fopen(path, "wb");
+	bool ok = fp && (fwrite(file, 1, file_len, fp) == file_len);
+	if (fp)
+		ok = (fclose(fp) == 0) && ok;
+	free(file);
+	if (!ok || (chmod(path, 0755) != 0))
+		return ERR_NO_FILE;
+	return ERR_OK;
+}
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "elf_emit.h"
+#include "utils.h"
+
+// usage: bfElf file.bf [-o out]
+int main(int argc, char *argv[]) {
+	const char *in = NULL, *out = "a.out";
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-o") && (i + 1 < argc))
+			out = argv[++i];
+		else
+			in = argv[i];
+	}
+	if (!in)
+		raise_error(ERR_NO_ARGS);
+
+	long len;
+	char *src = bf_read_source(in, &len);
+	if (!src)
+		raise_error(ERR_NO_FILE);
+
+	struct bf_program prog;
+	enum err_type err = bf_compile(src, len, &prog);
+	free(src);
+	if (err != ERR_OK)
+		raise_error(err);
+
+	err = bf_emit_elf(&prog, out);
+	bf_free_program(&prog);
+	if (err != ERR_OK)
+		raise_error(err);
+	return 0;
+}
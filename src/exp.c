@@ -1,7 +1,7 @@
 /** @file exp.c
  *  @brief utility functions for the expression struct.
  * 
- *  contains freeing, printing, initializing
+ *  contains printing, initializing
  *  and checker functions for exp. Most checker
  *  functions are in the individual files
  *  they're called in, but that may change.
@@ -10,144 +10,94 @@
  *  @bug no known bugs
  */
 
+#include "arena.h"
 #include "parser.h"
 #include "utils.h"
 #include "exp.h"
 #include "lexer.h"
+#include "walk.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
 
 
-static void free_exp_contents(struct exp *exp) {
-	if (!exp)
-		return;
+// print_exp goes through ast_walk, so these print a node on the way
+// in, between its children, and on the way out
+static void print_exp_pre(struct ast_node node, void *data) {
+	const struct exp *exp = node.exp;
 	switch (exp->type) {
 	case EXP_EMPTY:
-	case EXP_NUM:
+		printf("EMPTY()");
 		break;
 	case EXP_NAME:
-		if (!exp->name)
-			return;
-		free(exp->name);
-		exp->name = NULL;
-		break;
-	case EXP_ARRAY_REF:
-		if (!exp->array_ref)
-			return;
-		free_exp(exp->array_ref->name);
-		exp->array_ref->name = NULL;
-		free_exp(exp->array_ref->index);
-		exp->array_ref->index = NULL;
-		free(exp->array_ref);
-		exp->array_ref = NULL;
+		printf("NAME(%s)", exp->name);
 		break;
-	case EXP_ARRAY_LIT:
-		if (!exp->array_lit)
-			return;
-		if (!exp->array_lit->array)
-			return;
-		for (int i = 0; i < exp->array_lit->size; i++)
-			free_exp_contents(&exp->array_lit->array[i]);  // Pass address, not iterate
-		free(exp->array_lit->array);
-		exp->array_lit->array = NULL;
-		free(exp->array_lit);
-		exp->array_lit = NULL;
+	case EXP_NUM:
+		printf("NUM(%d)", exp->num);
 		break;
 	case EXP_ASSIGN_OP:
 	case EXP_BINARY_OP:
-		if (!exp->op)
-			return;
-		free_exp(exp->op->left);
-		exp->op->left = NULL;
-		free_exp(exp->op->right);
-		exp->op->right = NULL;
-		free(exp->op);
-		exp->op = NULL;
+		printf("OP(");
 		break;
 	case EXP_UNARY:
-		if (!exp->unary)
-			return;
-		free_exp(exp->unary->operand);
-		exp->unary->operand = NULL;
-		free(exp->unary);
-		exp->unary = NULL;
+		if (exp->unary->is_prefix)
+			printf("UNARY(%s, ", getOpStr(exp->unary->op));
+		else
+			printf("UNARY(");
 		break;
 	case EXP_CALL:
-		if (!exp->call)
-			return;
-		free_exp(exp->call->arg);
-		exp->call->arg = NULL;
-		free(exp->call);
-		exp->call = NULL;
+		printf("CALL(%s, ", getKeyStr(exp->call->key));
+		break;
+	case EXP_ARRAY_REF:
+		printf("ARR(");
+		break;
+	case EXP_ARRAY_LIT:
+		printf("ARR_LIT(");
 		break;
 	}
 }
 
-void free_exp(struct exp *exp) {
-    	free_exp_contents(exp);
-    	free(exp);
+// only ops, array refs and array literals have more than one child
+static void print_exp_in(struct ast_node node, int child, void *data) {
+	const struct exp *exp = node.exp;
+	if ((exp->type == EXP_ASSIGN_OP) || (exp->type == EXP_BINARY_OP))
+		printf(", %s, ", getOpStr(exp->op->op));
+	else
+		printf(", ");
 }
 
-void print_exp(const struct exp *exp) {
-    	if (!exp)
-		return;
-
+static void print_exp_post(struct ast_node node, void *data) {
+	const struct exp *exp = node.exp;
 	switch (exp->type) {
 	case EXP_EMPTY:
-		printf("EMPTY()");
-		break;
 	case EXP_NAME:
-		printf("NAME(%s)", exp->name);
-		break;
 	case EXP_NUM:
-		printf("NUM(%d)", exp->num);
-		break;
-	case EXP_ASSIGN_OP:
-	case EXP_BINARY_OP:
-		printf("OP(");
-		print_exp(exp->op->left);
-		printf(", %s, ", getOpStr(exp->op->op));
-		print_exp(exp->op->right);
-		printf(")");
 		break;
 	case EXP_UNARY:
-		printf("UNARY(");
-		if (exp->unary->is_prefix) {
-			printf("%s, ", getOpStr(exp->op->op));
-			print_exp(exp->unary->operand);
+		if (exp->unary->is_prefix)
 			printf(")");
-		} else {
-			print_exp(exp->unary->operand);
+		else
 			printf(", %s)", getOpStr(exp->unary->op));
-		}
 		break;
+	case EXP_ASSIGN_OP:
+	case EXP_BINARY_OP:
 	case EXP_CALL:
-		printf("CALL(%s, ", getKeyStr(exp->call->key));
-		print_exp(exp->call->arg);
-		printf(")");
-		break;
 	case EXP_ARRAY_REF:
-		printf("ARR(");
-		print_exp(exp->array_ref->name);
-		printf(", ");
-		print_exp(exp->array_ref->index);
-		printf(")");
-		break;
 	case EXP_ARRAY_LIT:
-		printf("ARR_LIT(");
-		for(int i = 0; i < exp->array_lit->size; i++) {
-			print_exp(exp->array_lit->array + i);
-			if (i < exp->array_lit->size - 1)
-				printf(", ");
-		}
 		printf(")");
+		break;
 	}
 }
 
-// initialization functions
+const struct ast_visitor print_exp_visitor = {print_exp_pre, print_exp_in, print_exp_post};
+
+void print_exp(const struct exp *exp) {
+	ast_walk(exp_node(exp), &print_exp_visitor, NULL);
+}
+
+// initialization functions, everything comes from the parse's arena (see arena.h)
 struct exp *init_exp(struct lexer_ctx *lex) {
-	struct exp  *exp = calloc(1, sizeof(*exp));
+	struct exp  *exp = ast_alloc(lex->arena, sizeof(*exp));
 	
 	if (!exp)
 		raise_syntax_error(ERR_NO_MEM, lex);
@@ -160,20 +110,18 @@ struct exp *init_exp(struct lexer_ctx *lex) {
 
 void init_binary(struct lexer_ctx *lex, struct exp *exp, enum exp_type tp, struct exp *left) {
 	exp->type = tp;
-	exp->op = calloc(1, sizeof(*(exp->op)));
+	exp->op = ast_alloc(lex->arena, sizeof(*(exp->op)));
 	exp->line_num = lex->line_num;
 	exp->start_col = lex->val.start_pos;
 
-	if (!exp->op) {
-		free_exp(left);
+	if (!exp->op)
 		raise_syntax_error(ERR_NO_MEM, lex);
-	}
 	exp->op->left = left;
 }
 
 void init_exp_unary(struct lexer_ctx *lex, struct exp *exp, bool is_prefix) {
 	exp->type = EXP_UNARY;
-	exp->unary = calloc(1, sizeof(*(exp->unary)));
+	exp->unary = ast_alloc(lex->arena, sizeof(*(exp->unary)));
 	exp->line_num = lex->line_num;
 	exp->start_col = lex->val.start_pos;
 
@@ -184,34 +132,39 @@ void init_exp_unary(struct lexer_ctx *lex, struct exp *exp, bool is_prefix) {
 
 void init_exp_array_ref(struct lexer_ctx *lex, struct exp *exp, struct exp *name) {
 	exp->type = EXP_ARRAY_REF;
-	exp->array_ref = calloc(1, sizeof(*exp->array_ref));
+	exp->array_ref = ast_alloc(lex->arena, sizeof(*exp->array_ref));
 	exp->line_num = lex->line_num;
 	exp->start_col = lex->val.start_pos;
 
-	if (!exp->array_ref) {
-		free_exp(name);
+	if (!exp->array_ref)
 		raise_syntax_error(ERR_NO_MEM, lex);
-	}
 	exp->array_ref->name = name;
 }
 
 void init_exp_array_lit(struct lexer_ctx *lex, struct exp *exp, int size) {
 	exp->type = EXP_ARRAY_LIT;
-	exp->array_lit = calloc(1, sizeof(*exp->array_lit));
+	exp->array_lit = ast_alloc(lex->arena, sizeof(*exp->array_lit));
 	exp->line_num = lex->line_num;
 	exp->start_col = lex->val.start_pos;
 
 	if (!exp->array_lit)
 		raise_syntax_error(ERR_NO_MEM, lex);
 
-	exp->array_lit->array = calloc(size + 1, sizeof(*(exp->array_lit->array)));
+	exp->array_lit->array = ast_alloc(lex->arena, (size + 1) * sizeof(*(exp->array_lit->array)));
 	exp->array_lit->size = size;
 
-	if (!exp->array_lit->array) {
-		free(exp->array_lit);
-		exp->array_lit = NULL;
+	if (!exp->array_lit->array)
 		raise_syntax_error(ERR_NO_MEM, lex);
-	}	
+}
+
+void grow_exp_arraylit(struct lexer_ctx *lex, struct exp *exp) {
+	int size = exp->array_lit->size;
+	struct exp *tmp = ast_realloc(lex->arena, exp->array_lit->array,
+		(size + 1) * sizeof(*tmp), ((size * 2) + 1) * sizeof(*tmp));
+	if (!tmp)
+		raise_syntax_error(ERR_NO_MEM, lex);
+	exp->array_lit->array = tmp;
+	exp->array_lit->size = size * 2;
 }
 
 void set_exp_arraylit_len(struct lexer_ctx *lex, struct exp *exp, int final_len) {
@@ -219,18 +172,18 @@ void set_exp_arraylit_len(struct lexer_ctx *lex, struct exp *exp, int final_len)
 		return;
 
 
-	struct exp *tmp = realloc(exp->array_lit->array, final_len * sizeof(*tmp));
+	// gives the space back if nothing's been allocated after it
+	struct exp *tmp = ast_realloc(lex->arena, exp->array_lit->array,
+		(exp->array_lit->size + 1) * sizeof(*tmp), (final_len + 1) * sizeof(*tmp));
 	if (!tmp)
 		raise_syntax_error(ERR_NO_MEM, lex);
-	/*for (int i = 0; i < final_len; i++)
-		swap_exps(tmp + i, exp->array_lit->array + i);*/
 	exp->array_lit->array = tmp;
 	exp->array_lit->size = final_len;
 }
 
 void init_exp_call(struct lexer_ctx *lex, struct exp *exp, enum key_type key) {
 	exp->type = EXP_CALL;
-	exp->call = calloc(1, sizeof(*exp->call));
+	exp->call = ast_alloc(lex->arena, sizeof(*exp->call));
 	exp->line_num = lex->line_num;
 	exp->start_col = lex->val.start_pos;
 
@@ -241,53 +194,41 @@ void init_exp_call(struct lexer_ctx *lex, struct exp *exp, enum key_type key) {
 
 
 
-void swap_exps(struct exp *from, struct exp *to) {
-	struct exp tmp = *from;
-	*from = *to;
-	*to = tmp;
+bool exp_nodes_match(const struct exp *exp1, const struct exp *exp2) {
+	if (exp1->type != exp2->type)
+		return false;
+
+	switch (exp1->type) {
+	case EXP_EMPTY:
+	case EXP_ARRAY_REF:
+		return true;
+	case EXP_NAME:
+		return exp1->name == exp2->name;
+	case EXP_NUM:
+		return exp1->num == exp2->num;
+	case EXP_UNARY:
+		return (exp1->unary->op == exp2->unary->op) && (exp1->unary->is_prefix == exp2->unary->is_prefix);
+	case EXP_ASSIGN_OP:
+	case EXP_BINARY_OP:
+		return exp1->op->op == exp2->op->op;
+	case EXP_CALL:
+		return exp1->call->key == exp2->call->key;
+	case EXP_ARRAY_LIT:
+		return exp1->array_lit->size == exp2->array_lit->size;
+	default:
+		raise_error(ERR_INV_EXP);
+		return false;
+	}
+}
+
+static bool exp_walks_match(struct ast_node a, struct ast_node b) {
+	return exp_nodes_match(a.exp, b.exp);
 }
 
 bool exps_match(struct exp *exp1, struct exp *exp2) {
-    if (!exp1 != !exp2)
-        return false;
-    else if (exp1 == exp2)
-        return true;
-    else if (exp1->type != exp2->type)
-        return false;
-
-    switch (exp1->type) {
-    case EXP_EMPTY:
-        return true;
-    case EXP_NAME:
-        return !strcmp(exp1->name, exp2->name);
-    case EXP_NUM:
-        return exp1->num == exp2->num;
-    case EXP_UNARY:
-	return (exp1->unary->op == exp2->unary->op) && 
-		exps_match(exp1->unary->operand, exp2->unary->operand);
-    case EXP_ASSIGN_OP:
-    case EXP_BINARY_OP:
-        return (exp1->op->op == exp2->op->op) && 
-		exps_match(exp1->op->left, exp2->op->left) &&
-		exps_match(exp1->op->right, exp2->op->right);
-    case EXP_CALL:
-        return exp1->call->key == exp2->call->key &&
-               exps_match(exp1->call->arg, exp2->call->arg);
-    case EXP_ARRAY_REF:
-        return exps_match(exp1->array_ref->name, exp2->array_ref->name) &&
-               exps_match(exp1->array_ref->index, exp2->array_ref->index);
-    case EXP_ARRAY_LIT:
-        if (exp1->array_lit->size != exp2->array_lit->size)
-            return false;
-        for (int i = 0; i < exp1->array_lit->size; i++)
-            if (!exps_match(&exp1->array_lit->array[i], 
-                            &exp2->array_lit->array[i]))
-                return false;
-        return true;
-    default:
-        raise_error(ERR_INV_EXP);
-        return false;
-    }
+	if (exp1 == exp2) //handles the two pointing to the same address and both being null
+		return true;
+	return ast_walks_match(exp_node(exp1), exp_node(exp2), exp_walks_match);
 }
 
 bool exps_are_compatable(struct exp *exp1, struct exp *exp2) {
@@ -0,0 +1,364 @@
+/** @file flat_ast.c
+ *  @brief Functions for the flat (struct of arrays) AST.
+ *
+ *  This contains flattening the stmt tree (a block's statements,
+ *  and an array literal's elements, are done in a loop, so only
+ *  nesting recurses), freeing, and printing it back out the same
+ *  way print_stmt does, so the two can be compared.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "arena.h"
+#include "flat_ast.h"
+#include "lexer.h"
+
+// the arrays are all grown together, so one failing leaves the rest bigger, which is fine
+static bool grow_nodes(struct flat_ast *ast, uint32_t cap) {
+	if (cap <= ast->cap)
+		return false;
+
+	void *kind = realloc(ast->kind, cap * sizeof(*ast->kind));
+	if (kind)
+		ast->kind = kind;
+	void *op = realloc(ast->op, cap * sizeof(*ast->op));
+	if (op)
+		ast->op = op;
+	void *line = realloc(ast->line, cap * sizeof(*ast->line));
+	if (line)
+		ast->line = line;
+	void *col = realloc(ast->col, cap * sizeof(*ast->col));
+	if (col)
+		ast->col = col;
+	void *a = realloc(ast->a, cap * sizeof(*ast->a));
+	if (a)
+		ast->a = a;
+	void *b = realloc(ast->b, cap * sizeof(*ast->b));
+	if (b)
+		ast->b = b;
+	void *c = realloc(ast->c, cap * sizeof(*ast->c));
+	if (c)
+		ast->c = c;
+	void *next = realloc(ast->next, cap * sizeof(*ast->next));
+	if (next)
+		ast->next = next;
+
+	if (!kind || !op || !line || !col || !a || !b || !c || !next)
+		return false;
+	ast->cap = cap;
+	return true;
+}
+
+// a new node with no children, or FLAT_NONE if out of memory
+static uint32_t new_node(struct flat_ast *ast, enum flat_kind kind, int line, int col) {
+	if ((ast->len >= ast->cap) && !grow_nodes(ast, ast->cap ? ast->cap * 2 : FLAT_START_CAP))
+		return FLAT_NONE;
+
+	uint32_t node = ast->len++;
+	ast->kind[node] = kind;
+	ast->op[node] = 0;
+	ast->line[node] = line;
+	ast->col[node] = col;
+	ast->a[node] = ast->b[node] = ast->c[node] = ast->next[node] = FLAT_NONE;
+	return node;
+}
+
+static bool add_name(struct flat_ast *ast, char *name, uint32_t *index) {
+	if (ast->num_names >= ast->names_cap) {
+		uint32_t cap = ast->names_cap ? ast->names_cap * 2 : FLAT_START_CAP;
+		char **names = realloc(ast->names, cap * sizeof(*names));
+		if (!names)
+			return false;
+		ast->names = names;
+		ast->names_cap = cap;
+	}
+	*index = ast->num_names;
+	ast->names[ast->num_names++] = name;
+	return true;
+}
+
+// the arrays can move while a child's being flattened, so children are
+// always flattened into a local first, and then stored.
+// Any of these returning FLAT_NONE for something that isn't NULL is out of memory.
+
+static uint32_t flatten_exp(struct flat_ast *ast, const struct exp *exp);
+
+static uint32_t flatten_children(struct flat_ast *ast, uint32_t node, const struct exp *left, const struct exp *right) {
+	uint32_t a = flatten_exp(ast, left);
+	if (left && !a)
+		return FLAT_NONE;
+	ast->a[node] = a;
+
+	uint32_t b = flatten_exp(ast, right);
+	if (right && !b)
+		return FLAT_NONE;
+	ast->b[node] = b;
+	return node;
+}
+
+static uint32_t flatten_exp(struct flat_ast *ast, const struct exp *exp) {
+	if (!exp)
+		return FLAT_NONE;
+
+	uint32_t node = new_node(ast, FLAT_EMPTY, exp->line_num, exp->start_col);
+	if (!node)
+		return FLAT_NONE;
+
+	switch (exp->type) {
+	case EXP_EMPTY:
+		break;
+	case EXP_NAME:
+		ast->kind[node] = FLAT_NAME;
+		uint32_t index;
+		if (!add_name(ast, exp->name, &index))
+			return FLAT_NONE;
+		ast->a[node] = index;
+		break;
+	case EXP_NUM:
+		ast->kind[node] = FLAT_NUM;
+		ast->a[node] = (uint32_t) exp->num;
+		break;
+	case EXP_ARRAY_REF:
+		ast->kind[node] = FLAT_ARRAY_REF;
+		return flatten_children(ast, node, exp->array_ref->name, exp->array_ref->index);
+	case EXP_ARRAY_LIT:
+		ast->kind[node] = FLAT_ARRAY_LIT;
+		ast->b[node] = exp->array_lit->size;
+		uint32_t prev = FLAT_NONE;
+		for (int i = 0; i < exp->array_lit->size; i++) {
+			uint32_t elem = flatten_exp(ast, exp->array_lit->array + i);
+			if (!elem)
+				return FLAT_NONE;
+			if (prev)
+				ast->next[prev] = elem;
+			else
+				ast->a[node] = elem;
+			prev = elem;
+		}
+		break;
+	case EXP_ASSIGN_OP:
+	case EXP_BINARY_OP:
+		ast->kind[node] = (exp->type == EXP_ASSIGN_OP) ? FLAT_ASSIGN_OP : FLAT_BINARY_OP;
+		ast->op[node] = exp->op->op;
+		return flatten_children(ast, node, exp->op->left, exp->op->right);
+	case EXP_UNARY:
+		ast->kind[node] = exp->unary->is_prefix ? FLAT_PREFIX : FLAT_SUFFIX;
+		ast->op[node] = exp->unary->op;
+		return flatten_children(ast, node, exp->unary->operand, NULL);
+	case EXP_CALL:
+		ast->kind[node] = FLAT_CALL;
+		ast->op[node] = exp->call->key;
+		return flatten_children(ast, node, exp->call->arg, NULL);
+	}
+	return node;
+}
+
+static uint32_t flatten_block(struct flat_ast *ast, const struct stmt *stmt);
+
+static uint32_t flatten_one(struct flat_ast *ast, const struct stmt *stmt) {
+	uint32_t node = new_node(ast, FLAT_STMT_EMPTY, stmt->line_num, stmt->start_col);
+	if (!node)
+		return FLAT_NONE;
+
+	uint32_t child;
+	switch (stmt->type) {
+	case STMT_EMPTY:
+		break;
+	case STMT_VAR:
+		ast->kind[node] = stmt->var->is_mutable ? FLAT_VAR : FLAT_VAL;
+		return flatten_children(ast, node, stmt->var->name, stmt->var->value);
+	case STMT_LOOP:
+		ast->kind[node] = FLAT_LOOP;
+		if (!flatten_children(ast, node, stmt->loop->cond, NULL))
+			return FLAT_NONE;
+		child = flatten_block(ast, stmt->loop->body);
+		if (stmt->loop->body && !child)
+			return FLAT_NONE;
+		ast->b[node] = child;
+		break;
+	case STMT_IF:
+		ast->kind[node] = FLAT_IF;
+		if (!flatten_children(ast, node, stmt->ifStmt->cond, NULL))
+			return FLAT_NONE;
+		child = flatten_block(ast, stmt->ifStmt->thenStmt);
+		if (stmt->ifStmt->thenStmt && !child)
+			return FLAT_NONE;
+		ast->b[node] = child;
+		child = flatten_block(ast, stmt->ifStmt->elseStmt);
+		if (stmt->ifStmt->elseStmt && !child)
+			return FLAT_NONE;
+		ast->c[node] = child;
+		break;
+	case STMT_EXPR:
+		ast->kind[node] = FLAT_EXPR;
+		return flatten_children(ast, node, stmt->exp, NULL);
+	}
+	return node;
+}
+
+// a statement and the ones after it
+static uint32_t flatten_block(struct flat_ast *ast, const struct stmt *stmt) {
+	uint32_t first = FLAT_NONE, prev = FLAT_NONE;
+	for (; stmt; stmt = (stmt->next != stmt) ? stmt->next : NULL) {
+		uint32_t node = flatten_one(ast, stmt);
+		if (!node)
+			return FLAT_NONE;
+		if (prev)
+			ast->next[prev] = node;
+		else
+			first = node;
+		prev = node;
+	}
+	return first;
+}
+
+struct flat_ast *flatten_stmt(const struct stmt *root) {
+	struct flat_ast *ast = calloc(1, sizeof(*ast));
+	if (!ast)
+		return NULL;
+
+	// every node is at least an exp's worth of the arena, so this is
+	// enough room for all of them without growing (and copying) the arrays
+	size_t guess = root ? ast_arena_used(ast_arena_of((struct stmt *) root)) / sizeof(struct exp) : 0;
+	grow_nodes(ast, (guess < UINT32_MAX / 2) ? guess + 2 : FLAT_START_CAP);
+
+	// node 0 is FLAT_NONE, so the root is FLAT_ROOT
+	new_node(ast, FLAT_EMPTY, 0, 0);
+	if ((ast->len != 1) || (root && (flatten_block(ast, root) != FLAT_ROOT))) {
+		free_flat_ast(ast);
+		return NULL;
+	}
+	return ast;
+}
+
+void free_flat_ast(struct flat_ast *ast) {
+	if (!ast)
+		return;
+	if (ast->map) {
+		// the arrays are all in the cache it was loaded from
+		munmap(ast->map, ast->map_len);
+	} else {
+		free(ast->kind);
+		free(ast->op);
+		free(ast->line);
+		free(ast->col);
+		free(ast->a);
+		free(ast->b);
+		free(ast->c);
+		free(ast->next);
+	}
+	free(ast->names);
+	free(ast);
+}
+
+//print functions
+void print_flat_exp(const struct flat_ast *ast, uint32_t exp) {
+	if (!exp)
+		return;
+
+	switch ((enum flat_kind) ast->kind[exp]) {
+	case FLAT_EMPTY:
+		printf("EMPTY()");
+		break;
+	case FLAT_NAME:
+		printf("NAME(%s)", flat_name(ast, exp));
+		break;
+	case FLAT_NUM:
+		printf("NUM(%d)", (int) ast->a[exp]);
+		break;
+	case FLAT_ASSIGN_OP:
+	case FLAT_BINARY_OP:
+		printf("OP(");
+		print_flat_exp(ast, ast->a[exp]);
+		printf(", %s, ", getOpStr(ast->op[exp]));
+		print_flat_exp(ast, ast->b[exp]);
+		printf(")");
+		break;
+	case FLAT_PREFIX:
+		printf("UNARY(%s, ", getOpStr(ast->op[exp]));
+		print_flat_exp(ast, ast->a[exp]);
+		printf(")");
+		break;
+	case FLAT_SUFFIX:
+		printf("UNARY(");
+		print_flat_exp(ast, ast->a[exp]);
+		printf(", %s)", getOpStr(ast->op[exp]));
+		break;
+	case FLAT_CALL:
+		printf("CALL(%s, ", getKeyStr(ast->op[exp]));
+		print_flat_exp(ast, ast->a[exp]);
+		printf(")");
+		break;
+	case FLAT_ARRAY_REF:
+		printf("ARR(");
+		print_flat_exp(ast, ast->a[exp]);
+		printf(", ");
+		print_flat_exp(ast, ast->b[exp]);
+		printf(")");
+		break;
+	case FLAT_ARRAY_LIT:
+		printf("ARR_LIT(");
+		for (uint32_t elem = ast->a[exp]; elem; elem = ast->next[elem]) {
+			print_flat_exp(ast, elem);
+			if (ast->next[elem])
+				printf(", ");
+		}
+		printf(")");
+		break;
+	default:
+		break;
+	}
+}
+
+void print_flat_stmt(const struct flat_ast *ast, uint32_t stmt) {
+	for (; stmt; stmt = ast->next[stmt]) {
+		switch ((enum flat_kind) ast->kind[stmt]) {
+		case FLAT_STMT_EMPTY:
+			printf("EMPTY();\n");
+			break;
+		case FLAT_VAR:
+		case FLAT_VAL:
+			printf("%s(", (ast->kind[stmt] == FLAT_VAR) ? "VAR" : "VAL");
+			print_flat_exp(ast, ast->a[stmt]);
+			if (ast->b[stmt]) {
+				printf(", ");
+				print_flat_exp(ast, ast->b[stmt]);
+			}
+			printf(");\n");
+			break;
+		case FLAT_LOOP:
+			printf("LOOP(");
+			print_flat_exp(ast, ast->a[stmt]);
+			printf(")");
+			if (ast->b[stmt]) {
+				printf(" {\n");
+				print_flat_stmt(ast, ast->b[stmt]);
+				printf("}\n");
+			} else {
+				printf(";\n");
+			}
+			break;
+		case FLAT_IF:
+			printf("IF(");
+			print_flat_exp(ast, ast->a[stmt]);
+			printf(") {\n");
+			print_flat_stmt(ast, ast->b[stmt]);
+			printf("} else {\n");
+			print_flat_stmt(ast, ast->c[stmt]);
+			printf("}\n");
+			break;
+		case FLAT_EXPR:
+			printf("EXP_");
+			print_flat_exp(ast, ast->a[stmt]);
+			printf(";\n");
+			break;
+		default:
+			break;
+		}
+	}
+}
@@ -0,0 +1,370 @@
+/** @file flat_cache.c
+ *  @brief Functions for the on-disk cache of the flat AST.
+ *
+ *  This contains hashing the source, checking and mapping in
+ *  a cache (nodes and all), writing one (with the names
+ *  deduplicated, so there are few to intern on load), and
+ *  parse_file_flat, which puts them together.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "flat_ast.h"
+#include "flat_cache.h"
+#include "intern.h"
+#include "lexer.h"
+#include "parser.h"
+#include "stmt.h"
+#include "utils.h"
+
+#define HASH_MUL 0x9E3779B97F4A7C15ULL
+
+static bool caching = false;
+
+void setAstCaching(bool on) {
+	caching = on;
+}
+
+// eight bytes at a time, since every run hashes the whole source
+uint64_t hash_source(const char *src, size_t len) {
+	uint64_t hash = len * HASH_MUL, word;
+	size_t i = 0;
+	for (; i + sizeof(word) <= len; i += sizeof(word)) {
+		memcpy(&word, src + i, sizeof(word));
+		hash = (hash ^ word) * HASH_MUL;
+		hash ^= hash >> 32;
+	}
+	word = 0;
+	memcpy(&word, src + i, len - i);
+	hash = (hash ^ word) * HASH_MUL;
+	return hash ^ (hash >> 29);
+}
+
+static inline uint64_t align_up(uint64_t off) {
+	return (off + FLAT_CACHE_ALIGN - 1) & ~(uint64_t) (FLAT_CACHE_ALIGN - 1);
+}
+
+//loading
+// count things of size bytes at off are in the file, after the header, and aligned
+static inline bool fits(const struct flat_cache_header *hdr, uint64_t off, uint64_t count, size_t size) {
+	return !(off % FLAT_CACHE_ALIGN) && (off >= sizeof(*hdr)) && (off <= hdr->file_len) &&
+		(count <= (hdr->file_len - off) / size);
+}
+
+static bool header_matches(const struct flat_cache_header *hdr, uint64_t file_len, const char *src, size_t src_len) {
+	if (memcmp(hdr->magic, FLAT_CACHE_MAGIC, sizeof(hdr->magic)) || (hdr->version != FLAT_CACHE_VERSION))
+		return false;
+	if ((hdr->src_len != src_len) || (hdr->file_len != file_len) || (hdr->src_hash != hash_source(src, src_len)))
+		return false;
+	if (hdr->len <= FLAT_ROOT)
+		return false;
+
+	uint32_t len = hdr->len;
+	return fits(hdr, hdr->kind, len, sizeof(uint8_t)) && fits(hdr, hdr->op, len, sizeof(uint8_t)) &&
+		fits(hdr, hdr->line, len, sizeof(int32_t)) && fits(hdr, hdr->col, len, sizeof(int32_t)) &&
+		fits(hdr, hdr->a, len, sizeof(uint32_t)) && fits(hdr, hdr->b, len, sizeof(uint32_t)) &&
+		fits(hdr, hdr->c, len, sizeof(uint32_t)) && fits(hdr, hdr->next, len, sizeof(uint32_t)) &&
+		fits(hdr, hdr->names, hdr->num_names, sizeof(uint32_t)) && fits(hdr, hdr->strs, hdr->strs_len, 1) &&
+		fits(hdr, hdr->src, src_len, 1);
+}
+
+// a child is FLAT_NONE or a later node, as flatten_stmt makes them
+static inline bool is_child(const struct flat_ast *ast, uint32_t node, uint32_t child) {
+	return !child || ((child > node) && (child < ast->len));
+}
+
+// one pass over the nodes, checking everything that's used as an index
+static bool nodes_valid(const struct flat_ast *ast, uint32_t num_names) {
+	for (uint32_t node = 1; node < ast->len; node++) {
+		uint32_t a = ast->a[node];
+		enum flat_kind kind = ast->kind[node];
+		// b is a count for an array literal, and c is only ever a child or unused
+		if (!is_child(ast, node, ast->next[node]) || !is_child(ast, node, ast->c[node]) ||
+				((kind != FLAT_ARRAY_LIT) && !is_child(ast, node, ast->b[node])))
+			return false;
+
+		switch (kind) {
+		case FLAT_NAME:
+			if (a >= num_names)
+				return false;
+			break;
+		case FLAT_NUM:
+			break;
+		case FLAT_ASSIGN_OP:
+		case FLAT_BINARY_OP:
+		case FLAT_PREFIX:
+		case FLAT_SUFFIX:
+			if (!getOpStr(ast->op[node]) || !is_child(ast, node, a))
+				return false;
+			break;
+		case FLAT_CALL:
+			if (!getKeyStr(ast->op[node]) || !is_child(ast, node, a))
+				return false;
+			break;
+		case FLAT_EMPTY:
+		case FLAT_ARRAY_REF:
+		case FLAT_ARRAY_LIT:
+		case FLAT_STMT_EMPTY:
+		case FLAT_VAR:
+		case FLAT_VAL:
+		case FLAT_LOOP:
+		case FLAT_IF:
+		case FLAT_EXPR:
+			if (!is_child(ast, node, a))
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+struct flat_ast *load_flat_cache(const char *path, const char *src, size_t src_len) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	// the header's read rather than mapped, so a miss doesn't map anything
+	struct stat st;
+	struct flat_cache_header hdr;
+	bool matches = (fstat(fd, &st) == 0) && (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)) &&
+		header_matches(&hdr, st.st_size, src, src_len);
+	// checking the nodes reads all of it, so it's faulted in up front
+	void *map = matches ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+	// the hash only says it's probably the same source
+	if (memcmp((char *) map + hdr.src, src, src_len)) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	struct flat_ast *ast = calloc(1, sizeof(*ast));
+	if (!ast) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	char *base = map;
+	ast->map = map;
+	ast->map_len = st.st_size;
+	ast->kind = (uint8_t *) (base + hdr.kind);
+	ast->op = (uint8_t *) (base + hdr.op);
+	ast->line = (int32_t *) (base + hdr.line);
+	ast->col = (int32_t *) (base + hdr.col);
+	ast->a = (uint32_t *) (base + hdr.a);
+	ast->b = (uint32_t *) (base + hdr.b);
+	ast->c = (uint32_t *) (base + hdr.c);
+	ast->next = (uint32_t *) (base + hdr.next);
+	ast->len = ast->cap = hdr.len;
+	if (!nodes_valid(ast, hdr.num_names)) {
+		free_flat_ast(ast);
+		return NULL;
+	}
+
+	// everything else compares names by pointer, so they're interned like the parser's are
+	ast->names = calloc(hdr.num_names ? hdr.num_names : 1, sizeof(*ast->names));
+	if (!ast->names) {
+		free_flat_ast(ast);
+		return NULL;
+	}
+	ast->num_names = ast->names_cap = hdr.num_names;
+	const uint32_t *offs = (const uint32_t *) (base + hdr.names);
+	const char *strs = base + hdr.strs;
+	for (uint32_t i = 0; i < hdr.num_names; i++) {
+		const char *name = strs + offs[i];
+		const char *end = (offs[i] < hdr.strs_len) ? memchr(name, '\0', hdr.strs_len - offs[i]) : NULL;
+		if (!end || !(ast->names[i] = (char *) intern(name, end - name))) {
+			free_flat_ast(ast);
+			return NULL;
+		}
+	}
+	return ast;
+}
+
+//writing
+// the flat_ast has a name per FLAT_NAME, the cache has each one once,
+// so this works out the distinct ones and which one each node has.
+// a is a copy of ast->a, with those nodes' indexes changed.
+static bool dedupe_names(const struct flat_ast *ast, uint32_t *a, char **distinct, uint32_t *num_distinct) {
+	uint32_t cap = 16, bits = 4;
+	while (cap < 2 * (uint64_t) ast->num_names) {
+		cap *= 2;
+		bits++;
+	}
+	char **keys = calloc(cap, sizeof(*keys));
+	uint32_t *vals = calloc(cap, sizeof(*vals));
+	if (!keys || !vals) {
+		free(keys);
+		free(vals);
+		return false;
+	}
+
+	*num_distinct = 0;
+	for (uint32_t node = 1; node < ast->len; node++) {
+		if (ast->kind[node] != FLAT_NAME)
+			continue;
+		char *name = ast->names[ast->a[node]];
+		uint32_t slot = (uint32_t) ((((uintptr_t) name) * HASH_MUL) >> (64 - bits));
+		while (keys[slot] && (keys[slot] != name))
+			slot = (slot + 1) & (cap - 1);
+		if (!keys[slot]) {
+			keys[slot] = name;
+			vals[slot] = *num_distinct;
+			distinct[(*num_distinct)++] = name;
+		}
+		a[node] = vals[slot];
+	}
+	free(keys);
+	free(vals);
+	return true;
+}
+
+// writes len bytes of data at off, padding up to it with zeroes
+static bool write_at(FILE *fp, uint64_t *pos, uint64_t off, const void *data, size_t len) {
+	static const char zeroes[FLAT_CACHE_ALIGN];
+	if ((off < *pos) || (off - *pos > sizeof(zeroes)) || (fwrite(zeroes, 1, off - *pos, fp) != off - *pos))
+		return false;
+	*pos = off + len;
+	return fwrite(data, 1, len, fp) == len;
+}
+
+static bool write_cache_file(FILE *fp, const struct flat_ast *ast, struct flat_cache_header *hdr,
+			const uint32_t *a, char **distinct, const uint32_t *offs, const char *src) {
+	uint64_t pos = 0;
+	bool ok = write_at(fp, &pos, 0, hdr, sizeof(*hdr)) &&
+		write_at(fp, &pos, hdr->kind, ast->kind, ast->len * sizeof(*ast->kind)) &&
+		write_at(fp, &pos, hdr->op, ast->op, ast->len * sizeof(*ast->op)) &&
+		write_at(fp, &pos, hdr->line, ast->line, ast->len * sizeof(*ast->line)) &&
+		write_at(fp, &pos, hdr->col, ast->col, ast->len * sizeof(*ast->col)) &&
+		write_at(fp, &pos, hdr->a, a, ast->len * sizeof(*a)) &&
+		write_at(fp, &pos, hdr->b, ast->b, ast->len * sizeof(*ast->b)) &&
+		write_at(fp, &pos, hdr->c, ast->c, ast->len * sizeof(*ast->c)) &&
+		write_at(fp, &pos, hdr->next, ast->next, ast->len * sizeof(*ast->next)) &&
+		write_at(fp, &pos, hdr->names, offs, hdr->num_names * sizeof(*offs));
+	for (uint32_t i = 0; ok && (i < hdr->num_names); i++)
+		ok = write_at(fp, &pos, hdr->strs + offs[i], distinct[i], strlen(distinct[i]) + 1);
+	return ok && write_at(fp, &pos, hdr->src, src, hdr->src_len);
+}
+
+bool write_flat_cache(const struct flat_ast *ast, const char *path, const char *src, size_t src_len) {
+	uint32_t *a = malloc(ast->len * sizeof(*a));
+	char **distinct = malloc((ast->num_names ? ast->num_names : 1) * sizeof(*distinct));
+	uint32_t *offs = malloc((ast->num_names ? ast->num_names : 1) * sizeof(*offs));
+	struct flat_cache_header hdr = {
+		.magic = FLAT_CACHE_MAGIC,
+		.version = FLAT_CACHE_VERSION,
+		.src_hash = hash_source(src, src_len),
+		.src_len = src_len,
+		.len = ast->len,
+	};
+	bool ok = a && distinct && offs;
+	if (ok) {
+		memcpy(a, ast->a, ast->len * sizeof(*a));
+		ok = dedupe_names(ast, a, distinct, &hdr.num_names);
+	}
+
+	if (ok) {
+		uint64_t off = align_up(sizeof(hdr));
+		hdr.kind = off;
+		hdr.op = off = align_up(off + ast->len * sizeof(*ast->kind));
+		hdr.line = off = align_up(off + ast->len * sizeof(*ast->op));
+		hdr.col = off = align_up(off + ast->len * sizeof(*ast->line));
+		hdr.a = off = align_up(off + ast->len * sizeof(*ast->col));
+		hdr.b = off = align_up(off + ast->len * sizeof(*ast->a));
+		hdr.c = off = align_up(off + ast->len * sizeof(*ast->b));
+		hdr.next = off = align_up(off + ast->len * sizeof(*ast->c));
+		hdr.names = off = align_up(off + ast->len * sizeof(*ast->next));
+		hdr.strs = align_up(off + hdr.num_names * sizeof(*offs));
+		for (uint32_t i = 0; i < hdr.num_names; i++) {
+			offs[i] = hdr.strs_len;
+			hdr.strs_len += strlen(distinct[i]) + 1;
+		}
+		hdr.src = align_up(hdr.strs + hdr.strs_len);
+		hdr.file_len = hdr.src + src_len;
+	}
+
+	// written to the side and renamed into place, so it's never seen half written
+	size_t tmp_len = strlen(path) + 32;
+	char *tmp = ok ? malloc(tmp_len) : NULL;
+	FILE *fp = NULL;
+	if (tmp) {
+		snprintf(tmp, tmp_len, "%s.%ld.tmp", path, (long) getpid());
+		fp = fopen(tmp, "wb");
+	}
+	if (fp) {
+		ok = write_cache_file(fp, ast, &hdr, a, distinct, offs, src);
+		ok = (fclose(fp) == 0) && ok;
+		ok = ok && (rename(tmp, path) == 0);
+		if (!ok)
+			unlink(tmp);
+	}
+	ok = ok && fp;
+
+	free(tmp);
+	free(a);
+	free(distinct);
+	free(offs);
+	return ok;
+}
+
+//parsing through the cache
+static struct flat_ast *flatten_parsed(struct stmt *root) {
+	// only the flat copy's wanted, so the tree can go straight away
+	struct flat_ast *ast = flatten_stmt(root);
+	free_stmt(root);
+	if (!ast)
+		raise_error(ERR_NO_MEM);
+	return ast;
+}
+
+struct flat_ast *parse_file_flat(const char *filename) {
+	if (!caching || !strcmp(filename, "-"))
+		return flatten_parsed(parse_file(filename));
+
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	if ((fd < 0) || (fstat(fd, &st) != 0)) {
+		if (fd >= 0)
+			close(fd);
+		raise_error(ERR_NO_FILE);
+	}
+	size_t len = st.st_size;
+	const char *src = "";
+	if (len) {
+		void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			raise_error(ERR_NO_FILE);
+		}
+		src = map;
+	}
+	close(fd);
+
+	size_t path_len = strlen(filename) + sizeof(FLAT_CACHE_SUFFIX);
+	char *path = malloc(path_len);
+	if (!path)
+		raise_error(ERR_NO_MEM);
+	snprintf(path, path_len, "%s%s", filename, FLAT_CACHE_SUFFIX);
+
+	struct flat_ast *ast = load_flat_cache(path, src, len);
+	if (!ast) {
+		// the source that was checked is the one that's parsed, even if the file's changed since
+		ast = flatten_parsed(parse_buffer(src, len, filename));
+		write_flat_cache(ast, path, src, len);
+	}
+
+	if (len)
+		munmap((void *) src, len);
+	free(path);
+	return ast;
+}
@@ -0,0 +1,114 @@
+/** @file intern.c
+ *  @brief Functions for the identifier intern table.
+ *
+ *  This contains the open addressing hash table (linear
+ *  probing, doubled at half full) and the arena the names
+ *  are copied into.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+struct intern_block {
+	struct intern_block *next;
+	size_t used, cap;
+	char data[];
+};
+
+struct intern_entry {
+	const char *str;	// NULL if the slot is empty
+	uint32_t hash;
+	uint32_t len;
+};
+
+static struct intern_entry *table = NULL;
+static size_t table_cap = 0, table_len = 0;
+static struct intern_block *blocks = NULL;
+
+static uint32_t hash_name(const char *str, size_t len) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char) str[i]) * 16777619u;
+	return hash;
+}
+
+// copies the name into the arena, starting a new block if it doesn't fit
+static const char *arena_copy(const char *str, size_t len) {
+	if (!blocks || (blocks->cap - blocks->used < len + 1)) {
+		size_t cap = (len + 1 > INTERN_BLOCK_SIZE) ? len + 1 : INTERN_BLOCK_SIZE;
+		struct intern_block *block = malloc(sizeof(*block) + cap);
+		if (!block)
+			return NULL;
+		block->next = blocks;
+		block->used = 0;
+		block->cap = cap;
+		blocks = block;
+	}
+
+	char *out = blocks->data + blocks->used;
+	memcpy(out, str, len);
+	out[len] = '\0';
+	blocks->used += len + 1;
+	return out;
+}
+
+static struct intern_entry *find_slot(struct intern_entry *entries, size_t cap,
+		const char *str, size_t len, uint32_t hash) {
+	size_t i = hash & (cap - 1);
+	while (entries[i].str && ((entries[i].hash != hash) || (entries[i].len != len) ||
+			memcmp(entries[i].str, str, len)))
+		i = (i + 1) & (cap - 1);
+	return entries + i;
+}
+
+static int grow_table(void) {
+	size_t cap = table_cap ? table_cap * 2 : INTERN_START_CAP;
+	struct intern_entry *entries = calloc(cap, sizeof(*entries));
+	if (!entries)
+		return -1;
+
+	for (size_t i = 0; i < table_cap; i++) {
+		struct intern_entry *old = table + i;
+		if (old->str)
+			*find_slot(entries, cap, old->str, old->len, old->hash) = *old;
+	}
+	free(table);
+	table = entries;
+	table_cap = cap;
+	return 0;
+}
+
+const char *intern(const char *str, size_t len) {
+	if (!str || (len > UINT32_MAX))
+		return NULL;
+	if ((table_len + 1) * 2 > table_cap && (grow_table() < 0))
+		return NULL;
+
+	uint32_t hash = hash_name(str, len);
+	struct intern_entry *slot = find_slot(table, table_cap, str, len, hash);
+	if (slot->str)
+		return slot->str;
+
+	const char *copy = arena_copy(str, len);
+	if (!copy)
+		return NULL;
+	*slot = (struct intern_entry) { copy, hash, len };
+	table_len++;
+	return copy;
+}
+
+void intern_free(void) {
+	while (blocks) {
+		struct intern_block *next = blocks->next;
+		free(blocks);
+		blocks = next;
+	}
+	free(table);
+	table = NULL;
+	table_cap = table_len = 0;
+}
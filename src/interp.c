@@ -3,101 +3,539 @@
  *
  *  This contains the functions that
  *  interpret brainf code.
- * 
+ *
  *  eventually, it'll also be able to interprate the ir into brainf
  *
  *  @author Hawkins Peterson (hawkins03)
  *  @bug No known bugs.
  */
 
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "debug.h"
 #include "interp.h"
+#include "memo.h"
+#include "parallel.h"
+#include "trace.h"
 
-void interp(char *input_buff) {
-    int len = strlen(input_buff);
-    int buff[BUFF_SIZE] = {0};
-    int *curr_ptr = buff;
-    int i = 0;
-    
-
-    int bracket_index = -1;
-    int num_open_brackets = 0;
-    int num_closed_brackets = 0;
-    for (int i = 0; i < len; i++) {
-	switch (input_buff[i]) {
-	    case '[':
-		num_open_brackets++;
-		break;
-	    case ']':
-		num_closed_brackets++;
+struct loop_count {
+	int pc;
+	unsigned long long iters;
+	unsigned long long entries;
+};
+
+static volatile sig_atomic_t profile_requested = 0;
+
+static void on_sigusr1(int sig) {
+	(void) sig;
+	profile_requested = 1;
+}
+
+void interp_stats_name(int pid, char *buf) {
+	snprintf(buf, STATS_SHM_NAME_LEN, STATS_SHM_PREFIX "%d", pid);
+}
+
+static struct interp_stats *open_stats(void) {
+	char name[STATS_SHM_NAME_LEN];
+	interp_stats_name(getpid(), name);
+
+	int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+		return NULL;
+	if (ftruncate(fd, sizeof(struct interp_stats)) < 0) {
+		close(fd);
+		shm_unlink(name);
+		return NULL;
 	}
-    }
-    if (num_open_brackets != num_closed_brackets) {
-	return;
-    }
 
-    int bracket_pairs[2][num_open_brackets];
+	struct interp_stats *out = mmap(NULL, sizeof(*out), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (out == MAP_FAILED) {
+		shm_unlink(name);
+		return NULL;
+	}
 
+	memset(out, 0, sizeof(*out));
+	out->pid = getpid();
+	out->running = true;
+	return out;
+}
 
-    int open_index = 0;
-    int closed_index = 0;
-    for (int i = 0; i < len; i++) {
-		switch (input_buff[i]) {
-			case '[':
-				bracket_pairs[0][open_index++] = i;
-				break;
-			case ']':
-				bracket_pairs[1][closed_index++] = i;
-				break;
+static void close_stats(struct interp_stats *shared) {
+	if (!shared)
+		return;
+	char name[STATS_SHM_NAME_LEN];
+	interp_stats_name(shared->pid, name);
+	munmap(shared, sizeof(*shared));
+	shm_unlink(name);
+}
+
+// seqlock style write, so a reader never sees a half updated snapshot
+static inline void publish_stats(struct interp_stats *shared, const struct interp_stats *local) {
+	unsigned int seq = shared->seq;
+	shared->seq = seq + 1;
+	__sync_synchronize();
+	shared->steps = local->steps;
+	shared->out_bytes = local->out_bytes;
+	shared->pc = local->pc;
+	shared->ptr = local->ptr;
+	shared->high_water = local->high_water;
+	shared->running = local->running;
+	__sync_synchronize();
+	shared->seq = seq + 2;
+}
+
+static int compare_loop_counts(const void *a, const void *b) {
+	unsigned long long x = ((const struct loop_count *) a)->iters;
+	unsigned long long y = ((const struct loop_count *) b)->iters;
+	return (x < y) - (x > y);
+}
+
+static void dump_profile(const struct interp_ctx *ctx) {
+	const struct interp_stats *local = &ctx->local;
+	fflush(stdout);
+	fprintf(stderr, "loop profile: %llu steps, pc %ld, ptr %ld, high water %ld, %llu bytes out\n",
+		local->steps, local->pc, local->ptr, local->high_water, local->out_bytes);
+	if (!ctx->iters)
+		return;
+
+	const struct bf_program *prog = ctx->prog;
+	struct loop_count *loops = calloc(prog->len + 1, sizeof(*loops));
+	if (!loops)
+		return;
+
+	int n = 0;
+	for (int i = 0; i < prog->len; i++) {
+		if ((prog->ops[i].op == BF_JZ) && ctx->entries[i]) {
+			loops[n].pc = prog->ops[i].src;
+			loops[n].iters = ctx->iters[i];
+			loops[n++].entries = ctx->entries[i];
 		}
-    }
-
-    
-    //interpret the input
-    while (i < len) {
-		switch (input_buff[i]) {
-			case '>':
-				curr_ptr += 1;
-				if (curr_ptr >= buff + BUFF_SIZE)
-					curr_ptr = buff;
-				break;
-			case '<':
-				curr_ptr -= 1;
-				if (curr_ptr < buff)
-					curr_ptr = buff + BUFF_SIZE - 1;
-				break;
-			case '+':
-				*curr_ptr += 1;
-				break;
-			case '-':
-				*curr_ptr -= 1;
-				break;
-			case '.':
-				printf("%c", (*curr_ptr & 0x000000ff));
-				break;
-			case ',':
-				*curr_ptr = getchar();
+	}
+	qsort(loops, n, sizeof(*loops), compare_loop_counts);
+
+	for (int i = 0; (i < n) && (i < PROFILE_TOP_LOOPS); i++)
+		fprintf(stderr, "  loop @%-8d %12llu iterations %10llu entries\n",
+			loops[i].pc, loops[i].iters, loops[i].entries);
+	free(loops);
+}
+
+static inline int move_ptr(int ptr, int by) {
+	ptr = (ptr + by) % BUFF_SIZE;
+	return (ptr < 0) ? ptr + BUFF_SIZE : ptr;
+}
+
+// taken back-edges are the only place counters leave the dispatch loop
+static inline void back_edge(struct interp_ctx *ctx, unsigned long long steps, long pc, int ptr, long high_water) {
+	ctx->local.steps = steps;
+	ctx->local.pc = pc;
+	ctx->local.ptr = ptr;
+	ctx->local.high_water = high_water;
+	if (ctx->shared)
+		publish_stats(ctx->shared, &ctx->local);
+	if (profile_requested) {
+		profile_requested = 0;
+		dump_profile(ctx);
+	}
+}
+
+static inline void suspend(struct interp_ctx *ctx, enum interp_status status, long pc, int ptr,
+		unsigned long long steps, long high_water) {
+	ctx->status = status;
+	ctx->pc = pc;
+	ctx->ptr = ptr;
+	ctx->steps = steps;
+	ctx->high_water = high_water;
+	ctx->local.steps = steps;
+	ctx->local.pc = ctx->compact ? pc : ctx->prog->ops[pc].src;
+	ctx->local.ptr = ptr;
+	ctx->local.high_water = high_water;
+}
+
+// reads the next input byte. Returns false if the caller has to feed more first.
+static inline bool read_input(struct interp_ctx *ctx, int *cell) {
+	if (ctx->in_len) {
+		*cell = *ctx->in++;
+		ctx->in_len--;
+		return true;
+	}
+	if (ctx->in_eof) {
+		*cell = EOF;
+		return true;
+	}
+	return false;
+}
+
+// tracing is a compile time constant in each caller, so the untraced
+// loop has no trace code in it at all
+static inline __attribute__((always_inline))
+enum interp_status run_wide(struct interp_ctx *ctx, const bool tracing) {
+	const struct bf_op *ops = ctx->prog->ops;
+	int *tape = ctx->tape;
+	unsigned long long *iters = ctx->iters;
+	unsigned long long *entries = ctx->entries;
+	struct memo_ctx *memo = ctx->memo;
+	bool counting = (iters != NULL);
+
+	unsigned long long steps = ctx->steps;
+	long high_water = ctx->high_water;
+	int ptr = ctx->ptr;
+	int pc = ctx->pc;
+	unsigned long long yield_at = ctx->quantum ? steps + ctx->quantum : ULLONG_MAX;
+
+	for (;;) {
+		const struct bf_op *op = ops + pc;
+		steps++;
+		if (tracing)
+			trace_push(ctx->trace, pc, ptr, tape[ptr]);
+dispatch:
+		switch (op->op) {
+		case BF_ADD:
+			tape[ptr] += op->arg;
+			break;
+		case BF_MOVE:
+			ptr = move_ptr(ptr, op->arg);
+			if (ptr > high_water)
+				high_water = ptr;
+			break;
+		case BF_OUT:
+			ctx->out[ctx->out_len++] = tape[ptr] & 0xff;
+			ctx->local.out_bytes++;
+			if (ctx->out_len == INTERP_OUT_CAP) {
+				suspend(ctx, INTERP_OUTPUT_READY, pc + 1, ptr, steps, high_water);
+				return ctx->status;
+			}
+			break;
+		case BF_IN:
+			if (!read_input(ctx, tape + ptr)) {
+				suspend(ctx, INTERP_NEED_INPUT, pc, ptr, steps - 1, high_water);
+				return ctx->status;
+			}
+			break;
+		case BF_CLEAR:
+			tape[ptr] = 0;
+			break;
+		case BF_JZ:
+			if (tape[ptr] == 0) {
+				pc = op->arg;
+			} else if (memo && memo_enter(memo, pc, tape, ptr)) {
+				pc = op->arg;
+			} else if (counting) {
+				entries[pc]++;
+				iters[pc]++;
+			}
+			break;
+		case BF_JNZ:
+			if (tape[ptr] == 0) {
+				if (memo)
+					memo_exit(memo, op->arg, tape);
 				break;
-			case '[': 
-				bracket_index++;
-				if ((*curr_ptr) == 0)
-					i = bracket_pairs[1][bracket_index];
+			}
+			pc = op->arg;
+			if (counting) {
+				iters[pc]++;
+				back_edge(ctx, steps, ops[pc].src, ptr, high_water);
+			}
+			if (tracing && trace_dump_requested) {
+				trace_dump_requested = 0;
+				trace_dump(ctx->trace);
+			}
+			if (steps >= yield_at) {
+				suspend(ctx, INTERP_YIELD, pc + 1, ptr, steps, high_water);
+				return ctx->status;
+			}
+			break;
+		case BF_END:
+			suspend(ctx, INTERP_DONE, pc, ptr, steps - 1, high_water);
+			return ctx->status;
+		case BF_PAR:
+			// par_run counts every step of the loops, this '[' included
+			steps--;
+			pc = par_run(ctx->par, op->arg, tape, &ptr, &high_water, &steps) - 1;
+			break;
+		case BF_TRAP:
+			// only patched programs get here, so unpatched runs pay nothing for it
+			if ((ctx->traps[pc] & TRAP_BREAK) && (ctx->trap_pc != pc)) {
+				ctx->trap_pc = ctx->trap_op = pc;
+				ctx->trap_kind = TRAP_BREAK;
+				suspend(ctx, INTERP_TRAP, pc, ptr, steps - 1, high_water);
+				return ctx->status;
+			}
+			ctx->trap_pc = -1;
+			op = ctx->orig + pc;
+			if (!(ctx->traps[pc] & TRAP_WATCH))
+				goto dispatch;
+
+			int old = tape[ptr];
+			if (op->op == BF_IN) {
+				if (!read_input(ctx, tape + ptr)) {
+					ctx->trap_pc = pc;
+					suspend(ctx, INTERP_NEED_INPUT, pc, ptr, steps - 1, high_water);
+					return ctx->status;
+				}
+			} else if (op->op == BF_ADD) {
+				tape[ptr] += op->arg;
+			} else {
+				tape[ptr] = 0;
+			}
+			if (ctx->watch[ptr] && (tape[ptr] != old)) {
+				ctx->trap_op = pc;
+				ctx->trap_kind = TRAP_WATCH;
+				ctx->watch_old = old;
+				suspend(ctx, INTERP_TRAP, pc + 1, ptr, steps, high_water);
+				return ctx->status;
+			}
+			break;
+		}
+		pc++;
+	}
+}
+
+static enum interp_status resume_wide(struct interp_ctx *ctx) {
+	return run_wide(ctx, false);
+}
+
+static enum interp_status resume_traced(struct interp_ctx *ctx) {
+	return run_wide(ctx, true);
+}
+
+static enum interp_status resume_compact(struct interp_ctx *ctx) {
+	const unsigned char *code = ctx->prog->code;
+	const unsigned char *pc = code + ctx->pc;
+	int *tape = ctx->tape;
+	bool counting = (ctx->shared != NULL);
+
+	unsigned long long steps = ctx->steps;
+	long high_water = ctx->high_water;
+	int ptr = ctx->ptr;
+	unsigned long long yield_at = ctx->quantum ? steps + ctx->quantum : ULLONG_MAX;
+
+	for (;;) {
+		const unsigned char *start = pc;
+		unsigned char byte = *pc++;
+		unsigned int operand = BC_SMALL(byte);
+		if (operand == BC_EXT)
+			operand = bc_read_varint(&pc);
+		steps++;
+
+		switch (BC_OP(byte)) {
+		case BF_ADD:
+			tape[ptr] += bc_unzigzag(operand);
+			break;
+		case BF_MOVE:
+			ptr = move_ptr(ptr, bc_unzigzag(operand));
+			if (ptr > high_water)
+				high_water = ptr;
+			break;
+		case BF_OUT:
+			ctx->out[ctx->out_len++] = tape[ptr] & 0xff;
+			ctx->local.out_bytes++;
+			if (ctx->out_len == INTERP_OUT_CAP) {
+				suspend(ctx, INTERP_OUTPUT_READY, pc - code, ptr, steps, high_water);
+				return ctx->status;
+			}
+			break;
+		case BF_IN:
+			if (!read_input(ctx, tape + ptr)) {
+				suspend(ctx, INTERP_NEED_INPUT, start - code, ptr, steps - 1, high_water);
+				return ctx->status;
+			}
+			break;
+		case BF_CLEAR:
+			tape[ptr] = 0;
+			break;
+		case BF_JZ:
+			if (tape[ptr] == 0)
+				pc += operand;
+			break;
+		case BF_JNZ:
+			if (tape[ptr] == 0)
 				break;
-			case ']':
-				bracket_index--;
-				if ((*curr_ptr) != 0)
-					i = bracket_pairs[0][bracket_index]; 
+			pc -= operand;
+			if (counting)
+				back_edge(ctx, steps, pc - code, ptr, high_water);
+			if (steps >= yield_at) {
+				suspend(ctx, INTERP_YIELD, pc - code, ptr, steps, high_water);
+				return ctx->status;
+			}
 			break;
-				default:
+		case BF_END:
+			suspend(ctx, INTERP_DONE, start - code, ptr, steps - 1, high_water);
+			return ctx->status;
+		case BF_TRAP:
+		case BF_PAR:
+			// only ever patched into the wide ops
+			break;
+		}
+	}
+}
+
+void interp_free(struct interp_ctx *ctx) {
+	free(ctx->iters);
+	ctx->iters = NULL;
+	free(ctx->entries);
+	ctx->entries = NULL;
+	memo_free(ctx->memo);
+	ctx->memo = NULL;
+	trace_free(ctx->trace);
+	ctx->trace = NULL;
+	par_free(ctx->par);
+	ctx->par = NULL;
+	if (ctx->shared) {
+		ctx->local.running = false;
+		publish_stats(ctx->shared, &ctx->local);
+		close_stats(ctx->shared);
+		ctx->shared = NULL;
+		signal(SIGUSR1, SIG_DFL);
+	}
+}
+
+enum err_type interp_init(struct interp_ctx *ctx, const struct bf_program *prog,
+		const struct interp_opts *opts, int *tape) {
+	struct interp_opts none = {0};
+	if (!opts)
+		opts = &none;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->prog = prog;
+	ctx->tape = tape;
+	ctx->local.running = true;
+	ctx->compact = opts->compact && prog->code && !opts->memo && !opts->profile && !opts->trace &&
+		!opts->parallel;
+
+	if (!ctx->compact && (opts->stats || opts->profile)) {
+		ctx->iters = calloc(prog->len + 1, sizeof(*ctx->iters));
+		ctx->entries = calloc(prog->len + 1, sizeof(*ctx->entries));
+		if (!ctx->iters || !ctx->entries) {
+			interp_free(ctx);
+			return ERR_NO_MEM;
+		}
+	}
+	if (!ctx->compact && opts->memo) {
+		ctx->memo = memo_init(prog->ops, prog->len, BUFF_SIZE);
+		if (!ctx->memo) {
+			interp_free(ctx);
+			return ERR_NO_MEM;
+		}
+	}
+
+	// the loops in a group run outside the dispatch loop, so nothing that counts per op
+	if (opts->parallel && !opts->memo && !opts->profile && !opts->trace) {
+		ctx->par = par_init(prog, BUFF_SIZE);
+		if (!ctx->par) {
+			interp_free(ctx);
+			return ERR_NO_MEM;
+		}
+		ctx->prog = par_program(ctx->par);
+	}
+
+	if (opts->trace) {
+		ctx->trace = trace_init(prog, opts->trace_len ? opts->trace_len : TRACE_DEFAULT_LEN, opts->trace);
+		if (!ctx->trace) {
+			interp_free(ctx);
+			return ERR_NO_FILE;
+		}
+	}
+
+	if (opts->stats) {
+		ctx->shared = open_stats();
+		if (!ctx->shared)
+			fprintf(stderr, "warning: could not publish stats to shared memory\n");
+		signal(SIGUSR1, on_sigusr1);
 	}
-	i++;
-    }
+	return ERR_OK;
+}
+
+// a finished run sits on BF_END, so resuming it again just says DONE
+enum interp_status interp_resume(struct interp_ctx *ctx) {
+	if (ctx->compact)
+		return resume_compact(ctx);
+	return ctx->trace ? resume_traced(ctx) : resume_wide(ctx);
+}
+
+void interp_feed(struct interp_ctx *ctx, const unsigned char *buf, size_t len) {
+	ctx->in = buf;
+	ctx->in_len = len;
+}
+
+void interp_feed_eof(struct interp_ctx *ctx) {
+	ctx->in_eof = true;
+}
+
+// the blocking driver: stdin and stdout on the other end of the resumable core
+enum err_type interp_program(const struct bf_program *prog, const struct interp_opts *opts, int *tape, int *ptr) {
+	struct interp_ctx ctx;
+	enum err_type err = interp_init(&ctx, prog, opts, tape);
+	if (err != ERR_OK)
+		return err;
+	ctx.ptr = *ptr;
+	ctx.high_water = *ptr;
+
+	unsigned char byte;
+	enum interp_status status;
+	do {
+		status = interp_resume(&ctx);
+		fwrite(ctx.out, 1, ctx.out_len, stdout);
+		ctx.out_len = 0;
+
+		if (status == INTERP_NEED_INPUT) {
+			fflush(stdout);
+			int ch = getchar();
+			if (ch == EOF) {
+				interp_feed_eof(&ctx);
+			} else {
+				byte = ch;
+				interp_feed(&ctx, &byte, 1);
+			}
+		}
+	} while (status != INTERP_DONE);
+	*ptr = ctx.ptr;
+
+	fflush(stdout);
+	if (opts && opts->profile)
+		dump_profile(&ctx);
+	if (ctx.memo)
+		memo_report(ctx.memo);
+	if (ctx.par)
+		par_report(ctx.par);
+
+	interp_free(&ctx);
+	return ERR_OK;
+}
+
+void interp(char *input_buff) {
+	interp_with_opts(input_buff, NULL);
+}
+
+enum err_type interp_with_opts(char *input_buff, const struct interp_opts *opts) {
+	struct bf_program prog;
+	enum err_type err = bf_compile(input_buff, strlen(input_buff), &prog);
+	if (err != ERR_OK)
+		return err;
+
+	if (opts && opts->compact)
+		err = bf_encode_compact(&prog);
+
+	int buff[BUFF_SIZE] = {0};
+	int ptr = 0;
+	if (err == ERR_OK)
+		err = interp_program(&prog, opts, buff, &ptr);
+	bf_free_program(&prog);
+	if (err != ERR_OK)
+		return err;
 
 	printf("\nFinal Stack State:\n");
-    printf("-1, %ld: %hhu\n", curr_ptr - buff, *curr_ptr);
-    for (int i = 0; i < BUFF_SIZE; i++) {
+	printf("-1, %d: %hhu\n", ptr, buff[ptr]);
+	for (int i = 0; i < BUFF_SIZE; i++) {
 		printf("%d[%hhu] ", i, buff[i]);
-    }
-    printf("\n");
+	}
+	printf("\n");
+	return ERR_OK;
 }
@@ -0,0 +1,49 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "interp.h"
+#include "utils.h"
+
+int main(int argc, char *argv[]) {
+	if (argc <= 1)
+		raise_error(ERR_NO_ARGS);
+
+	struct interp_opts opts = {0};
+	for (int i = 1; (i < argc) && (argv[i] != NULL); i++) {
+		if (!strcmp(argv[i], "--stats")) {
+			opts.stats = true;
+			continue;
+		} else if (!strcmp(argv[i], "--profile")) {
+			opts.profile = true;
+			continue;
+		} else if (!strcmp(argv[i], "--memo")) {
+			opts.memo = true;
+			continue;
+		} else if (!strcmp(argv[i], "--compact")) {
+			opts.compact = true;
+			continue;
+		} else if (!strcmp(argv[i], "--parallel")) {
+			opts.parallel = true;
+			continue;
+		} else if (!strcmp(argv[i], "--trace") && (i + 1 < argc)) {
+			opts.trace = argv[++i];
+			continue;
+		} else if (!strcmp(argv[i], "--trace-size") && (i + 1 < argc)) {
+			opts.trace_len = strtoul(argv[++i], NULL, 10);
+			continue;
+		}
+
+		char *program = bf_read_source(argv[i], NULL);
+		if (!program)
+			raise_error(ERR_NO_FILE);
+
+		enum err_type err = interp_with_opts(program, &opts);
+		free(program);
+		if (err != ERR_OK)
+			raise_error(err);
+	}
+
+	return 0;
+}
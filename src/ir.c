@@ -5,9 +5,15 @@
 #include "utils.h"
 #include "lexer.h"
 #include "ir.h"
+#include "flat_ast.h"
 
 void init_ir_ctx(struct ir_ctx *ctx, struct stmt *root) {
 	ctx->root = root;
+	ctx->ir_root = NULL;
+	// lowering walks the flat copy (see flat_ast.h)
+	ctx->ast = flatten_stmt(root);
+	if (!ctx->ast)
+		raise_ir_error(ERR_NO_MEM, ctx);
 	ctx->ir_root = init_node(ctx);
 	ctx->ir_root->next = ctx->ir_root;
 	ctx->var_num = 0;
@@ -113,47 +119,49 @@ static char *create_temp_name(struct ir_ctx *ctx) {
 }
 
 //returns the deepest node.
-struct ir_node *convert_stmt(struct ir_ctx *ctx, struct stmt *stmt, struct ir_node *node) {
+struct ir_node *convert_stmt(struct ir_ctx *ctx, uint32_t stmt, struct ir_node *node) {
 	raise_ir_error(ERR_INTERNAL, ctx); //not ready for use yet
 	if (!stmt)
-		return;
+		return NULL;
+	const struct flat_ast *ast = ctx->ast;
 
-	switch (stmt->type) {
-	case STMT_EMPTY:
+	switch (ast->kind[stmt]) {
+	case FLAT_STMT_EMPTY:
 		raise_ir_error(ERR_INTERNAL, ctx);
 		break;
-	case STMT_EXPR:
-		struct ir_node *last = covert_exp(ctx, stmt->exp, node);
-		if (!stmt->next)
+	case FLAT_EXPR:
+		struct ir_node *last = convert_exp(ctx, ast->a[stmt], node);
+		if (!ast->next[stmt])
 			return last;
 		last->next = init_node(ctx);
-		return convert_stmt(ctx, stmt->next, last->next);
+		return convert_stmt(ctx, ast->next[stmt], last->next);
 		break;
-	case STMT_VAR:
+	case FLAT_VAR:
+	case FLAT_VAL:
 		char *val_name = create_temp_name(ctx);
 		ctx->var_num--;
 
 		//TODO: if !value return 0;
-		struct ir_node *last = convert_exp(ctx, stmt->var->value, node);
-
-		last->next = init_node(ctx);
-		init_ir_assign(ctx, last->next);
-		last->next->assign->dest = stmt->var->name;
-		last->next->assign->lhs.type = IR_VAL_VAR;
-		last->next->assign->lhs.var = val_name;
-		last->next->assign->op = OP_ASSIGN;
-	case STMT_IF:
+		struct ir_node *value = convert_exp(ctx, ast->b[stmt], node);
+
+		value->next = init_node(ctx);
+		init_ir_assign(ctx, value->next);
+		value->next->assign->dest = flat_name(ast, ast->a[stmt]);
+		value->next->assign->lhs.type = IR_VAL_VAR;
+		value->next->assign->lhs.var = val_name;
+		value->next->assign->op = OP_ASSIGN;
+	case FLAT_IF:
 		char *cond_name = create_temp_name(ctx);
 		ctx->var_num--;
 
-		struct ir_node *cond = convert_exp(ctx, stmt->ifStmt->cond, node);
+		struct ir_node *cond = convert_exp(ctx, ast->a[stmt], node);
 		cond->next = init_node(ctx);
 		struct ir_node *loop = cond->next;
 		init_ir_loop(ctx, loop);
 		loop->loop->cond = cond_name;
 
 		loop->loop->body = init_node(ctx);
-		struct ir_node *body_end = convert_stmt(ctx, stmt->ifStmt->thenStmt, loop->loop->body);
+		struct ir_node *body_end = convert_stmt(ctx, ast->b[stmt], loop->loop->body);
 
 		body_end->next = init_node(ctx);
 		struct ir_node *update = body_end->next;
@@ -162,21 +170,21 @@ struct ir_node *convert_stmt(struct ir_ctx *ctx, struct stmt *stmt, struct ir_no
 		update->assign->dest = cond_name;
 		update->assign->op = OP_DECREMENT;
 
-		if (stmt->ifStmt->elseStmt) {
+		if (ast->c[stmt]) {
 			loop->next = init_node(ctx);
 			struct ir_node *update;
 			
 			//loop then --
 		}
 
-	case STMT_LOOP:
+	case FLAT_LOOP:
 
 	}
 
 	return init_node(ctx);
 }
 
-struct ir_node *convert_exp(struct ir_ctx *ctx, struct exp *exp, struct ir_node *node) {
+struct ir_node *convert_exp(struct ir_ctx *ctx, uint32_t exp, struct ir_node *node) {
 	raise_ir_error(ERR_INTERNAL, ctx); //not ready for use yet
 	if (!exp)
 		return NULL;
@@ -0,0 +1,179 @@
+/** @file lex_chunks.c
+ *  @brief Functions for lexing a big file on several threads.
+ *
+ *  This contains splitting the source up, the worker threads
+ *  (which call lexChunk, in lexer.c), and checking and joining
+ *  the chunks back together in order.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lex_chunks.h"
+#include "lexer.h"
+
+struct chunk_job {
+	const struct lexer_ctx *lex;
+	struct lex_chunk *chunk;
+};
+
+static unsigned int count_newlines(const char *p, const char *end) {
+	unsigned int lines = 0;
+	for (; p < end; p++)
+		lines += (*p == '\n');
+	return lines;
+}
+
+static void *chunk_worker(void *arg) {
+	struct chunk_job *job = arg;
+	const char *src = job->lex->src;
+	job->chunk->newlines = count_newlines(src + job->chunk->start, src + job->chunk->limit);
+	lexChunk(job->lex, job->chunk);
+	return NULL;
+}
+
+// splits the source into at most n chunks, each ending after a newline
+static int split_source(const struct lexer_ctx *lex, struct lex_chunk *chunks, int n) {
+	size_t len = lex->src_len, start = 0;
+	int count = 0;
+	for (int i = 0; (i < n) && (start < len); i++) {
+		size_t limit = (i == n - 1) ? len : (len / n) * (i + 1);
+		if (limit <= start)
+			continue;
+		const char *nl = (limit < len) ? memchr(lex->src + limit, '\n', len - limit) : NULL;
+		limit = nl ? (size_t) (nl - lex->src) + 1 : len;
+		chunks[count++] = (struct lex_chunk) { .start = start, .limit = limit, .from = start };
+		start = limit;
+	}
+	return count;
+}
+
+// finds the first token in chunk that starts at resume, if the chunk's guess got there
+static bool find_sync(const struct lex_chunk *chunk, unsigned int resume, size_t *first) {
+	if (resume == chunk->from) {
+		*first = 0;
+		return true;
+	}
+	if (!chunk->ended && (resume == chunk->stop)) {
+		*first = chunk->num_toks;
+		return true;
+	}
+
+	// the offsets only go up, and the sentinel counts if it's there
+	size_t lo = 0, hi = chunk->num_toks + chunk->ended;
+	while (lo < hi) {
+		size_t mid = lo + ((hi - lo) / 2);
+		if (chunk->toks[mid].offset < resume)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((lo < chunk->num_toks + chunk->ended) && (chunk->toks[lo].offset == resume)) {
+		*first = lo;
+		return true;
+	}
+	return false;
+}
+
+static void free_chunks(struct lex_chunk *chunks, int n) {
+	for (int i = 0; i < n; i++)
+		free(chunks[i].toks);
+	free(chunks);
+}
+
+bool lex_chunks_tokenize(struct lexer_ctx *lex, int threads) {
+	int n = threads;
+	if (lex->src_len / LEX_MIN_CHUNK < (size_t) n)
+		n = lex->src_len / LEX_MIN_CHUNK;
+	if (n < 2)
+		return false;
+
+	struct lex_chunk *chunks = calloc(n, sizeof(*chunks));
+	struct chunk_job *jobs = calloc(n, sizeof(*jobs));
+	pthread_t *tids = calloc(n, sizeof(*tids));
+	bool *started = calloc(n, sizeof(*started));
+	if (!chunks || !jobs || !tids || !started) {
+		free(chunks);
+		free(jobs);
+		free(tids);
+		free(started);
+		return false;
+	}
+
+	// chunk 0 is lexed on this thread, as are any that don't get one
+	n = split_source(lex, chunks, n);
+	for (int i = 0; i < n; i++) {
+		jobs[i] = (struct chunk_job) { lex, chunks + i };
+		started[i] = (i > 0) && !pthread_create(tids + i, NULL, chunk_worker, jobs + i);
+	}
+	for (int i = 0; i < n; i++) {
+		if (!started[i])
+			chunk_worker(jobs + i);
+	}
+	for (int i = 0; i < n; i++) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+	}
+	free(jobs);
+	free(tids);
+	free(started);
+
+	// walk the chunks in order, redoing any that started in the middle of something
+	size_t *first = calloc(n, sizeof(*first));
+	if (!first) {
+		free_chunks(chunks, n);
+		return false;
+	}
+	unsigned int resume = 0;
+	size_t total = 0;
+	bool ended = false;
+	int last = 0;
+	for (int i = 0; (i < n) && !ended; i++) {
+		struct lex_chunk *chunk = chunks + i;
+		last = i;
+		if (resume >= chunk->limit) {
+			first[i] = chunk->num_toks + chunk->ended;
+			continue;
+		}
+		if (!find_sync(chunk, resume, first + i)) {
+			free(chunk->toks);
+			chunk->from = resume;
+			lexChunk(lex, chunk);
+			first[i] = 0;
+		}
+		total += chunk->num_toks + chunk->ended - first[i];
+		ended = chunk->ended;
+		resume = chunk->stop;
+	}
+
+	// the last chunk always gets to the end, but if it somehow didn't, start over
+	struct token *toks = ended ? malloc(total * sizeof(*toks)) : NULL;
+	if (!toks) {
+		free(first);
+		free_chunks(chunks, n);
+		return false;
+	}
+
+	size_t out = 0;
+	unsigned int lines_before = 0;
+	for (int i = 0; i <= last; i++) {
+		const struct lex_chunk *chunk = chunks + i;
+		size_t count = chunk->num_toks + chunk->ended - first[i];
+		memcpy(toks + out, chunk->toks + first[i], count * sizeof(*toks));
+		for (size_t j = out; j < out + count; j++)
+			toks[j].line += lines_before;
+		out += count;
+		lines_before += chunk->newlines;
+	}
+
+	lex->toks = toks;
+	lex->tok_cap = total;
+	lex->num_toks = total - 1;
+	lex->tok_err = chunks[last].err;
+	free(first);
+	free_chunks(chunks, n);
+	return true;
+}
@@ -0,0 +1,122 @@
+/** @file lex_pipe.c
+ *  @brief Functions for handing tokens from a lexer thread to the parser.
+ *
+ *  head and tail only ever go up, and a slot is head or tail
+ *  mod TOK_PIPE_SIZE. The lexer writes a slot and then publishes
+ *  head (release), and the parser reads head (acquire) before the
+ *  slot, and the same for tail the other way round. Waiting spins
+ *  for a bit, then yields, as the other side might be on the same core.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lex_pipe.h"
+
+#define TOK_PIPE_MASK (TOK_PIPE_SIZE - 1)
+#define PIPE_SPINS 64
+
+struct tok_pipe {
+	// the lexer thread's line
+	size_t head __attribute__((aligned(CACHE_LINE)));
+	size_t tail_seen;	// tail when it last looked
+	enum err_type err;	// written before the sentinel is published
+
+	// the parser's line
+	size_t tail __attribute__((aligned(CACHE_LINE)));
+	size_t head_seen;	// head when it last looked
+	bool stop;		// the parser's gone, so the lexer should stop
+	bool done;		// the sentinel's been taken
+	struct token cur;	// the last token taken
+
+	pthread_t thread;
+	bool running;
+
+	struct token ring[TOK_PIPE_SIZE] __attribute__((aligned(CACHE_LINE)));
+};
+
+static inline void backoff(unsigned int *spins) {
+	if (++*spins < PIPE_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+		return;
+	}
+	*spins = 0;
+	sched_yield();
+}
+
+struct tok_pipe *tok_pipe_init(void) {
+	void *mem = NULL;
+	if (posix_memalign(&mem, CACHE_LINE, sizeof(struct tok_pipe)))
+		return NULL;
+	memset(mem, 0, sizeof(struct tok_pipe));
+	return mem;
+}
+
+bool tok_pipe_run(struct tok_pipe *pipe, void *(*lex_fn)(void *), void *arg) {
+	pipe->running = !pthread_create(&pipe->thread, NULL, lex_fn, arg);
+	return pipe->running;
+}
+
+bool tok_pipe_push(struct tok_pipe *pipe, const struct token *tok) {
+	size_t head = pipe->head;
+	unsigned int spins = 0;
+	while (head - pipe->tail_seen >= TOK_PIPE_SIZE) {
+		if (__atomic_load_n(&pipe->stop, __ATOMIC_ACQUIRE))
+			return false;
+		pipe->tail_seen = __atomic_load_n(&pipe->tail, __ATOMIC_ACQUIRE);
+		if (head - pipe->tail_seen >= TOK_PIPE_SIZE)
+			backoff(&spins);
+	}
+
+	pipe->ring[head & TOK_PIPE_MASK] = *tok;
+	__atomic_store_n(&pipe->head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+void tok_pipe_finish(struct tok_pipe *pipe, const struct token *tok, enum err_type err) {
+	pipe->err = err;
+	tok_pipe_push(pipe, tok);
+}
+
+// waits until there's a token in the ring
+static const struct token *wait_for_next(struct tok_pipe *pipe) {
+	unsigned int spins = 0;
+	for (;;) {
+		if (pipe->head_seen != pipe->tail)
+			return pipe->ring + (pipe->tail & TOK_PIPE_MASK);
+
+		size_t head = __atomic_load_n(&pipe->head, __ATOMIC_ACQUIRE);
+		if (head == pipe->head_seen)
+			backoff(&spins);
+		pipe->head_seen = head;
+	}
+}
+
+const struct token *tok_pipe_next(struct tok_pipe *pipe) {
+	if (pipe->done)
+		return &pipe->cur;
+
+	pipe->cur = *wait_for_next(pipe);
+	pipe->done = (pipe->cur.val.type == VAL_EMPTY);
+	__atomic_store_n(&pipe->tail, pipe->tail + 1, __ATOMIC_RELEASE);
+	return &pipe->cur;
+}
+
+enum err_type tok_pipe_error(const struct tok_pipe *pipe) {
+	return pipe->done ? pipe->err : ERR_OK;
+}
+
+void tok_pipe_free(struct tok_pipe *pipe) {
+	if (!pipe)
+		return;
+	__atomic_store_n(&pipe->stop, true, __ATOMIC_RELEASE);
+	if (pipe->running)
+		pthread_join(pipe->thread, NULL);
+	free(pipe);
+}
@@ -0,0 +1,239 @@
+/** @file lex_simd.c
+ *  @brief Functions for the lexer's vectorized skipping kernels.
+ *
+ *  This contains the scalar kernels, which also finish off the
+ *  last few bytes for the others, the SSE2 and AVX2 versions,
+ *  and picking between them. Each vector step loads a block,
+ *  builds a bitmask of the characters it's looking for, and
+ *  takes the lowest set bit.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "lex_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define LEX_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+struct lex_kernels {
+	const char *(*skip_space)(const char *, const char *, unsigned int *, const char **);
+	const char *(*line_end)(const char *, const char *);
+	const char *(*comment_end)(const char *, const char *, unsigned int *, const char **);
+};
+
+static inline bool is_space(const char ch) {
+	return (ch == ' ') || ((ch >= '\t') && (ch <= '\r'));
+}
+
+// scalar kernels
+static const char *skip_space_scalar(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	for (; (p < end) && is_space(*p); p++) {
+		if (*p == '\n') {
+			(*lines)++;
+			*line_start = p + 1;
+		}
+	}
+	return p;
+}
+
+static const char *line_end_scalar(const char *p, const char *end) {
+	while ((p < end) && (*p != '\n') && *p)
+		p++;
+	return p;
+}
+
+static const char *comment_end_scalar(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	for (; (p < end) && *p; p++) {
+		if ((*p == '*') && (p + 1 < end) && (p[1] == '/'))
+			return p;
+		if (*p == '\n') {
+			(*lines)++;
+			*line_start = p + 1;
+		}
+	}
+	return p;
+}
+
+static const struct lex_kernels scalar_kernels = { skip_space_scalar, line_end_scalar, comment_end_scalar };
+
+#ifdef LEX_SIMD_X86
+
+// counts the newlines in the block before the stop bit (or all of them)
+static inline void count_lines(const char *block, unsigned int nls, unsigned int stop,
+		unsigned int *lines, const char **line_start) {
+	if (stop)
+		nls &= (1u << __builtin_ctz(stop)) - 1;
+	if (nls) {
+		*lines += __builtin_popcount(nls);
+		*line_start = block + (31 - __builtin_clz(nls)) + 1;
+	}
+}
+
+// SSE2 kernels, 16 bytes at a time
+static const char *skip_space_sse2(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+	const __m128i four = _mm_set1_epi8(4), nl = _mm_set1_epi8('\n');
+	for (; end - p >= 16; p += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *) p);
+		// '\t' to '\r' become 0 to 4, everything else is more
+		__m128i ctl = _mm_sub_epi8(c, tab);
+		__m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, four), ctl);
+		unsigned int ws = _mm_movemask_epi8(_mm_or_si128(is_ctl, _mm_cmpeq_epi8(c, space)));
+		unsigned int stop = ~ws & 0xffff;
+		count_lines(p, _mm_movemask_epi8(_mm_cmpeq_epi8(c, nl)), stop, lines, line_start);
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return skip_space_scalar(p, end, lines, line_start);
+}
+
+static const char *line_end_sse2(const char *p, const char *end) {
+	const __m128i nl = _mm_set1_epi8('\n'), zero = _mm_setzero_si128();
+	for (; end - p >= 16; p += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *) p);
+		unsigned int stop = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, nl), _mm_cmpeq_epi8(c, zero)));
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return line_end_scalar(p, end);
+}
+
+static const char *comment_end_sse2(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/');
+	const __m128i nl = _mm_set1_epi8('\n'), zero = _mm_setzero_si128();
+	// the second load reads one past the block, for the '/' after a '*' at the end of it
+	for (; end - p >= 17; p += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *) p);
+		__m128i next = _mm_loadu_si128((const __m128i *) (p + 1));
+		__m128i close = _mm_and_si128(_mm_cmpeq_epi8(c, star), _mm_cmpeq_epi8(next, slash));
+		unsigned int stop = _mm_movemask_epi8(_mm_or_si128(close, _mm_cmpeq_epi8(c, zero)));
+		count_lines(p, _mm_movemask_epi8(_mm_cmpeq_epi8(c, nl)), stop, lines, line_start);
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return comment_end_scalar(p, end, lines, line_start);
+}
+
+static const struct lex_kernels sse2_kernels = { skip_space_sse2, line_end_sse2, comment_end_sse2 };
+
+// AVX2 kernels, the same with 32 bytes at a time
+__attribute__((target("avx2")))
+static inline void count_lines_avx2(const char *block, unsigned int nls, unsigned int stop,
+		unsigned int *lines, const char **line_start) {
+	if (stop)
+		nls &= (stop & -stop) - 1;
+	if (nls) {
+		*lines += __builtin_popcount(nls);
+		*line_start = block + (31 - __builtin_clz(nls)) + 1;
+	}
+}
+
+__attribute__((target("avx2")))
+static const char *skip_space_avx2(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+	const __m256i four = _mm256_set1_epi8(4), nl = _mm256_set1_epi8('\n');
+	for (; end - p >= 32; p += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) p);
+		__m256i ctl = _mm256_sub_epi8(c, tab);
+		__m256i is_ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl);
+		unsigned int ws = _mm256_movemask_epi8(_mm256_or_si256(is_ctl, _mm256_cmpeq_epi8(c, space)));
+		unsigned int stop = ~ws;
+		count_lines_avx2(p, _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, nl)), stop, lines, line_start);
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return skip_space_sse2(p, end, lines, line_start);
+}
+
+__attribute__((target("avx2")))
+static const char *line_end_avx2(const char *p, const char *end) {
+	const __m256i nl = _mm256_set1_epi8('\n'), zero = _mm256_setzero_si256();
+	for (; end - p >= 32; p += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) p);
+		unsigned int stop = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(c, nl),
+			_mm256_cmpeq_epi8(c, zero)));
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return line_end_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *comment_end_avx2(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	const __m256i star = _mm256_set1_epi8('*'), slash = _mm256_set1_epi8('/');
+	const __m256i nl = _mm256_set1_epi8('\n'), zero = _mm256_setzero_si256();
+	for (; end - p >= 33; p += 32) {
+		__m256i c = _mm256_loadu_si256((const __m256i *) p);
+		__m256i next = _mm256_loadu_si256((const __m256i *) (p + 1));
+		__m256i close = _mm256_and_si256(_mm256_cmpeq_epi8(c, star), _mm256_cmpeq_epi8(next, slash));
+		unsigned int stop = _mm256_movemask_epi8(_mm256_or_si256(close, _mm256_cmpeq_epi8(c, zero)));
+		count_lines_avx2(p, _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, nl)), stop, lines, line_start);
+		if (stop)
+			return p + __builtin_ctz(stop);
+	}
+	return comment_end_sse2(p, end, lines, line_start);
+}
+
+static const struct lex_kernels avx2_kernels = { skip_space_avx2, line_end_avx2, comment_end_avx2 };
+
+static const struct lex_kernels *kernels = &sse2_kernels;
+
+// picks the best kernels before main runs, so the lexer never has to check
+__attribute__((constructor))
+static void pick_kernels(void) {
+	lex_simd_set(LEX_AVX2);
+}
+
+enum lex_simd_level lex_simd_set(enum lex_simd_level level) {
+	__builtin_cpu_init();
+	if ((level >= LEX_AVX2) && __builtin_cpu_supports("avx2")) {
+		kernels = &avx2_kernels;
+		return LEX_AVX2;
+	}
+	if (level >= LEX_SSE2) {
+		kernels = &sse2_kernels;
+		return LEX_SSE2;
+	}
+	kernels = &scalar_kernels;
+	return LEX_SCALAR;
+}
+
+#else
+
+static const struct lex_kernels *kernels = &scalar_kernels;
+
+enum lex_simd_level lex_simd_set(enum lex_simd_level level) {
+	(void) level;
+	return LEX_SCALAR;
+}
+
+#endif //LEX_SIMD_X86
+
+const char *lex_simd_name(enum lex_simd_level level) {
+	switch (level) {
+	case LEX_SCALAR:
+		return "scalar";
+	case LEX_SSE2:
+		return "sse2";
+	case LEX_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+const char *lex_skip_space(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	return kernels->skip_space(p, end, lines, line_start);
+}
+
+const char *lex_line_end(const char *p, const char *end) {
+	return kernels->line_end(p, end);
+}
+
+const char *lex_comment_end(const char *p, const char *end, unsigned int *lines, const char **line_start) {
+	return kernels->comment_end(p, end, lines, line_start);
+}
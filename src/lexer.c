@@ -11,123 +11,366 @@
  */
 
 
+#include <errno.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <limits.h>
 #include <string.h>
 #include <stdbool.h>
-
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "lex_chunks.h"
+#include "lex_pipe.h"
+#include "lex_simd.h"
 #include "lexer.h"
 #include "structs.h"
 #include "utils.h"
-#include "stmt.h"
-
-
-static enum operator BINARY_OPS[][5] = {  		// lowest priority to highest priority:
-	{OP_LOGICAL_OR, OP_UNKNOWN},     		// 0: logical or
-	{OP_LOGICAL_AND, OP_UNKNOWN},                   // 1: logical and
-	{OP_BITWISE_OR, OP_UNKNOWN},                    // 2: bitwiase or
-	{OP_BITWISE_XOR, OP_UNKNOWN},                   // 3: bitwise xor
-	{OP_BITWISE_AND, OP_UNKNOWN},                   // 4: bitwise and
-	{OP_EQ, OP_NE, OP_UNKNOWN},             	// 5: equivalence operators
-	{OP_LT, OP_GT, OP_LE, OP_GE, OP_UNKNOWN},   	// 6: relational operators
-	{OP_LEFT_SHIFT, OP_RIGHT_SHIFT, OP_UNKNOWN},	// 7: bitwise shifts
-	{OP_PLUS, OP_MINUS, OP_UNKNOWN},               	// 8: addition / subtraction
-	{OP_MULTIPLY, OP_DIVIDE, OP_MODULO, OP_UNKNOWN} // 9: multiplication, division, modulo
-};
 
-static bool read_next_line(struct lexer_ctx *lex) {
-	if (!lex || !lex->fp || feof(lex->fp)) {
-		lex->ch = EOF;
-		return false;
-	}
-	
-	lex->line_buf[0] = '\0';
-	fgetpos(lex->fp, &lex->line_start_pos);
 
-	if (!fgets(lex->line_buf, lex->line_cap, lex->fp)) {
-		lex->ch = EOF;
-		return false;
-	}
+// character classes, so each check in the lexer is one table load
+#define CC_SPACE	0x01
+#define CC_ALPHA	0x02
+#define CC_DIGIT	0x04
+#define CC_WORD		0x08	// can be in a name after the first letter
+#define CC_OP		0x10	// can start an operator
+#define CC_DELIM	0x20
+
+#define S CC_SPACE
+#define A (CC_ALPHA | CC_WORD)
+#define D (CC_DIGIT | CC_WORD)
+#define U CC_WORD
+#define O CC_OP
+#define L CC_DELIM
+static const unsigned char CHAR_CLASS[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,	// 0x00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x10
+	S, O, L, 0, 0, O, O, L, L, L, O, O, L, O, 0, O,	// 0x20
+	D, D, D, D, D, D, D, D, D, D, 0, L, O, O, O, 0,	// 0x30
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,	// 0x40
+	A, A, A, A, A, A, A, A, A, A, A, L, 0, L, O, U,	// 0x50
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,	// 0x60
+	A, A, A, A, A, A, A, A, A, A, A, L, O, L, O, 0,	// 0x70
+	// everything above 0x7f is 0
+};
+#undef S
+#undef A
+#undef D
+#undef U
+#undef O
+#undef L
+
+static inline bool char_is(const int ch, const unsigned char cls) {
+	return (ch != EOF) && (CHAR_CLASS[(unsigned char) ch] & cls);
+}
+
+// an op's binding powers are what parse_exp runs on.
+// An op takes the expression to its left if its left power is at least
+// parse_exp's minPrio, and the expression to its right is parsed with
+// its right power as the minPrio, so:
+//  - binary ops are their priority on the left and one more on
+//    the right, so they're left associative. Lowest to highest:
+//    0: ||, 1: &&, 2: |, 3: ^, 4: &, 5: == !=,
+//    6: < <= > >=, 7: << >>, 8: + -, 9: * / %
+//  - assign ops, and the prefix ops that aren't binary too, always take
+//    the left, and everything to their right.
+//  - anything else ends the expression.
+#define BP_ALWAYS SCHAR_MAX
+struct op_info {
+	const char *str;
+	struct binding_power bp;
+	bool prefix, suffix;
+};
 
-	lex->line_pos = 0;
-	lex->line_num++;
-	lex->ch = lex->line_buf[lex->line_pos];
-	return true;
-} 
+static const struct op_info OP_INFO[OP_UNKNOWN + 1] = {
+	[OP_PLUS]		= {"+",   {8, 9, false},		false, false},
+	[OP_MINUS]		= {"-",   {8, 9, false},		true,  false},
+	[OP_MULTIPLY]		= {"*",   {9, 10, false},		false, false},
+	[OP_DIVIDE]		= {"/",   {9, 10, false},		false, false},
+	[OP_MODULO]		= {"%",   {9, 10, false},		false, false},
+	[OP_BITWISE_NOT]	= {"~",   {BP_ALWAYS, 0, false},	true,  false},
+	[OP_BITWISE_OR]		= {"|",   {2, 3, false},		false, false},
+	[OP_BITWISE_XOR]	= {"^",   {3, 4, false},		false, false},
+	[OP_BITWISE_AND]	= {"&",   {4, 5, false},		false, false},
+	[OP_LEFT_SHIFT]		= {"<<",  {7, 8, false},		false, false},
+	[OP_RIGHT_SHIFT]	= {">>",  {7, 8, false},		false, false},
+	[OP_LT]			= {"<",   {6, 7, false},		false, false},
+	[OP_LE]			= {"<=",  {6, 7, false},		false, false},
+	[OP_GT]			= {">",   {6, 7, false},		false, false},
+	[OP_GE]			= {">=",  {6, 7, false},		false, false},
+	[OP_EQ]			= {"==",  {5, 6, false},		false, false},
+	[OP_NE]			= {"!=",  {5, 6, false},		false, false},
+	[OP_LOGICAL_NOT]	= {"!",   {BP_ALWAYS, 0, false},	true,  false},
+	[OP_LOGICAL_AND]	= {"&&",  {1, 2, false},		false, false},
+	[OP_LOGICAL_OR]		= {"||",  {0, 1, false},		false, false},
+	[OP_ASSIGN]		= {"=",   {BP_ALWAYS, 0, true},	false, false},
+	[OP_PLUS_ASSIGN]	= {"+=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_MINUS_ASSIGN]	= {"-=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_MULTIPLY_ASSIGN]	= {"*=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_DIVIDE_ASSIGN]	= {"/=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_MODULO_ASSIGN]	= {"%=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_LEFT_SHIFT_ASSIGN]	= {"<<=", {BP_ALWAYS, 0, true},	false, false},
+	[OP_RIGHT_SHIFT_ASSIGN]	= {">>=", {BP_ALWAYS, 0, true},	false, false},
+	[OP_BITWISE_AND_ASSIGN]	= {"&=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_BITWISE_XOR_ASSIGN]	= {"^=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_BITWISE_OR_ASSIGN]	= {"|=",  {BP_ALWAYS, 0, true},	false, false},
+	[OP_INCREMENT]		= {"++",  {BP_ALWAYS, 0, false},	true,  true},
+	[OP_DECREMENT]		= {"--",  {BP_ALWAYS, 0, false},	true,  true},
+	[OP_UNKNOWN]		= {NULL,  {-1, -1, false},		false, false},
+};
 
+static inline const struct op_info *getOpInfo(const enum operator op) {
+	if ((op >= 0) && (op < OP_UNKNOWN))
+		return OP_INFO + op;
+	return OP_INFO + OP_UNKNOWN;
+}
 
 static inline int peek(struct lexer_ctx *lex) {
-	if (!lex || !lex->line_buf || (lex->line_pos > strlen(lex->line_buf)))
+	if (!lex || (lex->cur >= lex->end) || (*lex->cur == '\0'))
 		return EOF;
-	int out = lex->line_buf[lex->line_pos];
-	if (out == '\0')
-		return EOF;
-	return out; 
+	return (unsigned char) *lex->cur;
 }
+
+// the line and column are kept up to date here, so nothing
+// has to scan back over the line to find them. A newline at
+// the very end doesn't start a new line, same as fgets.
 static inline int advance(struct lexer_ctx *lex) {
 	int out = peek(lex);
-	if (!lex || (out == EOF) || !lex->line_buf) {
+	if (out == EOF) {
 		lex->ch = EOF;
 		return out;
 	}
-	bool atEOL = lex->line_pos >= strlen(lex->line_buf) - 1;
-	if (!atEOL) {
-		lex->ch = lex->line_buf[++lex->line_pos];
-		return out;
-	}
-	
-	if (atEOL && !feof(lex->fp)) {
-		read_next_line(lex);
-		return out;
-	}
-		
-	// at the end of the file.
-	lex->ch = EOF;
-	lex->line_pos = 0;
-	free(lex->line_buf);
-	lex->line_buf = NULL;
 
+	lex->cur++;
+	lex->ch = peek(lex);
+	if ((out == '\n') && (lex->ch != EOF)) {
+		lex->line_start = lex->cur;
+		lex->line_pos = 0;
+		lex->line_num++;
+	} else if (out != '\n') {
+		lex->line_pos++;
+	}
 	return out;
 }
 
+// lexer errors are held back until the parser reaches the value they're in,
+// so they come out in the same order they would reading one value at a time.
+static inline void lexError(struct lexer_ctx *lex, enum err_type err) {
+	if (!lex->tok_err)
+		lex->tok_err = err;
+}
+
+// moves the lexer to `to` after a kernel skipped over `lines` newlines,
+// the last of which ended just before line_start.
+static inline void moveTo(struct lexer_ctx *lex, const char *to, unsigned int lines, const char *line_start) {
+	lex->cur = to;
+	lex->ch = peek(lex);
+	// same as advance(), a newline right at the end doesn't start a line
+	if (lines && (lex->ch == EOF) && (to[-1] == '\n')) {
+		lines--;
+		line_start = to - 1;
+		while ((line_start > lex->line_start) && (line_start[-1] != '\n'))
+			line_start--;
+		to--;
+	}
+	lex->line_num += lines;
+	lex->line_start = line_start;
+	lex->line_pos = to - line_start;
+}
+
+// skips whitespace and comments, a block at a time (see lex_simd.h)
 static inline void skip_spaces(struct lexer_ctx *lex) {
-	while (lex && (isspace(lex->ch)) && (lex->ch != '\0'))
+	// most tokens are right next to the one before, so don't call out for those
+	if (!lex || (!char_is(lex->ch, CC_SPACE) && (lex->ch != '/')))
+		return;
+	// nor for the single space between most of the rest
+	if ((lex->ch == ' ') && (lex->cur + 1 < lex->end) && (lex->cur[1] != '/') &&
+			!char_is((unsigned char) lex->cur[1], CC_SPACE)) {
 		advance(lex);
+		return;
+	}
+	for (;;) {
+		unsigned int lines = 0;
+		const char *line_start = lex->line_start;
+		const char *p = lex_skip_space(lex->cur, lex->end, &lines, &line_start);
+		if (p != lex->cur)
+			moveTo(lex, p, lines, line_start);
+
+		if ((lex->ch != '/') || (lex->cur + 1 >= lex->end))
+			return;
+		if (lex->cur[1] == '/') {
+			moveTo(lex, lex_line_end(lex->cur + 2, lex->end), 0, lex->line_start);
+		} else if (lex->cur[1] == '*') {
+			int start_pos = lex->line_pos;
+			lines = 0;
+			p = lex_comment_end(lex->cur + 2, lex->end, &lines, &line_start);
+			if ((p < lex->end) && *p) {
+				moveTo(lex, p + 2, lines, line_start);
+				continue;
+			}
+			// unclosed, underline from the /* if it's on the last line
+			moveTo(lex, p, lines, line_start);
+			lex->val.start_pos = lines ? 0 : start_pos;
+			lexError(lex, ERR_EOF);
+			return;
+		} else {
+			return;
+		}
+	}
+}
+
+// tokens keep 32 bit offsets (and 31 bit lengths) into the source
+#define MAX_SRC_LEN INT_MAX
+
+// reads a pipe (or anything else that can't be mapped) into memory
+static bool read_source(struct lexer_ctx *lex, int fd) {
+	size_t cap = DEFAULT_LINE_CAP, len = 0;
+	char *buf = malloc(cap);
+	if (!buf)
+		return false;
+
+	for (;;) {
+		if (len == cap) {
+			char *tmp = (cap < MAX_SRC_LEN) ? realloc(buf, cap * 2) : NULL;
+			if (!tmp) {
+				free(buf);
+				return false;
+			}
+			buf = tmp;
+			cap *= 2;
+		}
+		ssize_t got = read(fd, buf + len, cap - len);
+		if ((got < 0) && (errno == EINTR))
+			continue;
+		if (got < 0) {
+			free(buf);
+			return false;
+		}
+		if (!got)
+			break;
+		len += got;
+	}
+	if (len > MAX_SRC_LEN) {
+		free(buf);
+		return false;
+	}
+
+	lex->src = buf;
+	lex->src_len = len;
+	lex->src_kind = SRC_READ;
+	return true;
+}
+
+// maps the whole file in, so the lexer can walk it with a pointer
+static bool map_source(struct lexer_ctx *lex, int fd) {
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		return false;
+	if (!S_ISREG(st.st_mode))
+		return read_source(lex, fd);
+	if ((unsigned long long) st.st_size > MAX_SRC_LEN)
+		return false;
+
+	lex->src_len = st.st_size;
+	lex->src = "";
+	lex->src_kind = SRC_MAPPED;
+	if (lex->src_len) {
+		void *map = mmap(NULL, lex->src_len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+			return false;
+		madvise(map, lex->src_len, MADV_SEQUENTIAL);
+		lex->src = map;
+	}
+	return true;
+}
+
+static void tokenize(struct lexer_ctx *lex);
+static bool startLexThread(struct lexer_ctx *lex);
+
+static bool pipelined = false;
+static int lex_threads = 1;
+
+void setPipelinedLexing(bool on) {
+	pipelined = on;
+}
+
+void setLexThreads(int threads) {
+	lex_threads = (threads > 1) ? threads : 1;
 }
 
 // struct lexer_ctx util functions
-struct lexer_ctx *readInFile(const char *filename) {
-	if (filename == NULL)
+
+// everything else in a reader, once lex->src is set. Frees lex if it can't.
+static struct lexer_ctx *startReader(struct lexer_ctx *lex, const char *name) {
+	lex->cur = lex->line_start = lex->src;
+	lex->end = lex->src + lex->src_len;
+	lex->filename = strdup(name ? name : "<buffer>");
+	if (!lex->filename) {
+		killReader(lex);
+		return NULL;
+	}
+
+	// the tree goes in the arena, which goes to whoever takes the root
+	lex->arena = ast_arena_init();
+	if (!lex->arena) {
+		killReader(lex);
+		return NULL;
+	}
+	lex->root = ast_arena_root(lex->arena);
+	lex->root->next = lex->root; // self loop to mark as sentinal 
+
+	lex->line_num = 1;
+	lex->line_pos = 0;
+	lex->ch = peek(lex);
+	// big enough files are split up between threads, see lex_chunks.h
+	bool lexed = (lex_threads > 1) && lex_chunks_tokenize(lex, lex_threads);
+	if (!lexed && !(pipelined && startLexThread(lex)))
+		tokenize(lex);
+	nextValue(lex);
+	return lex;
+}
+
+struct lexer_ctx *readInBuffer(const char *src, size_t len, const char *name) {
+	if ((!src && len) || (len > MAX_SRC_LEN))
 		return NULL;
 
 	struct lexer_ctx *lex = calloc(1, sizeof(*lex));
 	if (!lex)
 		return NULL;
 
-	lex->fp = fopen(filename, "r");
+	lex->src = src ? src : "";
+	lex->src_len = len;
+	lex->src_kind = SRC_BORROWED;
+	return startReader(lex, name);
+}
+
+struct lexer_ctx *readInFd(int fd, const char *name) {
+	struct lexer_ctx *lex = calloc(1, sizeof(*lex));
+	if (!lex)
+		return NULL;
 
-	if ((!lex->fp) || (feof(lex->fp))) {
+	if (!map_source(lex, fd)) {
 		free(lex);
 		return NULL;
 	}
-	
-	lex->root = init_stmt(lex);
-	lex->root->next = lex->root; // self loop to mark as sentinal 
-	lex->filename = strdup(filename);
-
-	lex->line_num = 0;
-	lex->line_pos = 0;
-	lex->line_cap = DEFAULT_LINE_CAP;
-	lex->line_buf = calloc(lex->line_cap, sizeof((*lex->line_buf)));
-
-	if (!lex->line_buf)
-		raise_syntax_error(ERR_NO_MEM, lex);
+	return startReader(lex, name);
+}
 
-	read_next_line(lex);
+struct lexer_ctx *readInFile(const char *filename) {
+	if (filename == NULL)
+		return NULL;
+	if (!strcmp(filename, "-"))
+		return readInFd(STDIN_FILENO, "<stdin>");
 
-	lex->ch = peek(lex);
-	nextValue(lex);
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	// the mapping (or the copy) outlives the fd
+	struct lexer_ctx *lex = readInFd(fd, filename);
+	close(fd);
 	return lex;
 }
 
@@ -135,32 +378,46 @@ void killReader(struct lexer_ctx *lex) {
 	if (!lex)
 		raise_error(ERR_REFREE);
 
-	if (lex->line_buf) {
-		free(lex->line_buf);
-		lex->line_buf = NULL;
-	}
-
 	if (lex->filename) {
 		free(lex->filename);
 		lex->filename = NULL;
 	}
 
-	if ((lex->val.str) && ((lex->val.type == VAL_STR) || lex->val.type == VAL_NAME))
-		free(lex->val.str);
-
-	free_stmt(lex->root);
+	// the lexer thread reads the source, so it has to stop first
+	tok_pipe_free(lex->pipe);
+	lex->pipe = NULL;
+
+	// names and strings are slices of the source, so the tokens don't own anything
+	free(lex->toks);
+	lex->toks = NULL;
+	free(lex->esc_buf);
+	lex->esc_buf = NULL;
+	free(lex->frames);
+	lex->frames = NULL;
+
+	// if the parse didn't finish, the tree's still ours
+	ast_arena_free(lex->arena);
+	lex->arena = NULL;
 	lex->root = NULL;
 
-	fclose(lex->fp);
-	lex->fp = NULL;
+	switch (lex->src_kind) {
+	case SRC_BORROWED:
+		break;
+	case SRC_MAPPED:
+		if (lex->src_len)
+			munmap((void *) lex->src, lex->src_len);
+		break;
+	case SRC_READ:
+		free((void *) lex->src);
+		break;
+	}
+	lex->src = lex->cur = lex->end = NULL;
 	free(lex);
 }
 
 //op checker functions
 const char *getOpStr(enum operator op) {
-	if ((op >= 0) && (op < OP_UNKNOWN))
-		return OP_STRINGS[op];
-	return NULL;
+	return getOpInfo(op)->str;
 }
 
 const char *getKeyStr(enum key_type key) {
@@ -169,55 +426,19 @@ const char *getKeyStr(enum key_type key) {
 	return NULL;
 }
 
-int getPrio(const enum operator op) {
-	if (op == OP_UNKNOWN)
-		return -1;
-	for (int y = 0; y < NUM_PRIOS; y++)
-		for (int x = 0; BINARY_OPS[y][x] != OP_UNKNOWN; x++)
-			if (op == BINARY_OPS[y][x])	
-				return y;
-	return -1;
-}
-
-bool isAssignOp(const enum operator op) {
-	for (int i = 0; ASSIGN_OPS[i] != OP_UNKNOWN; i++)
-		if (op == ASSIGN_OPS[i])
-			return true;
-	return false;
-}
-
-bool isBinaryOp(const enum operator op) {
-	return getPrio(op) >= 0;
+struct binding_power getBindingPower(const enum operator op) {
+	return getOpInfo(op)->bp;
 }
 
 bool is_suffix_unary(enum operator op) {
-    	if (!op)
-		return false;
-
-	for (int i = 0; (SUFFIX_OPS[i] != OP_UNKNOWN); i++)
-		if (op == SUFFIX_OPS[i])
-			return true;
-
-    	return false;
+	return getOpInfo(op)->suffix;
 }
 
 bool is_prefix_unary(enum operator op) {
-	if (!op)
-		return false;
-
-	for (int i = 0; (PREFIX_OPS[i] != OP_UNKNOWN); i++) {
-		if (PREFIX_OPS[i] == op)
-			return true;
-	}
-
-    	return false;
+	return getOpInfo(op)->prefix;
 }
 
 //inline checker functions
-static inline bool matchesOp(const int op) {
-	return (op != EOF) && strchr(OP_START, op);
-}
-
 static inline bool isKeyword(const enum key_type  key)
 {
 	return ((key >= KW_VAR) && (key <= KW_FALSE));
@@ -228,83 +449,112 @@ static inline bool isTrueFalseKey(const enum key_type  key)
     	return ((key == KW_TRUE) || (key == KW_FALSE));
 }
 
-static inline bool isDelim(const int delim) {
-   	return ((delim != EOF) && (strchr(DELIMS, delim) != NULL));
-}
-static inline enum operator getOpEnum(const char *op) {
-	for (int i = 0; i < OP_UNKNOWN; i++)
-		if (!strcmp(OP_STRINGS[i], op))
-			return (enum operator) i;
-	return OP_UNKNOWN;
-}
-static inline enum key_type getKeyType(char *keyword) {
-	if (!keyword)
+// len + KEYWORD_ASSO[first] + KEYWORD_ASSO[last] lands every keyword on
+// its own slot in 0..KEYWORDS_COUNT-1. The values came from a search over
+// small offsets, so adding a keyword means searching again. A name that
+// lands on a slot anyway is caught by the one strcmp.
+#define KEYWORD_MAX_LEN 5
+static const signed char KEYWORD_ASSO[256] = {
+	['b'] = 2, ['e'] = -1, ['f'] = -3, ['i'] = 1, ['k'] = -1, ['l'] = 4,
+	['p'] = -1, ['r'] = 3, ['t'] = 4, ['v'] = -2, ['w'] = 5,
+};
+static const enum key_type KEYWORD_SLOTS[KEYWORDS_COUNT] = {
+	KW_IF, KW_FALSE, KW_ELSE, KW_FOR, KW_VAR, KW_VAL,
+	KW_BREAK, KW_TRUE, KW_PRINT, KW_WHILE, KW_INPUT
+};
+
+static inline enum key_type getKeyType(const char *keyword, size_t len) {
+	if (!keyword || !len || (len > KEYWORD_MAX_LEN))
 		return -1;
-	for (int i = 0; KEYWORDS[i] != NULL; i++)
-		if (!strcmp(KEYWORDS[i], keyword))
-			return (enum key_type) i;
-	
-	return -1;
-}
 
+	int slot = (int) len + KEYWORD_ASSO[(unsigned char) keyword[0]] +
+		KEYWORD_ASSO[(unsigned char) keyword[len - 1]];
+	if ((slot < 0) || (slot >= KEYWORDS_COUNT))
+		return -1;
 
-static inline void getSingleLineComment(struct lexer_ctx *lex) {
-	while (lex && (advance(lex) != '\n'));
+	enum key_type key = KEYWORD_SLOTS[slot];
+	if (strncmp(KEYWORDS[key], keyword, len) || KEYWORDS[key][len])
+		return -1;
+	return key;
 }
 
-static inline void getMultiLineComment(struct lexer_ctx *lex) {
-	char prev = advance(lex);
-	char curr = advance(lex);
 
-	while (lex && (prev != '*') && (curr != '/')) {
-		prev = curr;
-		curr = advance(lex);
-	}
+//fetching value contents
+// eats ch if it's next
+static inline bool acceptChar(struct lexer_ctx *lex, const int ch) {
+	if (peek(lex) != ch)
+		return false;
+	advance(lex);
+	return true;
 }
 
-//fetching value contents
+// maximal munch: every longer operator starts with a shorter one,
+// so this just takes the longest one that matches.
 static inline enum operator getNextOp(struct lexer_ctx *lex) {
-	char tmp[MAX_OP_LEN + 1] = {0};
-	int i = 0;
-	do {
-		tmp[i] = peek(lex);
-		if ((i >= MAX_OP_LEN) || (getOpEnum(tmp) == OP_UNKNOWN)) {
-			tmp[i] = '\0';
-			break;
-		}
-		advance(lex);
-		i++;
-	} while (1);
-
-	return getOpEnum(tmp);
+	switch (advance(lex)) {
+	case '+':
+		if (acceptChar(lex, '+'))
+			return OP_INCREMENT;
+		return acceptChar(lex, '=') ? OP_PLUS_ASSIGN : OP_PLUS;
+	case '-':
+		if (acceptChar(lex, '-'))
+			return OP_DECREMENT;
+		return acceptChar(lex, '=') ? OP_MINUS_ASSIGN : OP_MINUS;
+	case '*':
+		return acceptChar(lex, '=') ? OP_MULTIPLY_ASSIGN : OP_MULTIPLY;
+	case '/':
+		return acceptChar(lex, '=') ? OP_DIVIDE_ASSIGN : OP_DIVIDE;
+	case '%':
+		return acceptChar(lex, '=') ? OP_MODULO_ASSIGN : OP_MODULO;
+	case '~':
+		return OP_BITWISE_NOT;
+	case '|':
+		if (acceptChar(lex, '|'))
+			return OP_LOGICAL_OR;
+		return acceptChar(lex, '=') ? OP_BITWISE_OR_ASSIGN : OP_BITWISE_OR;
+	case '^':
+		return acceptChar(lex, '=') ? OP_BITWISE_XOR_ASSIGN : OP_BITWISE_XOR;
+	case '&':
+		if (acceptChar(lex, '&'))
+			return OP_LOGICAL_AND;
+		return acceptChar(lex, '=') ? OP_BITWISE_AND_ASSIGN : OP_BITWISE_AND;
+	case '<':
+		if (acceptChar(lex, '<'))
+			return acceptChar(lex, '=') ? OP_LEFT_SHIFT_ASSIGN : OP_LEFT_SHIFT;
+		return acceptChar(lex, '=') ? OP_LE : OP_LT;
+	case '>':
+		if (acceptChar(lex, '>'))
+			return acceptChar(lex, '=') ? OP_RIGHT_SHIFT_ASSIGN : OP_RIGHT_SHIFT;
+		return acceptChar(lex, '=') ? OP_GE : OP_GT;
+	case '=':
+		return acceptChar(lex, '=') ? OP_EQ : OP_ASSIGN;
+	case '!':
+		return acceptChar(lex, '=') ? OP_NE : OP_LOGICAL_NOT;
+	default:
+		return OP_UNKNOWN;
+	}
 }
 
 static inline int getNextNum(struct lexer_ctx *lex) {
 	long num = 0;
-	while (isdigit(peek(lex)))
+	while (char_is(peek(lex), CC_DIGIT))
 		num = (num * 10) + (advance(lex) - '0');
 	
-	if (num >= INT_MAX)
-		raise_syntax_error(ERR_BIG_NUM, lex);
+	if (num >= INT_MAX) {
+		lexError(lex, ERR_BIG_NUM);
+		return 0;
+	}
 
 	return num;
 }
 
-static inline char *getNextWord(struct lexer_ctx *lex) {
-	int cap = MAX_WORD_LEN;
-	char *str = calloc(cap + 1, sizeof(*str));
-	if (!str)
-		raise_syntax_error(ERR_NO_MEM, lex);
-
-	int len = 0;
-	while (lex && (isalnum(peek(lex)) || (peek(lex) == '_'))) {
-		str[len++] = (char) advance(lex);
-		reset_strlen_if_needed(&str, len, &cap, lex);
-	}
-	
-	set_strlen(&str, len+1, lex);
-	str[len] = '\0';
-	return str;
+// returns the word as a slice of the source
+static inline const char *getNextWord(struct lexer_ctx *lex, size_t *len) {
+	const char *start = lex->cur;
+	while (lex && char_is(peek(lex), CC_WORD))
+		advance(lex);
+	*len = lex->cur - start;
+	return start;
 }
 
 static inline int getCharacterValue(struct lexer_ctx *lex) {
@@ -312,15 +562,18 @@ static inline int getCharacterValue(struct lexer_ctx *lex) {
 	if (ch == '\'')
 		return 0;
 
-	if (advance(lex) != '\'')
-		raise_syntax_error(ERR_UNMATCHED_QUOTE, lex);
+	if (advance(lex) != '\'') {
+		lexError(lex, ERR_UNMATCHED_QUOTE);
+		return 0;
+	}
 	//ERR_MISS_DELIM
 
 	return ch;
 }
 
-static inline char catchEscapeChar(struct lexer_ctx *lex) {
-	switch (advance(lex)) {
+// what the character after a backslash stands for, '\0' if it's not a valid escape
+static inline char escapeChar(const int ch) {
+	switch (ch) {
 	case 'n':  
 		return '\n';
 	case 't':  
@@ -336,50 +589,30 @@ static inline char catchEscapeChar(struct lexer_ctx *lex) {
 	}
 }
 
-static inline char *getNextString(struct lexer_ctx *lex) {
-	int cap = DEFAULT_LINE_CAP * 2;
-	int len = 0;
-	char *buf = calloc(cap, sizeof(*buf));
-	if (!buf)
-		raise_syntax_error(ERR_NO_MEM, lex);
+// the string's contents are left in the source as a slice, and only copied
+// (with the escapes replaced) if the parser asks for it and it has any.
+static inline void getNextString(struct lexer_ctx *lex) {
+	unsigned int start = lex->cur - lex->src;
+	bool escaped = false;
 
 	while (lex && (lex->ch != '\"') && (lex->ch != EOF)) {
-		if (lex->ch == '\\') {
-			advance(lex);
-
-			buf[len] = catchEscapeChar(lex);
-			if (buf[len++] == '\0') {
-				free(buf);
-				raise_syntax_error(ERR_INV_ESC, lex);
-			}
-		} else {
-			buf[len++] = advance(lex);
+		if (advance(lex) != '\\')
+			continue;
+		escaped = true;
+		if (escapeChar(advance(lex)) == '\0') {
+			lexError(lex, ERR_INV_ESC);
+			return;
 		}
-		reset_strlen_if_needed(&buf, len, &cap, lex);
 	}
 
+	unsigned int end = lex->cur - lex->src;
 	if (advance(lex) != '"') {
-		free(buf);
-		raise_syntax_error(ERR_UNMATCHED_QUOTE, lex);
-	}
-	set_strlen(&buf, len + 1, lex);
-	buf[len] = '\0';
-	return buf;
-}
-
-static inline char getNextDelim(struct lexer_ctx *lex) {
-	char ch = advance(lex);
-	if (ch == '/') {
-		switch (peek(lex)) {
-		case '/':
-			getSingleLineComment(lex);
-			return advance(lex);
-		case '*':
-			getMultiLineComment(lex);
-			return advance(lex);
-		}
+		lexError(lex, ERR_UNMATCHED_QUOTE);
+		return;
 	}
-	return ch;
+	lex->val.slice.off = start;
+	lex->val.slice.len = end - start;
+	lex->val.slice.escaped = escaped;
 }
 
 
@@ -394,16 +627,20 @@ static inline void initKeywordValue(enum key_type  key, struct lexer_ctx *lex) {
 	lex->val.num = key;
 }
 
-static inline void initNameValue(char *str, struct lexer_ctx *lex) {
-	enum key_type key = getKeyType(str);
+static inline void initNameValue(struct lexer_ctx *lex) {
+	size_t len;
+	const char *word = getNextWord(lex, &len);
+	enum key_type key = getKeyType(word, len);
 	if (isKeyword(key)) {
-		free(str);
 		initKeywordValue(key, lex);
 		return;
 	}
 
+	// interned when the parser takes it, so lexing doesn't touch the intern table
 	lex->val.type = VAL_NAME;
-	lex->val.str = str;
+	lex->val.slice.off = word - lex->src;
+	lex->val.slice.len = len;
+	lex->val.slice.escaped = false;
 }
 
 static inline void initOpValue(enum operator op, struct lexer_ctx *lex) {
@@ -418,8 +655,8 @@ static inline void initDelimValue(char delim, struct lexer_ctx *lex) {
 		lex->val.type = VAL_NUM;
 		return;
 	case '"':
-		lex->val.str = getNextString(lex);
 		lex->val.type = VAL_STR;
+		getNextString(lex);
 		return;
 	}
 
@@ -433,24 +670,185 @@ static inline void initNumValue(int num, struct lexer_ctx *lex) {
 }
 
 //fetching functions
-void nextValue(struct lexer_ctx *lex) {
+
+// reads the next value into lex->val. Returns false at the end of the file.
+static bool lexValue(struct lexer_ctx *lex) {
 	skip_spaces(lex);
 
 	if (!lex || lex->ch == EOF || lex->ch == '\0')
-		return;
+		return false;
 
 	lex->val.start_pos = lex->line_pos;
 
-	if (isalpha(lex->ch))
-		initNameValue(getNextWord(lex), lex);
-	else if (matchesOp(lex->ch))
+	if (char_is(lex->ch, CC_ALPHA))
+		initNameValue(lex);
+	else if (char_is(lex->ch, CC_OP))
 		initOpValue(getNextOp(lex), lex);
-	else if (isDelim(lex->ch))
+	else if (char_is(lex->ch, CC_DELIM))
 		initDelimValue(advance(lex), lex);
-	else if (isdigit(lex->ch))
+	else if (char_is(lex->ch, CC_DIGIT))
 		initNumValue(getNextNum(lex), lex);
 	else
-		raise_syntax_error(ERR_UNEXP_CHAR, lex);
+		lexError(lex, ERR_UNEXP_CHAR);
+	return !lex->tok_err;
+}
+
+// hands the value just read on to the parser, through the array, or the pipe
+// if this is the lexer thread. last is the sentinel. Returns false once the lexer should stop.
+static inline bool pushToken(struct lexer_ctx *lex, unsigned int offset, bool last) {
+	struct token tok = {
+		.val = lex->val,
+		.offset = offset,
+		.end = lex->cur - lex->src,
+		.line = lex->line_num,
+		.line_start = lex->line_start - lex->src,
+	};
+	if (lex->pipe) {
+		if (!last)
+			return tok_pipe_push(lex->pipe, &tok);
+		tok_pipe_finish(lex->pipe, &tok, lex->tok_err);
+		return false;
+	}
+
+	if (lex->num_toks + 1 >= lex->tok_cap) {
+		size_t cap = lex->tok_cap ? lex->tok_cap * 2 : (lex->src_len / 8) + 16;
+		struct token *tmp = realloc(lex->toks, cap * sizeof(*tmp));
+		if (!tmp)
+			raise_syntax_error(ERR_NO_MEM, lex);
+		lex->toks = tmp;
+		lex->tok_cap = cap;
+	}
+	lex->toks[lex->num_toks] = tok;
+	if (last)
+		return false;
+	lex->num_toks++;
+	return true;
+}
+
+// reads values in until one would start at or after limit (NULL for no limit).
+// Returns false if it stopped there, true if it got to the end and pushed the sentinel.
+static bool tokenizeUntil(struct lexer_ctx *lex, const char *limit) {
+	bool ended = true;
+	for (;;) {
+		lex->val.type = VAL_EMPTY;
+		skip_spaces(lex);
+		if (limit && (lex->cur >= limit) && (lex->ch != EOF) && !lex->tok_err) {
+			ended = false;
+			break;
+		}
+		unsigned int offset = lex->cur - lex->src;
+		bool more = lexValue(lex);
+		// the sentinel is the only value left VAL_EMPTY
+		if (lex->tok_err)
+			lex->val.type = VAL_EMPTY;
+		if (!pushToken(lex, offset, !more))
+			break;
+	}
+	lex->val = (struct value) { .type = VAL_EMPTY };
+	return ended;
+}
+
+// reads the whole file into lex->toks, then puts the lexer back at the start
+static void tokenize(struct lexer_ctx *lex) {
+	tokenizeUntil(lex, NULL);
+}
+
+void lexChunk(const struct lexer_ctx *lex, struct lex_chunk *chunk) {
+	struct lexer_ctx copy = *lex;
+	// sized for the chunk, as pushToken would guess from the whole file
+	size_t cap = ((chunk->limit - chunk->from) / 8) + 16;
+	copy.toks = malloc(cap * sizeof(*copy.toks));
+	copy.tok_cap = copy.toks ? cap : 0;
+	copy.num_toks = 0;
+	copy.tok_err = ERR_OK;
+	copy.pipe = NULL;
+	copy.esc_buf = NULL;
+	copy.esc_cap = 0;
+
+	// the chunk starts a line, so this only has to look back as far as that
+	const char *from = lex->src + chunk->from, *start = lex->src + chunk->start;
+	copy.line_num = 1;
+	copy.line_start = start;
+	for (const char *p = start; p < from; p++) {
+		if (*p == '\n') {
+			copy.line_num++;
+			copy.line_start = p + 1;
+		}
+	}
+	copy.cur = from;
+	copy.line_pos = from - copy.line_start;
+	copy.ch = peek(&copy);
+
+	chunk->ended = tokenizeUntil(&copy, lex->src + chunk->limit);
+	chunk->toks = copy.toks;
+	chunk->num_toks = copy.num_toks;
+	chunk->stop = copy.cur - copy.src;
+	chunk->err = copy.tok_err;
+}
+
+// the lexer thread, which lexes a copy of the reader into its pipe
+static void *lexThread(void *arg) {
+	struct lexer_ctx *lex = arg;
+	tokenize(lex);
+	free(lex);
+	return NULL;
+}
+
+// starts lexing on another thread, or returns false if it can't
+static bool startLexThread(struct lexer_ctx *lex) {
+	struct tok_pipe *pipe = tok_pipe_init();
+	struct lexer_ctx *copy = pipe ? malloc(sizeof(*copy)) : NULL;
+	if (copy) {
+		*copy = *lex;
+		copy->filename = NULL;
+		copy->root = NULL;
+		copy->arena = NULL;
+		copy->src_kind = SRC_BORROWED;
+		copy->pipe = pipe;
+		if (tok_pipe_run(pipe, lexThread, copy)) {
+			lex->pipe = pipe;
+			return true;
+		}
+	}
+	free(copy);
+	tok_pipe_free(pipe);
+	return false;
+}
+
+void nextValue(struct lexer_ctx *lex) {
+	if (!lex || (!lex->toks && !lex->pipe))
+		return;
+
+	// past the last token only the position moves, and val keeps the last value
+	const struct token *tok;
+	bool at_end;
+	if (lex->pipe) {
+		tok = tok_pipe_next(lex->pipe);
+		at_end = (tok->val.type == VAL_EMPTY);
+		if (at_end) {
+			lex->num_toks = lex->next_tok;
+			lex->tok_err = tok_pipe_error(lex->pipe);
+		}
+	} else {
+		tok = lex->toks + lex->next_tok;
+		at_end = (lex->next_tok >= lex->num_toks);
+	}
+	if (!at_end) {
+		lex->val = tok->val;
+		lex->next_tok++;
+	}
+
+	lex->line_num = tok->line;
+	lex->line_start = lex->src + tok->line_start;
+	lex->line_pos = tok->end - tok->line_start;
+	lex->cur = lex->src + tok->end;
+	lex->ch = peek(lex);
+
+	// the lexer stopped at an error here, raise it now that the parser's got this far
+	if (at_end && lex->tok_err) {
+		lex->val.start_pos = tok->val.start_pos;
+		raise_syntax_error(lex->tok_err, lex);
+	}
 }
 
 inline struct value Value(struct lexer_ctx *lex) {
@@ -472,13 +870,35 @@ void acceptValue(struct lexer_ctx *lex, enum value_type type, const char *expect
 }
 
 
-char *stealNextString(struct lexer_ctx *lex) {
+// copies a string with escapes into esc_buf, with the escapes replaced
+static const char *unescape(struct lexer_ctx *lex, const char *str, size_t *len) {
+	if (*len + 1 > lex->esc_cap) {
+		size_t cap = (*len + 1) * 2;
+		char *tmp = realloc(lex->esc_buf, cap);
+		if (!tmp)
+			raise_syntax_error(ERR_NO_MEM, lex);
+		lex->esc_buf = tmp;
+		lex->esc_cap = cap;
+	}
+
+	// the lexer already checked every escape is valid
+	size_t out = 0;
+	for (size_t i = 0; i < *len; i++)
+		lex->esc_buf[out++] = (str[i] == '\\') ? escapeChar(str[++i]) : str[i];
+	lex->esc_buf[out] = '\0';
+	*len = out;
+	return lex->esc_buf;
+}
+
+const char *stealNextString(struct lexer_ctx *lex, size_t *len) {
 	struct value v = lex->val;
 	if (v.type != VAL_STR)
 		raise_syntax_error(ERR_INV_VAL, lex);
 
-	char *out = v.str;
-	lex->val.str = NULL;
+	const char *out = lex->src + v.slice.off;
+	*len = v.slice.len;
+	if (v.slice.escaped)
+		out = unescape(lex, out, len);
 	lex->val.type = VAL_EMPTY;
 	nextValue(lex);
 	return out;
@@ -489,11 +909,12 @@ char *stealNextName(struct lexer_ctx *lex) {
 	if (v.type != VAL_NAME)
 		raise_syntax_error(ERR_INV_VAL, lex);
 
-	char *out = v.str;
-	lex->val.str = NULL;
+	const char *out = intern(lex->src + v.slice.off, v.slice.len);
+	if (!out)
+		raise_syntax_error(ERR_NO_MEM, lex);
 	lex->val.type = VAL_EMPTY;
 	nextValue(lex);
-	return out;
+	return (char *) out;
 }
 
 enum operator stealNextOp(struct lexer_ctx *lex) {
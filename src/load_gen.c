@@ -0,0 +1,223 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "serve.h"
+#include "utils.h"
+
+struct load_opts {
+	const char *path;
+	const char *src;
+	long src_len;
+	const char *input;
+	int conns;
+	int requests;
+	int tenants;
+};
+
+struct client {
+	const struct load_opts *opts;
+	int id;
+	int num;		// requests this client sends
+	double *latency;	// in us, one per request
+	int errors;
+	char error[SERVE_LINE_LEN];
+};
+
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6) + (ts.tv_nsec / 1e3);
+}
+
+static int connect_to(const char *path) {
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd >= 0) && (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool send_full(int fd, const void *buf, size_t len) {
+	const char *p = buf;
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+// sends one RUN and reads the reply. Returns false if the connection broke.
+static bool run_one(struct client *c, FILE *in, int fd, int i) {
+	const struct load_opts *opts = c->opts;
+	char line[SERVE_LINE_LEN];
+	int in_len = strlen(opts->input);
+	int n = snprintf(line, sizeof(line), "RUN t%d %ld %d\n",
+		(c->id + i * opts->conns) % opts->tenants, opts->src_len, in_len);
+
+	double start = now_us();
+	if (!send_full(fd, line, n) || !send_full(fd, opts->src, opts->src_len) ||
+			!send_full(fd, opts->input, in_len) || !fgets(line, sizeof(line), in))
+		return false;
+
+	size_t out_len;
+	unsigned long long steps;
+	if (sscanf(line, "OK %zu %llu", &out_len, &steps) == 2) {
+		for (size_t j = 0; j < out_len; j++)
+			if (fgetc(in) == EOF)
+				return false;
+	} else {
+		if (!c->errors++)
+			snprintf(c->error, sizeof(c->error), "%s", line);
+	}
+	c->latency[i] = now_us() - start;
+	return true;
+}
+
+static void *client_main(void *arg) {
+	struct client *c = arg;
+	int fd = connect_to(c->opts->path);
+	FILE *in = (fd >= 0) ? fdopen(fd, "r") : NULL;
+	int i = 0;
+	if (in)
+		while ((i < c->num) && run_one(c, in, fd, i))
+			i++;
+
+	// whatever didn't get sent counts as failed
+	for (; i < c->num; i++) {
+		c->latency[i] = -1;
+		if (!c->errors++)
+			snprintf(c->error, sizeof(c->error), "connection failed\n");
+	}
+	if (in)
+		fclose(in);
+	else if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p) {
+	int i = (int) (p * (n - 1) + 0.5);
+	return sorted[i];
+}
+
+// sends a one line command and prints the one line reply, if any
+static int send_command(const char *path, const char *cmd) {
+	int fd = connect_to(path);
+	if (fd < 0)
+		raise_error(ERR_NO_FILE);
+	send_full(fd, cmd, strlen(cmd));
+
+	char line[SERVE_LINE_LEN];
+	FILE *in = fdopen(fd, "r");
+	if (in && strcmp(cmd, "QUIT\n") && fgets(line, sizeof(line), in))
+		fputs(line, stdout);
+	if (in)
+		fclose(in);
+	else
+		close(fd);
+	return 0;
+}
+
+// usage: bfLoad [-c conns] [-n requests] [-t tenants] [-i input] socket file.bf
+//        bfLoad --stats socket
+//        bfLoad --quit socket
+int main(int argc, char *argv[]) {
+	struct load_opts opts = { NULL, NULL, 0, "", 4, 1000, 4 };
+	const char *file = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--stats") && (i + 1 < argc))
+			return send_command(argv[i + 1], "STATS\n");
+		else if (!strcmp(argv[i], "--quit") && (i + 1 < argc))
+			return send_command(argv[i + 1], "QUIT\n");
+		else if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+			opts.conns = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			opts.requests = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-t") && (i + 1 < argc))
+			opts.tenants = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-i") && (i + 1 < argc))
+			opts.input = argv[++i];
+		else if (!opts.path)
+			opts.path = argv[i];
+		else
+			file = argv[i];
+	}
+	if (!opts.path || !file || (opts.conns < 1) || (opts.requests < 1) || (opts.tenants < 1))
+		raise_error(ERR_NO_ARGS);
+
+	char *src = bf_read_source(file, &opts.src_len);
+	if (!src)
+		raise_error(ERR_NO_FILE);
+	opts.src = src;
+
+	struct client *clients = calloc(opts.conns, sizeof(*clients));
+	pthread_t *threads = calloc(opts.conns, sizeof(*threads));
+	double *latency = calloc(opts.requests, sizeof(*latency));
+	if (!clients || !threads || !latency)
+		raise_error(ERR_NO_MEM);
+
+	double *next = latency;
+	for (int i = 0; i < opts.conns; i++) {
+		clients[i].opts = &opts;
+		clients[i].id = i;
+		clients[i].num = opts.requests / opts.conns + (i < opts.requests % opts.conns);
+		clients[i].latency = next;
+		next += clients[i].num;
+	}
+
+	double start = now_us();
+	for (int i = 0; i < opts.conns; i++)
+		pthread_create(threads + i, NULL, client_main, clients + i);
+	int errors = 0;
+	const char *first_error = NULL;
+	for (int i = 0; i < opts.conns; i++) {
+		pthread_join(threads[i], NULL);
+		errors += clients[i].errors;
+		if (clients[i].errors && !first_error)
+			first_error = clients[i].error;
+	}
+	double elapsed = now_us() - start;
+
+	// failed connections never got a latency, leave them out
+	int n = 0;
+	for (int i = 0; i < opts.requests; i++)
+		if (latency[i] >= 0)
+			latency[n++] = latency[i];
+	qsort(latency, n, sizeof(*latency), compare_doubles);
+
+	printf("%d requests, %d errors, %d connections, %.0f req/s\n",
+		opts.requests, errors, opts.conns, opts.requests / (elapsed / 1e6));
+	if (n)
+		printf("latency (us): p50 %.0f, p90 %.0f, p99 %.0f, p99.9 %.0f, max %.0f\n",
+			percentile(latency, n, 0.5), percentile(latency, n, 0.9), percentile(latency, n, 0.99),
+			percentile(latency, n, 0.999), latency[n - 1]);
+	if (first_error)
+		printf("first error: %s", first_error);
+
+	free(clients);
+	free(threads);
+	free(latency);
+	free(src);
+	return 0;
+}
@@ -0,0 +1,202 @@
+/** @file memo.c
+ *  @brief Functions for memoizing pure brainf loops.
+ *
+ *  This contains the loop analysis, which finds loops
+ *  with no io and a statically bounded tape window, and the
+ *  runtime cache that maps (loop, window contents) to the
+ *  cells the loop ends up writing.
+ *
+ *  Every eligible loop leaves the pointer where it started,
+ *  so the pointer delta of a cached result is always zero.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "memo.h"
+
+struct memo_loop {
+	short lo;	// offset of the first window cell (<= 0), only set if width > 0
+	short width;	// 0 if the loop can't be memoized
+};
+
+struct memo_entry {
+	int pc;
+	unsigned int hash;
+	int width;
+	int num_writes;
+	int *before;	// width cells, then num_writes offsets, then num_writes values
+};
+
+struct memo_pending {
+	int pc;
+	int ptr;
+	unsigned int hash;
+	int window[MEMO_MAX_WINDOW];
+};
+
+struct memo_ctx {
+	struct memo_loop *loops;
+	struct memo_entry *table;
+	struct memo_pending *pending;
+	int num_pending, max_pending;
+	int tape_len;
+	int num_eligible;
+	unsigned long long hits, misses;
+};
+
+static inline int wrap(int idx, int tape_len) {
+	idx %= tape_len;
+	return (idx < 0) ? idx + tape_len : idx;
+}
+
+static inline void read_window(const struct memo_ctx *memo, const struct memo_loop *loop,
+		const int *tape, int ptr, int *out) {
+	int start = wrap(ptr + loop->lo, memo->tape_len);
+	for (int i = 0; i < loop->width; i++)
+		out[i] = tape[wrap(start + i, memo->tape_len)];
+}
+
+static inline unsigned int hash_window(int pc, const int *window, int width) {
+	unsigned int hash = 2166136261u;
+	hash = (hash ^ (unsigned int) pc) * 16777619u;
+	for (int i = 0; i < width; i++)
+		hash = (hash ^ (unsigned int) window[i]) * 16777619u;
+	return hash;
+}
+
+// picks out the pure loops with a small enough window
+static int analyze_loops(struct memo_ctx *memo, const struct bf_op *ops, int len) {
+	struct bf_loop_info *info = calloc(len + 1, sizeof(*info));
+	if (!info)
+		return -1;
+
+	int max_depth = bf_analyze_loops(ops, len, info);
+	for (int i = 0; (max_depth >= 0) && (i < len); i++) {
+		long width = info[i].hi - info[i].lo + 1;
+		if ((ops[i].op == BF_JZ) && info[i].pure && (width <= MEMO_MAX_WINDOW) && (width <= memo->tape_len)) {
+			memo->loops[i].lo = info[i].lo;
+			memo->loops[i].width = width;
+			memo->num_eligible++;
+		}
+	}
+
+	free(info);
+	return max_depth;
+}
+
+struct memo_ctx *memo_init(const struct bf_op *ops, int len, int tape_len) {
+	struct memo_ctx *memo = calloc(1, sizeof(*memo));
+	if (!memo)
+		return NULL;
+
+	memo->tape_len = tape_len;
+	memo->loops = calloc(len + 1, sizeof(*memo->loops));
+	memo->table = calloc(MEMO_TABLE_SIZE, sizeof(*memo->table));
+	if (!memo->loops || !memo->table) {
+		memo_free(memo);
+		return NULL;
+	}
+
+	memo->max_pending = analyze_loops(memo, ops, len);
+	if (memo->max_pending < 0) {
+		memo_free(memo);
+		return NULL;
+	}
+
+	memo->pending = calloc(memo->max_pending + 1, sizeof(*memo->pending));
+	if (!memo->pending) {
+		memo_free(memo);
+		return NULL;
+	}
+	return memo;
+}
+
+bool memo_enter(struct memo_ctx *memo, int pc, int *tape, int ptr) {
+	const struct memo_loop *loop = memo->loops + pc;
+	if (loop->width == 0)
+		return false;
+
+	struct memo_pending *p = memo->pending + memo->num_pending;
+	read_window(memo, loop, tape, ptr, p->window);
+	unsigned int hash = hash_window(pc, p->window, loop->width);
+
+	struct memo_entry *e = memo->table + (hash % MEMO_TABLE_SIZE);
+	if (e->before && (e->pc == pc) && (e->hash == hash) &&
+			!memcmp(e->before, p->window, loop->width * sizeof(*p->window))) {
+		const int *offs = e->before + e->width;
+		const int *vals = offs + e->num_writes;
+		int start = ptr + loop->lo;
+		for (int i = 0; i < e->num_writes; i++)
+			tape[wrap(start + offs[i], memo->tape_len)] = vals[i];
+		memo->hits++;
+		return true;
+	}
+
+	memo->misses++;
+	p->pc = pc;
+	p->ptr = ptr;
+	p->hash = hash;
+	memo->num_pending++;
+	return false;
+}
+
+void memo_exit(struct memo_ctx *memo, int pc, const int *tape) {
+	if (!memo->num_pending || (memo->pending[memo->num_pending - 1].pc != pc))
+		return;
+
+	struct memo_pending *p = memo->pending + --memo->num_pending;
+	const struct memo_loop *loop = memo->loops + pc;
+
+	int after[MEMO_MAX_WINDOW];
+	read_window(memo, loop, tape, p->ptr, after);
+
+	int num_writes = 0;
+	for (int i = 0; i < loop->width; i++)
+		if (after[i] != p->window[i])
+			num_writes++;
+
+	int *buf = malloc((loop->width + 2 * num_writes) * sizeof(*buf));
+	if (!buf)
+		return;
+
+	memcpy(buf, p->window, loop->width * sizeof(*buf));
+	int *offs = buf + loop->width;
+	int *vals = offs + num_writes;
+	for (int i = 0, n = 0; i < loop->width; i++) {
+		if (after[i] != p->window[i]) {
+			offs[n] = i;
+			vals[n++] = after[i];
+		}
+	}
+
+	struct memo_entry *e = memo->table + (p->hash % MEMO_TABLE_SIZE);
+	free(e->before);
+	e->pc = pc;
+	e->hash = p->hash;
+	e->width = loop->width;
+	e->num_writes = num_writes;
+	e->before = buf;
+}
+
+void memo_report(const struct memo_ctx *memo) {
+	unsigned long long total = memo->hits + memo->misses;
+	fprintf(stderr, "memo: %llu hits, %llu misses (%.1f%% hit rate), %d eligible loops\n",
+		memo->hits, memo->misses, total ? (100.0 * memo->hits) / total : 0.0, memo->num_eligible);
+}
+
+void memo_free(struct memo_ctx *memo) {
+	if (!memo)
+		return;
+	if (memo->table)
+		for (int i = 0; i < MEMO_TABLE_SIZE; i++)
+			free(memo->table[i].before);
+	free(memo->table);
+	free(memo->loops);
+	free(memo->pending);
+	free(memo);
+}
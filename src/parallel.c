@@ -0,0 +1,321 @@
+/** @file parallel.c
+ *  @brief Functions for running independent loops in parallel.
+ *
+ *  This contains the grouping of adjacent disjoint loops, a
+ *  small interpreter for pure loops that the workers run, and
+ *  the worker pool. See parallel.h for what makes a group.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "parallel.h"
+
+struct par_group {
+	int num;
+	int open[PAR_MAX_GROUP];	// the '[' of each loop
+	int offset[PAR_MAX_GROUP];	// where the pointer is at each '[', from the first one
+	int end_offset;			// and after the last ']'
+	int next_pc;
+	int hi;				// the highest offset any of them can touch
+	bool hot;
+};
+
+struct par_ctx {
+	struct bf_program prog;		// ops copied, with BF_PAR patched in
+	const struct bf_op *orig;
+	int tape_len;
+	struct par_group *groups;
+	int num_groups;
+	int max_group;
+
+	pthread_t *threads;
+	int num_threads;
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	unsigned long generation;
+	int pending;
+	bool stopping;
+
+	// the group being run right now
+	const struct par_group *cur;
+	int *tape;
+	int base;
+	unsigned long long task_steps[PAR_MAX_GROUP];
+
+	unsigned long long parallel_runs, sequential_runs;
+};
+
+struct worker_arg {
+	struct par_ctx *par;
+	int id;
+};
+
+static inline int wrap(int idx, int tape_len) {
+	idx %= tape_len;
+	return (idx < 0) ? idx + tape_len : idx;
+}
+
+// runs one pure loop to completion. Only ADD, MOVE, CLEAR and the jumps can be in it.
+static unsigned long long run_loop(const struct bf_op *ops, int open, int *tape, int ptr, int tape_len) {
+	int close = ops[open].arg;
+	unsigned long long steps = 0;
+	for (int pc = open; pc <= close; pc++) {
+		const struct bf_op *op = ops + pc;
+		steps++;
+		switch (op->op) {
+		case BF_ADD:
+			tape[ptr] += op->arg;
+			break;
+		case BF_MOVE:
+			ptr = wrap(ptr + op->arg, tape_len);
+			break;
+		case BF_CLEAR:
+			tape[ptr] = 0;
+			break;
+		case BF_JZ:
+			if (tape[ptr] == 0)
+				pc = op->arg;
+			break;
+		case BF_JNZ:
+			if (tape[ptr] != 0)
+				pc = op->arg;
+			break;
+		default:
+			break;
+		}
+	}
+	return steps;
+}
+
+static bool overlaps(int lo1, int hi1, int lo2, int hi2) {
+	return (lo1 <= hi2) && (lo2 <= hi1);
+}
+
+// tries to grow a group from the loop at open. Returns false if it's a lone loop.
+static bool build_group(const struct par_ctx *par, const struct bf_loop_info *info, int open,
+		struct par_group *g) {
+	const struct bf_op *ops = par->orig;
+	int lo[PAR_MAX_GROUP], hi[PAR_MAX_GROUP];
+	int min = info[open].lo, max = info[open].hi;
+
+	memset(g, 0, sizeof(*g));
+	g->open[0] = open;
+	lo[0] = min;
+	hi[0] = max;
+	g->num = 1;
+
+	int pc = ops[open].arg + 1, off = 0;
+	while (g->num < par->max_group) {
+		int next = pc, next_off = off;
+		while (ops[next].op == BF_MOVE)
+			next_off += ops[next++].arg;
+		if ((ops[next].op != BF_JZ) || !info[next].pure)
+			break;
+
+		int l = next_off + info[next].lo, h = next_off + info[next].hi;
+		bool disjoint = true;
+		for (int i = 0; disjoint && (i < g->num); i++)
+			disjoint = !overlaps(lo[i], hi[i], l, h);
+		int new_min = (l < min) ? l : min, new_max = (h > max) ? h : max;
+		if (!disjoint || (new_max - new_min >= par->tape_len))
+			break;
+
+		g->open[g->num] = next;
+		g->offset[g->num] = next_off;
+		lo[g->num] = l;
+		hi[g->num++] = h;
+		min = new_min;
+		max = new_max;
+		off = next_off;
+		pc = ops[next].arg + 1;
+	}
+
+	g->end_offset = off;
+	g->next_pc = pc;
+	g->hi = max;
+	return g->num > 1;
+}
+
+static int find_groups(struct par_ctx *par) {
+	int len = par->prog.len;
+	struct bf_loop_info *info = calloc(len + 1, sizeof(*info));
+	par->groups = calloc(len / 2 + 1, sizeof(*par->groups));
+	if (!info || !par->groups || (bf_analyze_loops(par->orig, len, info) < 0)) {
+		free(info);
+		return -1;
+	}
+
+	for (int i = 0; i < len; i++) {
+		if ((par->orig[i].op != BF_JZ) || !info[i].pure)
+			continue;
+		struct par_group *g = par->groups + par->num_groups;
+		if (!build_group(par, info, i, g))
+			continue;
+		par->prog.ops[i].op = BF_PAR;
+		par->prog.ops[i].arg = par->num_groups++;
+		// groups don't nest or overlap, carry on after this one
+		i = g->next_pc - 1;
+	}
+
+	free(info);
+	return 0;
+}
+
+static void *worker(void *arg) {
+	struct par_ctx *par = ((struct worker_arg *) arg)->par;
+	int id = ((struct worker_arg *) arg)->id;
+	free(arg);
+
+	unsigned long seen = 0;
+	pthread_mutex_lock(&par->lock);
+	for (;;) {
+		while ((par->generation == seen) && !par->stopping)
+			pthread_cond_wait(&par->start, &par->lock);
+		if (par->stopping)
+			break;
+		seen = par->generation;
+		const struct par_group *g = par->cur;
+		if (id >= g->num)
+			continue;
+		pthread_mutex_unlock(&par->lock);
+
+		int ptr = wrap(par->base + g->offset[id], par->tape_len);
+		unsigned long long steps = run_loop(par->orig, g->open[id], par->tape, ptr, par->tape_len);
+
+		pthread_mutex_lock(&par->lock);
+		par->task_steps[id] = steps;
+		if (--par->pending == 0)
+			pthread_cond_signal(&par->done);
+	}
+	pthread_mutex_unlock(&par->lock);
+	return NULL;
+}
+
+struct par_ctx *par_init(const struct bf_program *prog, int tape_len) {
+	struct par_ctx *par = calloc(1, sizeof(*par));
+	if (!par)
+		return NULL;
+
+	par->orig = prog->ops;
+	par->tape_len = tape_len;
+	par->prog.len = prog->len;
+	par->prog.ops = malloc(prog->len * sizeof(*par->prog.ops));
+	if (!par->prog.ops) {
+		free(par);
+		return NULL;
+	}
+	memcpy(par->prog.ops, prog->ops, prog->len * sizeof(*par->prog.ops));
+	pthread_mutex_init(&par->lock, NULL);
+	pthread_cond_init(&par->start, NULL);
+	pthread_cond_init(&par->done, NULL);
+
+	// the calling thread runs the first loop of a group, so one less worker than cores.
+	// Always at least one, so groups still run (if not faster) on a single core.
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	par->max_group = (cores < 2) ? 2 : (cores > PAR_MAX_GROUP) ? PAR_MAX_GROUP : cores;
+	if (find_groups(par) < 0) {
+		par_free(par);
+		return NULL;
+	}
+	if (!par->num_groups)
+		return par;
+
+	par->threads = calloc(par->max_group - 1, sizeof(*par->threads));
+	if (!par->threads) {
+		par_free(par);
+		return NULL;
+	}
+	for (int i = 1; i < par->max_group; i++) {
+		struct worker_arg *arg = malloc(sizeof(*arg));
+		if (arg)
+			*arg = (struct worker_arg) { par, i };
+		if (!arg || pthread_create(par->threads + par->num_threads, NULL, worker, arg)) {
+			free(arg);
+			break;
+		}
+		par->num_threads++;
+	}
+	return par;
+}
+
+const struct bf_program *par_program(const struct par_ctx *par) {
+	return &par->prog;
+}
+
+static void run_parallel(struct par_ctx *par, const struct par_group *g, int *tape, int base) {
+	pthread_mutex_lock(&par->lock);
+	par->cur = g;
+	par->tape = tape;
+	par->base = base;
+	par->pending = g->num - 1;
+	par->generation++;
+	pthread_cond_broadcast(&par->start);
+	pthread_mutex_unlock(&par->lock);
+
+	par->task_steps[0] = run_loop(par->orig, g->open[0], tape, base, par->tape_len);
+
+	pthread_mutex_lock(&par->lock);
+	while (par->pending)
+		pthread_cond_wait(&par->done, &par->lock);
+	pthread_mutex_unlock(&par->lock);
+}
+
+int par_run(struct par_ctx *par, int group, int *tape, int *ptr, long *high_water, unsigned long long *steps) {
+	struct par_group *g = par->groups + group;
+	int base = *ptr;
+
+	if (g->hot && (par->num_threads >= g->num - 1)) {
+		run_parallel(par, g, tape, base);
+		par->parallel_runs++;
+	} else {
+		for (int i = 0; i < g->num; i++)
+			par->task_steps[i] = run_loop(par->orig, g->open[i], tape,
+				wrap(base + g->offset[i], par->tape_len), par->tape_len);
+		par->sequential_runs++;
+	}
+
+	// only worth the threads while at least two of the loops are long
+	int heavy = 0;
+	for (int i = 0; i < g->num; i++) {
+		*steps += par->task_steps[i];
+		heavy += (par->task_steps[i] >= PAR_MIN_STEPS);
+	}
+	g->hot = (heavy >= 2);
+
+	*ptr = wrap(base + g->end_offset, par->tape_len);
+	int top = base + g->hi;
+	if ((top < par->tape_len) && (top > *high_water))
+		*high_water = top;
+	return g->next_pc;
+}
+
+void par_report(const struct par_ctx *par) {
+	fprintf(stderr, "parallel: %d groups, %llu parallel runs, %llu sequential runs, %d threads\n",
+		par->num_groups, par->parallel_runs, par->sequential_runs, par->num_threads + 1);
+}
+
+void par_free(struct par_ctx *par) {
+	if (!par)
+		return;
+	pthread_mutex_lock(&par->lock);
+	par->stopping = true;
+	pthread_cond_broadcast(&par->start);
+	pthread_mutex_unlock(&par->lock);
+	for (int i = 0; i < par->num_threads; i++)
+		pthread_join(par->threads[i], NULL);
+
+	pthread_mutex_destroy(&par->lock);
+	pthread_cond_destroy(&par->start);
+	pthread_cond_destroy(&par->done);
+	free(par->threads);
+	free(par->groups);
+	free(par->prog.ops);
+	free(par);
+}
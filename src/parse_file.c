@@ -2,21 +2,139 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "flat_ast.h"
+#include "flat_cache.h"
 #include "interp.h"
+#include "intern.h"
+#include "lexer.h"
 #include "parser.h"
 #include "semantics.h"
 #include "utils.h"
 #include "stmt.h"
 
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+// lexes and parses as separate steps, and prints how long each took to stderr.
+// Pipelined, they overlap, so there's only the total.
+static struct stmt *parse_timed(const char *filename, bool piped) {
+	double start = now_ms();
+	struct lexer_ctx *lex = readInFile(filename);
+	if (!lex)
+		raise_error(ERR_NO_FILE);
+	size_t num_toks = lex->num_toks;
+	double lexed = now_ms();
+	struct stmt *out = parse_tokens(lex);
+	double parsed = now_ms();
+
+	if (piped)
+		fprintf(stderr, "%s: pipelined, total %.3f ms\n", filename, parsed - start);
+	else
+		fprintf(stderr, "%s: %zu tokens, lex %.3f ms, parse %.3f ms, total %.3f ms\n",
+			filename, num_toks, lexed - start, parsed - lexed, parsed - start);
+	return out;
+}
+
+// prints the flat copy of a file through its cache (see flat_cache.h), which
+// skips the tree altogether, and with --time, whether it was a hit and how long it took
+static void print_cached(const char *filename, bool timed) {
+	double loading = now_ms();
+	struct flat_ast *ast = parse_file_flat(filename);
+	if (timed)
+		fprintf(stderr, "%s: flat %u nodes, %s in %.3f ms\n", filename, ast->len - 1,
+			ast->map ? "mapped from its cache" : "parsed and cached", now_ms() - loading);
+	print_flat_stmt(ast, FLAT_ROOT);
+	free_flat_ast(ast);
+}
+
+// usage: parser [--time] [--pipe] [--threads n] [--flat] [--cache] [--match] [-e source] file...
+// a file of - reads stdin, and -e parses its argument straight from memory.
+// --time prints how long lexing, parsing and freeing each one took, and
+// --flat prints the flat copy of the tree (see flat_ast.h) instead, which should come out the same.
+// --cache prints the flat copy too, but mapped from a cache next to the file if it
+// hasn't changed since it was written, and parsed (and cached) if it has.
+// --match takes the files (or sources) after it in pairs, and prints whether each pair's
+// trees match (see stmts_match in stmt.h) instead of printing them.
+// --pipe lexes on a second thread while the parser runs (see lex_pipe.h),
+// and --threads splits big files up to be lexed on n threads (see lex_chunks.h).
 int main(int argc, char *argv[]) {
 	if (argc <= 1)
 		raise_error(ERR_NO_ARGS);
+	bool timed = false, piped = false, flat = false, cached = false, matching = false;
+	struct stmt *pending = NULL;	// the first of a pair, with --match
     	for (int i = 1; (i < argc) && (argv[i] != NULL); i++) {
 		if (!argv[i])
 			raise_error(ERR_NO_ARGS);
-		struct stmt *expression = parse_file(argv[i]);
-		print_stmt(expression);
+		if (!strcmp(argv[i], "--time")) {
+			timed = true;
+			continue;
+		}
+		if (!strcmp(argv[i], "--threads") && (i + 1 < argc)) {
+			setLexThreads(atoi(argv[++i]));
+			continue;
+		}
+		if (!strcmp(argv[i], "--flat")) {
+			flat = true;
+			continue;
+		}
+		if (!strcmp(argv[i], "--cache")) {
+			cached = true;
+			setAstCaching(true);
+			continue;
+		}
+		if (!strcmp(argv[i], "--match")) {
+			matching = true;
+			continue;
+		}
+		if (!strcmp(argv[i], "--pipe")) {
+			piped = true;
+			setPipelinedLexing(true);
+			continue;
+		}
+		struct stmt *expression;
+		if (!strcmp(argv[i], "-e") && (i + 1 < argc)) {
+			i++;
+			expression = parse_buffer(argv[i], strlen(argv[i]), "-e");
+		} else if (cached) {
+			print_cached(argv[i], timed);
+			continue;
+		} else {
+			expression = timed ? parse_timed(argv[i], piped) : parse_file(argv[i]);
+		}
+		if (matching) {
+			if (!pending) {
+				pending = expression;
+				continue;
+			}
+			printf("%s\n", stmts_match(pending, expression) ? "match" : "differ");
+			free_stmt(pending);
+			pending = NULL;
+		} else if (flat) {
+			double flattening = now_ms();
+			struct flat_ast *ast = flatten_stmt(expression);
+			if (!ast)
+				raise_error(ERR_NO_MEM);
+			if (timed)
+				fprintf(stderr, "%s: flat %u nodes, flattened in %.3f ms\n", argv[i], ast->len - 1, now_ms() - flattening);
+			print_flat_stmt(ast, FLAT_ROOT);
+			free_flat_ast(ast);
+		} else {
+			print_stmt(expression);
+		}
+
+		// the whole tree's in one arena (see arena.h), so this doesn't depend on its size
+		double freeing = now_ms();
+		size_t ast_bytes = ast_arena_used(ast_arena_of(expression));
 		free_stmt(expression);
 		expression = NULL;
+		if (timed)
+			fprintf(stderr, "%s: ast %zu bytes, freed in %.3f ms\n", argv[i], ast_bytes, now_ms() - freeing);
     	}
-}
\ No newline at end of file
+	free_stmt(pending);
+	intern_free();
+}
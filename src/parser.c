@@ -74,37 +74,26 @@ static inline bool parses_to_int(struct exp *exp) {
 	}
 }
 
+// a loop, since prefix ops can go as deep as the source likes
 static inline bool parses_to_assignable(struct exp *exp) {
-	if (!exp)
-		return false;
-	if ((exp->type == EXP_NAME) || (exp->type == EXP_ARRAY_REF))
-		return true;
-	if (exp->type == EXP_UNARY)
-		return parses_to_assignable(exp->unary->operand);
-	return false;
+	while (exp && (exp->type == EXP_UNARY))
+		exp = exp->unary->operand;
+	return exp && ((exp->type == EXP_NAME) || (exp->type == EXP_ARRAY_REF));
 }
 
 static inline bool isOpType(const struct value v) {
 	return (v.type == VAL_OP) && v.num != OP_UNKNOWN;
 }
-static inline bool isBinaryOpVal(const struct value v) {
-	return isOpType(v) && isBinaryOp(v.num);
-}
-static inline bool isAssignOpVal(const struct value v) {
-	return isOpType(v) && isAssignOp(v.num);
-}
 static inline bool isSuffixVal(const struct value v) {
 	return isOpType(v) && is_suffix_unary(v.num);
 }
 static inline bool isPrefixVal(const struct value v) {
 	return isOpType(v) && is_prefix_unary(v.num);
 }
-static inline bool isValidOp(const struct value v, const int minPrio) {
-	if (!isOpType(v))
-		return false;
-	if (isAssignOpVal(v) || (isPrefixVal(v) && !isBinaryOpVal(v)))
-		return true;
-	return getPrio(v.num) >= minPrio;
+
+// the binding power of a value, which only ops have (see OP_INFO in lexer.c)
+static inline struct binding_power bindingPower(const struct value v) {
+	return getBindingPower((v.type == VAL_OP) ? v.num : OP_UNKNOWN);
 }
 
 static inline bool isElseKey(const struct value v) {
@@ -120,18 +109,43 @@ static inline bool isValidInitStmt(const struct stmt *stmt) {
 		((stmt->type == STMT_EXPR) && (stmt->exp->type == EXP_ASSIGN_OP || is_atomic(stmt->exp)));
 }
 
-//parsing atoms
-static inline void parsePrint(struct lexer_ctx *lex, struct exp *exp) {
-	acceptValue(lex, VAL_KEYWORD, "print");
-	acceptValue(lex, VAL_DELIM, "(");
-
-	init_exp_call(lex, exp, KW_PRINT);
+//the work stack
+// everything that nests (parentheses, right sides, indexes, array
+// elements, call arguments, prefix ops and blocks) waits on this
+// instead of the C stack, so how deep a program can go is only
+// limited by memory.
+static void pushFrame(struct lexer_ctx *lex, struct parse_frame frame) {
+	if (lex->num_frames >= lex->frames_cap) {
+		size_t cap = lex->frames_cap ? lex->frames_cap * 2 : PARSE_FRAMES_START_CAP;
+		struct parse_frame *frames = realloc(lex->frames, cap * sizeof(*frames));
+		if (!frames)
+			raise_syntax_error(ERR_NO_MEM, lex);
+		lex->frames = frames;
+		lex->frames_cap = cap;
+	}
+	lex->frames[lex->num_frames++] = frame;
+}
 
-	exp->call->arg = init_exp(lex);
-	parse_exp(0, lex, exp->call->arg);
+static inline struct parse_frame popFrame(struct lexer_ctx *lex) {
+	return lex->frames[--lex->num_frames];
+}
 
-	acceptValue(lex, VAL_DELIM, ")");
+static inline enum parse_frame_type topFrame(const struct lexer_ctx *lex) {
+	return lex->frames[lex->num_frames - 1].type;
 }
+
+// where runExp is up to
+enum exp_state {
+	AT_ATOM,	// the start of an atom
+	AT_ASSIGNABLE,	// the start of an assignable (an atom, or a prefix op's operand)
+	AT_REFS,	// after a name, at its [index]es
+	AT_SUFFIX,	// after an assignable, at a ++ or --
+	AT_ATOM_END,	// after an atom, which might be a prefix op's operand
+	AT_OPS,		// after an atom, at the ops that bind at least min_prio
+	AT_EXP_END,	// after an expression, which goes to whatever's waiting on it
+};
+
+//parsing atoms
 static inline void parseInput(struct lexer_ctx *lex, struct exp *exp) {
 	acceptValue(lex, VAL_KEYWORD, "input");
 	acceptValue(lex, VAL_DELIM, "(");
@@ -144,15 +158,18 @@ static inline void parseBreak(struct lexer_ctx *lex, struct exp *exp) {
 	init_exp_call(lex, exp, KW_BREAK);
 }
 
-static void parseCall(struct lexer_ctx *lex, struct exp *exp) {
-	struct value tok = lex->val;
-	if (tok.type != VAL_KEYWORD)
-		return;
-	
-	switch (tok.num) {
+// print's argument is waited on, input and break are done straight away
+static enum exp_state parseCall(struct lexer_ctx *lex, struct exp *exp, int *min_prio) {
+	switch (lex->val.num) {
 	case KW_PRINT:
-		parsePrint(lex, exp);
-		break;
+		acceptValue(lex, VAL_KEYWORD, "print");
+		acceptValue(lex, VAL_DELIM, "(");
+
+		init_exp_call(lex, exp, KW_PRINT);
+
+		pushFrame(lex, (struct parse_frame) { .type = PF_CALL_ARG, .min_prio = *min_prio, .exp = exp });
+		*min_prio = 0;
+		return AT_ATOM;
 	case KW_INPUT:
 		parseInput(lex, exp);
 		break;
@@ -162,6 +179,7 @@ static void parseCall(struct lexer_ctx *lex, struct exp *exp) {
 	default:
 		raise_syntax_error(ERR_INV_VAL, lex);
 	}
+	return AT_ATOM_END;
 }
 
 static inline void parseSuffix(struct exp  *left, struct lexer_ctx *lex, struct exp *exp) {
@@ -170,52 +188,44 @@ static inline void parseSuffix(struct exp  *left, struct lexer_ctx *lex, struct
 	exp->unary->op = stealNextOp(lex);
 }
 
-static inline void parsePrefix(struct lexer_ctx *lex, struct exp *exp) {
+static inline void parsePrefix(struct lexer_ctx *lex, int min_prio) {
 	if (!lex || !isPrefixVal(lex->val))
 		raise_syntax_error(ERR_INV_OP, lex);
 
 	//not folding in so that stealNextStr precedes parseSuffix and parse_atom 
 	
 
+	struct exp *exp = init_exp(lex);
 	init_exp_unary(lex, exp, true);
 	exp->unary->op = stealNextOp(lex);
-	exp->unary->operand  = init_exp(lex);
-	if (!parse_assignable(lex, exp->unary->operand))
-		raise_syntax_error(ERR_INV_EXP, lex);
+	pushFrame(lex, (struct parse_frame) { .type = PF_PREFIX, .min_prio = min_prio, .exp = exp });
 }
 
-static inline void parseParenthesis(struct lexer_ctx *lex, struct exp *exp) {
-    acceptValue(lex, VAL_DELIM, "(");
-    parse_exp(0, lex, exp);
-    acceptValue(lex, VAL_DELIM, ")");
+static inline void endArrayLit(struct lexer_ctx *lex, struct exp *exp, int len) {
+	acceptValue(lex, VAL_DELIM, "}");
+
+	set_exp_arraylit_len(lex, exp, len);
 }
 
-static inline void parseArrayLit(struct lexer_ctx *lex, struct exp *exp)
+// waits on element len of an array literal, if there is one
+static enum exp_state parseArrayElem(struct lexer_ctx *lex, struct exp *exp, int len, int *min_prio) {
+	if (!parserCanProceed(lex) || isDelimChar(lex->val, '}')) {
+		endArrayLit(lex, exp, len);
+		return AT_ATOM_END;
+	}
+
+	pushFrame(lex, (struct parse_frame) { .type = PF_ELEM, .min_prio = *min_prio, .len = len, .exp = exp });
+	*min_prio = 0;
+	return AT_ATOM;
+}
+
+static inline enum exp_state parseArrayLit(struct lexer_ctx *lex, struct exp *exp, int *min_prio)
 {
 	acceptValue(lex, VAL_DELIM, "{");
 
-	int len = 0;
 	init_exp_array_lit(lex, exp, DEFAULT_CAP_SIZE);
 
-	while (parserCanProceed(lex) && !isDelimChar(lex->val, '}')) {
-		parse_exp(0, lex, exp->array_lit->array + len++);
-		if (!hasCommaNext(lex))
-			break;
-		acceptValue(lex, VAL_DELIM, ",");
-
-		if (len >= exp->array_lit->size) { //TODO: add test?
-			exp->array_lit->size *= 2;
-			struct exp *temp = realloc(exp->array_lit->array, exp->array_lit->size);
-			if (!temp)
-				raise_syntax_error(ERR_NO_MEM, lex);
-
-			exp->array_lit->array = temp;
-		}
-	}
-
-	acceptValue(lex, VAL_DELIM, "}");
-
-	set_exp_arraylit_len(lex, exp, len);
+	return parseArrayElem(lex, exp, 0, min_prio);
 }
 
 static inline void parseNum(struct lexer_ctx *lex, struct exp *exp) {
@@ -225,14 +235,11 @@ static inline void parseNum(struct lexer_ctx *lex, struct exp *exp) {
 }
 
 static inline void parseStr(struct lexer_ctx *lex, struct exp *exp) {
-	char *str = stealNextString(lex);
-	
-	size_t len = strlen(str);
+	size_t len;
+	const char *str = stealNextString(lex, &len);
 
-	if (len > INT_MAX) {
-		free(str);
+	if (len > INT_MAX)
 		raise_syntax_error(ERR_TOO_LONG, lex);
-	}
 
 	init_exp_array_lit(lex, exp, len);
 	for (size_t i = 0; i < len; i++) {
@@ -241,65 +248,10 @@ static inline void parseStr(struct lexer_ctx *lex, struct exp *exp) {
 		curr->num = str[i];
 	}
 	set_exp_arraylit_len(lex, exp, len);
-	free(str);
 }
 
-static void parseArrayRef(struct lexer_ctx *lex, struct exp *exp) {
-	if (!isDelimChar(lex->val, '['))
-		return;
-
-	acceptValue(lex, VAL_DELIM, "[");
-	struct exp *name = init_exp(lex);
-	swap_exps(exp, name);
-	
-	
-	init_exp_array_ref(lex, exp, name);
-	if (!isDelimChar(lex->val, ']')) {
-		exp->array_ref->index = init_exp(lex);
-		parse_exp(0, lex, exp->array_ref->index);
-	}
-
-	acceptValue(lex, VAL_DELIM, "]");
-	parseArrayRef(lex, exp);
-}
-
-static inline void parseName(struct lexer_ctx *lex, struct exp *exp)
-{
-	exp->type = EXP_NAME;
-	exp->name = stealNextName(lex);
-	parseArrayRef(lex, exp);
-}
-
-bool parse_assignable(struct lexer_ctx *lex, struct exp *exp) {
-	switch (lex->val.type) {
-		case VAL_OP:
-			parsePrefix(lex, exp);
-			break;
-		case VAL_NAME:
-			parseName(lex, exp);
-			break;
-		default:
-			return false;
-	}
-
-	if (isSuffixVal(lex->val)) {
-		struct exp *left = init_exp(lex);
-		swap_exps(exp, left);
-		parseSuffix(left, lex, exp);
-	}
-
-	return true;
-}
-
-//ensure at the end of parse_atom it checks for a unary suffix
-
-void parse_atom(struct lexer_ctx *lex, struct exp *exp) {
-    	if (!parserCanProceed(lex))
-		return;
-
-	if (parse_assignable(lex, exp))
-		return;
-
+// the atoms that aren't assignable or in parentheses
+static enum exp_state parseLiteral(struct lexer_ctx *lex, struct exp *exp, int *min_prio) {
     	switch (lex->val.type) {
 	case VAL_NUM:
 		parseNum(lex, exp);
@@ -308,91 +260,266 @@ void parse_atom(struct lexer_ctx *lex, struct exp *exp) {
 		parseStr(lex, exp);
 		break;
 	case VAL_DELIM:
-		if (lex->val.ch == '(')
-			parseParenthesis(lex, exp);
-		else if (lex->val.ch == '{')
-			parseArrayLit(lex, exp);
+		if (lex->val.ch == '{')
+			return parseArrayLit(lex, exp, min_prio);
 		break;
 	case VAL_KEYWORD: // this is already covered by parse_single_stmt
-		parseCall(lex, exp);
-		break;
+		return parseCall(lex, exp, min_prio);
 	default: //mainly to shut up the compiler
 		break;
 	}
+	return AT_ATOM_END;
+}
 
-	
+// each [index] wraps what's before it
+// (only for var names, which can't nest, see AT_REFS for the rest)
+static struct exp *parseArrayRef(struct lexer_ctx *lex, struct exp *name) {
+	while (isDelimChar(lex->val, '[')) {
+		acceptValue(lex, VAL_DELIM, "[");
+		struct exp *exp = init_exp(lex);
+		init_exp_array_ref(lex, exp, name);
+		if (!isDelimChar(lex->val, ']'))
+			exp->array_ref->index = parse_exp(0, lex);
+
+		acceptValue(lex, VAL_DELIM, "]");
+		name = exp;
+	}
+	return name;
 }
 
-void parse_exp(int minPrio, struct lexer_ctx *lex, struct exp *exp)
-{
-    	parse_atom(lex, exp);
+static inline struct exp *parseNameOnly(struct lexer_ctx *lex) {
+	struct exp *exp = init_exp(lex);
+	exp->type = EXP_NAME;
+	exp->name = stealNextName(lex);
+	return exp;
+}
 
-    	while ((parserCanProceed(lex)) && isValidOp(lex->val, minPrio)) {
-		struct exp *left = init_exp(lex);
-		swap_exps(exp, left);
+static inline struct exp *parseName(struct lexer_ctx *lex)
+{
+	return parseArrayRef(lex, parseNameOnly(lex));
+}
+
+// what the states above finish with, once what was waited on is done
+static enum exp_state endWaiting(struct lexer_ctx *lex, struct parse_frame frame, struct exp **exp, int *min_prio) {
+	*min_prio = frame.min_prio;
+	switch (frame.type) {
+	case PF_RIGHT:
+		frame.exp->op->right = *exp;
+
+		frame.exp->line_num = frame.exp->op->left->line_num;
+		frame.exp->start_col = frame.exp->op->left->start_col;
+		*exp = frame.exp;
+		return AT_OPS;
+	case PF_PAREN:
+		acceptValue(lex, VAL_DELIM, ")");
+		return AT_OPS;
+	case PF_CALL_ARG:
+		frame.exp->call->arg = *exp;
+
+		acceptValue(lex, VAL_DELIM, ")");
+		*exp = frame.exp;
+		return AT_ATOM_END;
+	case PF_INDEX:
+		frame.exp->array_ref->index = *exp;
+
+		acceptValue(lex, VAL_DELIM, "]");
+		*exp = frame.exp;
+		return AT_REFS;
+	case PF_ELEM:
+		frame.exp->array_lit->array[frame.len++] = **exp;
+		*exp = frame.exp;
+		if (!hasCommaNext(lex)) {
+			endArrayLit(lex, *exp, frame.len);
+			return AT_ATOM_END;
+		}
+		acceptValue(lex, VAL_DELIM, ",");
 
-		init_binary(lex, exp, EXP_BINARY_OP, left);
-		enum operator op = stealNextOp(lex);
-		exp->type = (isAssignOp(op)) ?  EXP_ASSIGN_OP: EXP_BINARY_OP;
-	
-		if (isAssignOp(op) && !parses_to_assignable(left))
-			raise_syntax_error(ERR_INV_EXP, lex);
+		if (frame.len >= (*exp)->array_lit->size)
+			grow_exp_arraylit(lex, *exp);
+		return parseArrayElem(lex, *exp, frame.len, min_prio);
+	default:
+		raise_syntax_error(ERR_INTERNAL, lex);
+	}
+	return AT_EXP_END;
+}
+
+// parse_exp, parse_atom and parse_assignable, which go until the
+// expression started at state (and binding at least min_prio) is done.
+//
+// precedence climbing (Pratt parsing) on the ops' binding powers:
+// AT_OPS takes every op that binds at least min_prio, each one's
+// right side is everything that binds tighter than it, and every
+// node is made once, on top of the ones already made.
+static struct exp *runExp(struct lexer_ctx *lex, int min_prio, enum exp_state state) {
+	pushFrame(lex, (struct parse_frame) { .type = PF_EXP, .min_prio = min_prio });
+
+	struct exp *exp = NULL;
+	for (;;) {
+		switch (state) {
+		case AT_ATOM:
+			if (!parserCanProceed(lex)) {
+				exp = init_exp(lex);
+				state = AT_ATOM_END;
+			} else if ((lex->val.type == VAL_OP) || (lex->val.type == VAL_NAME)) {
+				state = AT_ASSIGNABLE;
+			} else if (isDelimChar(lex->val, '(')) {
+				acceptValue(lex, VAL_DELIM, "(");
+				pushFrame(lex, (struct parse_frame) { .type = PF_PAREN, .min_prio = min_prio });
+				min_prio = 0;
+			} else {
+				exp = init_exp(lex);
+				state = parseLiteral(lex, exp, &min_prio);
+			}
+			break;
+		case AT_ASSIGNABLE:
+			if (lex->val.type == VAL_OP) {
+				parsePrefix(lex, min_prio);
+			} else if (lex->val.type == VAL_NAME) {
+				exp = parseNameOnly(lex);
+				state = AT_REFS;
+			} else {
+				// only after a prefix op, everything else checks first
+				raise_syntax_error(ERR_INV_EXP, lex);
+			}
+			break;
+		case AT_REFS:
+			if (!isDelimChar(lex->val, '[')) {
+				state = AT_SUFFIX;
+				break;
+			}
+			acceptValue(lex, VAL_DELIM, "[");
+			struct exp *ref = init_exp(lex);
+			init_exp_array_ref(lex, ref, exp);
+			exp = ref;
+			if (isDelimChar(lex->val, ']')) {
+				acceptValue(lex, VAL_DELIM, "]");
+			} else {
+				pushFrame(lex, (struct parse_frame) { .type = PF_INDEX, .min_prio = min_prio, .exp = ref });
+				min_prio = 0;
+				state = AT_ATOM;
+			}
+			break;
+		case AT_SUFFIX:
+			if (isSuffixVal(lex->val)) {
+				struct exp *suffix = init_exp(lex);
+				parseSuffix(exp, lex, suffix);
+				exp = suffix;
+			}
+			state = AT_ATOM_END;
+			break;
+		case AT_ATOM_END:
+			state = AT_OPS;
+			if (topFrame(lex) == PF_PREFIX) {
+				struct parse_frame frame = popFrame(lex);
+				frame.exp->unary->operand = exp;
+				exp = frame.exp;
+				state = AT_SUFFIX;
+			}
+			break;
+		case AT_OPS: {
+			// an op isn't a delimiter, so there's no need to check for ; or } as well
+			const struct binding_power bp = bindingPower(lex->val);
+			if (bp.left < min_prio) {
+				state = AT_EXP_END;
+				break;
+			}
+			struct exp *op = init_exp(lex);
+			init_binary(lex, op, bp.assign ? EXP_ASSIGN_OP : EXP_BINARY_OP, exp);
+			op->op->op = stealNextOp(lex);
 
-		exp->op->left = left;
-		exp->op->op = op;
-		exp->op->right = init_exp(lex);
-		parse_exp(getPrio(exp->op->op)+1, lex, exp->op->right);
+			if (bp.assign && !parses_to_assignable(exp))
+				raise_syntax_error(ERR_INV_EXP, lex);
 
-		exp->line_num = left->line_num;
-		exp->start_col = left->line_num;
+			pushFrame(lex, (struct parse_frame) { .type = PF_RIGHT, .min_prio = min_prio, .exp = op });
+			min_prio = bp.right;
+			state = AT_ATOM;
+			break;
+		}
+		case AT_EXP_END:
+			if (topFrame(lex) == PF_EXP) {
+				popFrame(lex);
+				return exp;
+			}
+			state = endWaiting(lex, popFrame(lex), &exp, &min_prio);
+			break;
+		}
 	}
 }
 
+// nothing binds this tightly, so the expression ends after its first atom
+#define BP_NONE INT_MAX
+
+struct exp *parse_assignable(struct lexer_ctx *lex) {
+	if ((lex->val.type != VAL_OP) && (lex->val.type != VAL_NAME))
+		return NULL;
+	return runExp(lex, BP_NONE, AT_ASSIGNABLE);
+}
+
+struct exp *parse_atom(struct lexer_ctx *lex) {
+	return runExp(lex, BP_NONE, AT_ATOM);
+}
+
+struct exp *parse_exp(int minPrio, struct lexer_ctx *lex)
+{
+	return runExp(lex, minPrio, AT_ATOM);
+}
+
 
 //parsing stmts
+// where runStmts is up to
+enum stmt_state {
+	AT_STMT,	// the start of a statement
+	AT_STMT_END,	// after a statement, which goes to whatever's waiting on it
+	AT_BLOCK_END,	// after the last statement in a block
+};
+
+// waits on a block, starting with first, for whatever frame is
+static inline enum stmt_state openBlock(struct lexer_ctx *lex, struct parse_frame frame, struct stmt *first, struct stmt **next) {
+	pushFrame(lex, frame);
+	pushFrame(lex, (struct parse_frame) { .type = PF_BLOCK, .stmt = first });
+	*next = first;
+	return AT_STMT;
+}
+
 static void parseVar(struct lexer_ctx *lex, bool is_mutable, struct stmt *exp) {
 	enum key_type key = is_mutable ? KW_VAR : KW_VAL;
 	acceptValue(lex, VAL_KEYWORD, getKeyStr(key));
 
 	init_varStmt(lex, exp, is_mutable);
 
-	exp->var->name =  init_exp(lex);
-	parseName(lex, exp->var->name);
+	exp->var->name = parseName(lex);
 
 	if (atSemicolon(lex))
 		return;
 
 	acceptValue(lex, VAL_OP, "=");
 
-	exp->var->value = init_exp(lex);
-	parse_exp(0, lex, exp->var->value);
+	exp->var->value = parse_exp(0, lex);
 
 	if (!exps_are_compatable(exp->var->name, exp->var->value))
 		raise_syntax_error(ERR_INV_EXP, lex);
 }
 
-static void parseWhile(struct lexer_ctx *lex, struct stmt *exp) {
+static enum stmt_state parseWhile(struct lexer_ctx *lex, struct stmt *exp, struct stmt **next) {
 	init_loopStmt(lex, exp);
 
 	acceptValue(lex, VAL_KEYWORD, "while");
 	acceptValue(lex, VAL_DELIM, "(");
 
-	exp->loop->cond = init_exp(lex);
-	parse_exp(0, lex, exp->loop->cond);
+	exp->loop->cond = parse_exp(0, lex);
 
 	acceptValue(lex, VAL_DELIM, ")");
 
-	if (!atSemicolon(lex)) {
-		acceptValue(lex, VAL_DELIM, "{");
+	if (atSemicolon(lex))
+		return AT_STMT_END;
 
-		exp->loop->body = init_stmt(lex);
-		parse_stmt(lex, exp->loop->body);
+	acceptValue(lex, VAL_DELIM, "{");
 
-		acceptValue(lex, VAL_DELIM, "}");
-	}
+	exp->loop->body = init_stmt(lex);
+	return openBlock(lex, (struct parse_frame) { .type = PF_BRACE }, exp->loop->body, next);
 }
 
-static void parseFor(struct lexer_ctx *lex, struct stmt *exp) {
+static enum stmt_state parseFor(struct lexer_ctx *lex, struct stmt *exp, struct stmt **next) {
 	/* structure of a for loop:
         "for" "("<initialization> ";" <condition> ";" <update> ")" "{" <body> "}" <next>
         
@@ -405,8 +532,13 @@ static void parseFor(struct lexer_ctx *lex, struct stmt *exp) {
 	acceptValue(lex, VAL_KEYWORD, "for");
 	acceptValue(lex, VAL_DELIM, "(");
 	
-	parse_single_stmt(lex, exp); //init
-	
+	//init, then parseForLoop
+	pushFrame(lex, (struct parse_frame) { .type = PF_FOR_INIT, .len = for_start_pos, .stmt = exp });
+	*next = exp;
+	return AT_STMT;
+}
+
+static enum stmt_state parseForLoop(struct lexer_ctx *lex, struct stmt *exp, int for_start_pos, struct stmt **next) {
 	if (!isValidInitStmt(exp))
 		raise_error(ERR_INV_EXP);
 
@@ -415,79 +547,83 @@ static void parseFor(struct lexer_ctx *lex, struct stmt *exp) {
 	init_loopStmt(lex, exp->next);
 	struct stmt *loop = exp->next;
 
-	loop->loop->cond = init_exp(lex);
-	parse_exp(0, lex, loop->loop->cond);
+	loop->loop->cond = parse_exp(0, lex);
 	
 	acceptValue(lex, VAL_DELIM, ";");
 
 	loop->next = init_stmt(lex);
-	init_expStmt(loop->next, init_exp(lex));
 	struct stmt *update = loop->next;
-	
-	parse_exp(0, lex, update->exp);
+	update->type = STMT_EXPR;
+	update->exp = parse_exp(0, lex);
 
 	acceptValue(lex, VAL_DELIM, ")");
 	if (atSemicolon(lex)) {
 		acceptValue(lex, VAL_DELIM, ";");
 		loop->loop->body = update;
-	} else {
-		acceptValue(lex, VAL_DELIM, "{");
-		
-		loop->loop->body = init_stmt(lex);
-		parse_stmt(lex, loop->loop->body);
-		struct stmt *curr = loop->loop->body;
-		if (!curr || curr->type == STMT_EMPTY)
-			raise_syntax_error(ERR_INV_STMT, lex);
-		
-		while (curr->next != NULL)
-			curr = curr->next;
-
-		curr->next = update;
+		loop->next = NULL;
+		return AT_STMT_END;
+	}
+	acceptValue(lex, VAL_DELIM, "{");
 	
-		acceptValue(lex, VAL_DELIM, "}");
-	} 
-	loop->next = NULL;
+	loop->loop->body = init_stmt(lex);
+	return openBlock(lex, (struct parse_frame) { .type = PF_FOR_BODY, .stmt = loop }, loop->loop->body, next);
+}
 
+static void parseForBody(struct lexer_ctx *lex, struct stmt *loop) {
+	struct stmt *update = loop->next;
+	struct stmt *curr = loop->loop->body;
+	if (!curr || curr->type == STMT_EMPTY)
+		raise_syntax_error(ERR_INV_STMT, lex);
 	
+	while (curr->next != NULL)
+		curr = curr->next;
+
+	curr->next = update;
+
+	acceptValue(lex, VAL_DELIM, "}");
+	loop->next = NULL;
 }
 
-static void parseIf(struct lexer_ctx *lex, struct stmt *exp) {
+static enum stmt_state parseIf(struct lexer_ctx *lex, struct stmt *exp, struct stmt **next) {
 	init_ifStmt(lex, exp);
 
 	acceptValue(lex, VAL_KEYWORD, "if");
 	acceptValue(lex, VAL_DELIM, "(");
 
-	exp->ifStmt->cond = init_exp(lex);
-	parse_exp(0, lex, exp->ifStmt->cond);
+	exp->ifStmt->cond = parse_exp(0, lex);
 
 	acceptValue(lex, VAL_DELIM, ")");
 	acceptValue(lex, VAL_DELIM, "{");
 
 	exp->ifStmt->thenStmt = init_stmt(lex);
-	parse_stmt(lex, exp->ifStmt->thenStmt);
+	return openBlock(lex, (struct parse_frame) { .type = PF_IF_THEN, .stmt = exp }, exp->ifStmt->thenStmt, next);
+}
 
+// an else if takes the if's place rather than waiting on it,
+// so a chain of them doesn't build up on the stack
+static enum stmt_state parseElse(struct lexer_ctx *lex, struct stmt *exp, struct stmt **next) {
 	acceptValue(lex, VAL_DELIM, "}");
 
-	if ((lex->val.type == VAL_KEYWORD) && (lex->val.num == KW_ELSE)) {
-		acceptValue(lex, VAL_KEYWORD, "else");
-
-		exp->ifStmt->elseStmt = init_stmt(lex);
-		struct stmt *elseStmt = exp->ifStmt->elseStmt;
-		if ((lex->val.type == VAL_KEYWORD) && (lex->val.num == KW_IF)) {
-			parseIf(lex, elseStmt);
-		} else {
-			if (!isDelimChar(lex->val, '{'))
-				raise_syntax_error(ERR_BAD_ELSE, lex);
-			acceptValue(lex, VAL_DELIM, "{");
-			parse_stmt(lex, elseStmt);
-			acceptValue(lex, VAL_DELIM, "}");
-		}
-	}
+	if (!isElseKey(lex->val))
+		return AT_STMT_END;
+	acceptValue(lex, VAL_KEYWORD, "else");
+
+	exp->ifStmt->elseStmt = init_stmt(lex);
+	struct stmt *elseStmt = exp->ifStmt->elseStmt;
+	if ((lex->val.type == VAL_KEYWORD) && (lex->val.num == KW_IF))
+		return parseIf(lex, elseStmt, next);
+
+	if (!isDelimChar(lex->val, '{'))
+		raise_syntax_error(ERR_BAD_ELSE, lex);
+	acceptValue(lex, VAL_DELIM, "{");
+	return openBlock(lex, (struct parse_frame) { .type = PF_BRACE }, elseStmt, next);
 }
 
-void parse_single_stmt(struct lexer_ctx *lex, struct stmt *exp) {
+// starts exp, returning AT_STMT (with next set to it) if
+// there's another statement to parse before it's done
+static enum stmt_state parseStmtStart(struct lexer_ctx *lex, struct stmt *exp, struct stmt **next) {
 	if (!lex || !hasNextStmt(lex))
-		return;
+		return AT_STMT_END;
 	
 	struct value tok = lex->val;
 	
@@ -499,50 +635,133 @@ void parse_single_stmt(struct lexer_ctx *lex, struct stmt *exp) {
 				acceptValue(lex, VAL_DELIM, ";");
 				break;
 			case KW_WHILE:
-				parseWhile(lex, exp);
-				break;
+				return parseWhile(lex, exp, next);
 			case KW_FOR:
-				parseFor(lex, exp);
-				break;
+				return parseFor(lex, exp, next);
 			case KW_IF:
-				parseIf(lex, exp);
-				break;
+				return parseIf(lex, exp, next);
 			default:
 				exp->type = STMT_EXPR;
-				exp->exp = init_exp(lex);
-				parseCall(lex, exp->exp);
+				exp->exp = parse_atom(lex);
 				acceptValue(lex, VAL_DELIM, ";");
 				break;
 		}
 	} else {
 		exp->type = STMT_EXPR;
-		exp->exp = init_exp(lex);
-		parse_exp(0, lex, exp->exp);
+		exp->exp = parse_exp(0, lex);
 		acceptValue(lex, VAL_DELIM, ";");
 	}
+	return AT_STMT_END;
 }
 
-void parse_stmt(struct lexer_ctx *lex, struct stmt *exp) {
-	struct stmt *curr = exp;
-	parse_single_stmt(lex, curr);
-	if (curr->next == curr)
-		curr->next = NULL;
-	while (parserCanProceed(lex)) {
-		curr->next = init_stmt(lex);
-		curr = curr->next;
-		parse_single_stmt(lex, curr);
+// parse_single_stmt and parse_stmt, which go until the statement
+// (or block of them) started at exp is done
+static void runStmts(struct lexer_ctx *lex, struct stmt *exp, bool block) {
+	// the root starts off looped to itself, see startReader
+	if (exp->next == exp)
+		exp->next = NULL;
+
+	pushFrame(lex, (struct parse_frame) { .type = PF_STMTS });
+	if (block)
+		pushFrame(lex, (struct parse_frame) { .type = PF_BLOCK, .stmt = exp });
+
+	enum stmt_state state = AT_STMT;
+	for (;;) {
+		switch (state) {
+		case AT_STMT:
+			state = parseStmtStart(lex, exp, &exp);
+			break;
+		case AT_STMT_END: {
+			struct parse_frame frame = popFrame(lex);
+			switch (frame.type) {
+			case PF_BLOCK:
+				if (!parserCanProceed(lex)) {
+					state = AT_BLOCK_END;
+					break;
+				}
+				// a for is its init and then its loop, so this goes on the end
+				struct stmt *curr = frame.stmt;
+				while (curr->next != NULL)
+					curr = curr->next;
+				curr->next = init_stmt(lex);
+				exp = curr->next;
+				pushFrame(lex, (struct parse_frame) { .type = PF_BLOCK, .stmt = exp });
+				state = AT_STMT;
+				break;
+			case PF_FOR_INIT:
+				state = parseForLoop(lex, frame.stmt, frame.len, &exp);
+				break;
+			case PF_STMTS:
+				return;
+			default:
+				raise_syntax_error(ERR_INTERNAL, lex);
+			}
+			break;
+		}
+		case AT_BLOCK_END: {
+			struct parse_frame frame = popFrame(lex);
+			switch (frame.type) {
+			case PF_BRACE:
+				acceptValue(lex, VAL_DELIM, "}");
+				state = AT_STMT_END;
+				break;
+			case PF_IF_THEN:
+				state = parseElse(lex, frame.stmt, &exp);
+				break;
+			case PF_FOR_BODY:
+				parseForBody(lex, frame.stmt);
+				state = AT_STMT_END;
+				break;
+			case PF_STMTS:
+				return;
+			default:
+				raise_syntax_error(ERR_INTERNAL, lex);
+			}
+			break;
+		}
+		}
 	}
 }
 
-struct stmt *parse_file(const char *filename) {
-    struct lexer_ctx *lex = readInFile(filename);
-	if (!lex)
-		raise_syntax_error(ERR_NO_FILE, lex);
+void parse_single_stmt(struct lexer_ctx *lex, struct stmt *exp) {
+	runStmts(lex, exp, false);
+}
 
+void parse_stmt(struct lexer_ctx *lex, struct stmt *exp) {
+	runStmts(lex, exp, true);
+}
+
+struct stmt *parse_tokens(struct lexer_ctx *lex) {
 	parse_stmt(lex, lex->root);
 	struct stmt *out = lex->root;
 
+	// the caller owns the tree (and so its arena) now
 	lex->root = NULL;
+	lex->arena = NULL;
 	killReader(lex);
 	return out;
 }
+
+struct stmt *parse_file(const char *filename) {
+    struct lexer_ctx *lex = readInFile(filename);
+	if (!lex)
+		raise_syntax_error(ERR_NO_FILE, lex);
+
+	return parse_tokens(lex);
+}
+
+struct stmt *parse_buffer(const char *src, size_t len, const char *name) {
+	struct lexer_ctx *lex = readInBuffer(src, len, name);
+	if (!lex)
+		raise_syntax_error((len > INT_MAX) ? ERR_TOO_LONG : ERR_NO_MEM, lex);
+
+	return parse_tokens(lex);
+}
+
+struct stmt *parse_fd(int fd, const char *name) {
+	struct lexer_ctx *lex = readInFd(fd, name);
+	if (!lex)
+		raise_syntax_error(ERR_NO_FILE, lex);
+
+	return parse_tokens(lex);
+}
\ No newline at end of file
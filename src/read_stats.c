@@ -0,0 +1,59 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "interp.h"
+#include "utils.h"
+
+// takes a consistent copy of the counters (see publish_stats in interp.c)
+static void snapshot_stats(const struct interp_stats *shared, struct interp_stats *out) {
+	unsigned int seq;
+	do {
+		while ((seq = shared->seq) & 1)
+			;
+		__sync_synchronize();
+		*out = *shared;
+		__sync_synchronize();
+	} while (seq != shared->seq);
+}
+
+static void print_stats(const struct interp_stats *stats) {
+	printf("pid %d (%s)\n", stats->pid, stats->running ? "running" : "finished");
+	printf("  steps      %llu\n", stats->steps);
+	printf("  pc         %ld\n", stats->pc);
+	printf("  ptr        %ld\n", stats->ptr);
+	printf("  high water %ld\n", stats->high_water);
+	printf("  bytes out  %llu\n", stats->out_bytes);
+}
+
+// usage: bfStats <pid> [interval seconds]
+int main(int argc, char *argv[]) {
+	if (argc <= 1)
+		raise_error(ERR_NO_ARGS);
+
+	char name[STATS_SHM_NAME_LEN];
+	interp_stats_name(atoi(argv[1]), name);
+	int interval = (argc > 2) ? atoi(argv[2]) : 0;
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		raise_error(ERR_NO_FILE);
+
+	const struct interp_stats *shared = mmap(NULL, sizeof(*shared), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shared == MAP_FAILED)
+		raise_error(ERR_NO_MEM);
+
+	struct interp_stats stats;
+	do {
+		snapshot_stats(shared, &stats);
+		print_stats(&stats);
+		if (interval > 0)
+			sleep(interval);
+	} while ((interval > 0) && stats.running);
+
+	munmap((void *) shared, sizeof(*shared));
+	return 0;
+}
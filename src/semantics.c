@@ -10,6 +10,8 @@
  */
 
 
+#include "flat_ast.h"
+#include "flat_cache.h"
 #include "semantics.h"
 #include "parser.h"
 #include "structs.h"
@@ -22,13 +24,16 @@
 void setup_env(struct env *env, struct env *parent) {
 	env->parent = parent;
 	env->root = parent ? parent->root : NULL;
+	env->ast = parent ? parent->ast : NULL;
 	env->filename = parent ? parent->filename : NULL;
 	env->cap = STARTING_ENV_CAP;
 	env->vars = calloc(env->cap, sizeof(*env->vars));
 	env->len = 0;
 	if (!env->vars) {
-		if (parent)
+		if (parent) {
 			free_stmt(parent->root);
+			free_flat_ast(parent->ast);
+		}
 		raise_error(ERR_NO_MEM);
 	}
 }
@@ -38,7 +43,7 @@ static inline void increase_env_len(struct env *env) {
 		return;
 	
 	env->cap *= 2;
-	struct var_data *tmp = realloc(env->vars, env->cap);
+	struct var_data *tmp = realloc(env->vars, env->cap * sizeof(*env->vars));
 	if (!tmp) {
 		free_env(env);
 		raise_error(ERR_NO_MEM);
@@ -71,6 +76,8 @@ void free_env(struct env *env) {
 		}
 		free_stmt(env->root);
 		env->root = NULL;
+		free_flat_ast(env->ast);
+		env->ast = NULL;
 	}
 	free(env->vars);
 	env->vars = NULL;
@@ -96,7 +103,7 @@ struct var_data *get_var(const struct env *env, const char *name) {
 		return NULL;
 	for (size_t i = 0; i < env->len; i++) {
 		struct var_data *var = env->vars + i;
-		if ((var) && var->name && (!strcmp(var->name, name)))
+		if ((var) && (var->name == name))
 			return var;
 		}
 	return get_var(env->parent, name);
@@ -111,245 +118,256 @@ static int get_var_depth(struct env *env, const char *name) {
 	return 0;
 }
 
-// exp utility functions
-static char *get_exp_name(const struct exp *exp) {
+// exp utility functions, on the flat copy of the tree (see flat_ast.h)
+static char *get_exp_name(const struct flat_ast *ast, uint32_t exp) {
 	if (!exp)
 		return NULL;
 	
-	switch (exp->type) {
-	case EXP_ARRAY_REF:
-		return get_exp_name(exp->array_ref->name);
-	case EXP_BINARY_OP:
-	case EXP_ASSIGN_OP:
-		char *left_name = get_exp_name(exp->op->left);
+	switch (ast->kind[exp]) {
+	case FLAT_ARRAY_REF:
+		return get_exp_name(ast, ast->a[exp]);
+	case FLAT_BINARY_OP:
+	case FLAT_ASSIGN_OP:
+		char *left_name = get_exp_name(ast, ast->a[exp]);
 		if (left_name)
 			return left_name;
 		else
-			return get_exp_name(exp->op->right);
-	case EXP_UNARY:
-		return get_exp_name(exp->unary->operand);
-	case EXP_NAME:
-		return exp->name;
+			return get_exp_name(ast, ast->b[exp]);
+	case FLAT_PREFIX:
+	case FLAT_SUFFIX:
+		return get_exp_name(ast, ast->a[exp]);
+	case FLAT_NAME:
+		return flat_name(ast, exp);
 	default:
 		return NULL;
 	}
 }
 
-static inline int get_exp_name_depth(const struct exp *exp) {
-	if (exp->type == EXP_ARRAY_REF)
-		return get_exp_name_depth(exp->array_ref->name) + 1;
+static inline int get_exp_name_depth(const struct flat_ast *ast, uint32_t exp) {
+	if (ast->kind[exp] == FLAT_ARRAY_REF)
+		return get_exp_name_depth(ast, ast->a[exp]) + 1;
 	return 0;
 }
 
-static int get_exp_depth(struct env *env, const struct exp *exp) {
+static int get_exp_depth(struct env *env, uint32_t exp) {
+	const struct flat_ast *ast = env->ast;
 	if (!exp)
 		return 0;
-	switch (exp->type) {
-		case EXP_ARRAY_REF:
-			int total_depth = get_var_depth(env, get_exp_name(exp));
-			int name_depth = get_exp_name_depth(exp->array_ref->name) + 1;
+	switch (ast->kind[exp]) {
+		case FLAT_ARRAY_REF:
+			int total_depth = get_var_depth(env, get_exp_name(ast, exp));
+			int name_depth = get_exp_name_depth(ast, ast->a[exp]) + 1;
 			return total_depth - name_depth;
-		case EXP_ARRAY_LIT:
+		case FLAT_ARRAY_LIT:
 			int max = 0;
-			for (int i = 0; i < exp->array_lit->size; i++) {
-				int depth = get_exp_depth(env, exp->array_lit->array + i);
+			for (uint32_t elem = ast->a[exp]; elem; elem = ast->next[elem]) {
+				int depth = get_exp_depth(env, elem);
 				if (depth > max)
 					max = depth;
 			}
 			return max + 1;
-		case EXP_UNARY:
+		case FLAT_PREFIX:
+		case FLAT_SUFFIX:
 			return 0;
-		case EXP_ASSIGN_OP:
-		case EXP_BINARY_OP:
+		case FLAT_ASSIGN_OP:
+		case FLAT_BINARY_OP:
 			return 0;
-		case EXP_NAME:
-			return get_var_depth(env, exp->name);
+		case FLAT_NAME:
+			return get_var_depth(env, flat_name(ast, exp));
 		default:
 			return 0;
 	}
 }
 
-static inline bool exp_is_unary(const struct exp  *exp) {
-	return exp && ((exp->type == EXP_ARRAY_REF) || (exp->type == EXP_UNARY) || (exp->type == EXP_NAME));
+static inline bool exp_is_unary(const struct flat_ast *ast, uint32_t exp) {
+	return exp && ((ast->kind[exp] == FLAT_ARRAY_REF) || (ast->kind[exp] == FLAT_PREFIX) ||
+		(ast->kind[exp] == FLAT_SUFFIX) || (ast->kind[exp] == FLAT_NAME));
 }
 
-static inline bool exp_is_op(const struct exp *exp) {
-	return exp && ((exp->type == EXP_UNARY) || (exp->type == EXP_ASSIGN_OP) || (exp->type == EXP_BINARY_OP));
+static inline bool exp_is_op(const struct flat_ast *ast, uint32_t exp) {
+	return exp && ((ast->kind[exp] == FLAT_PREFIX) || (ast->kind[exp] == FLAT_SUFFIX) ||
+		(ast->kind[exp] == FLAT_ASSIGN_OP) || (ast->kind[exp] == FLAT_BINARY_OP));
 }
 
-static inline bool exp_is_mutable(struct env *env, const struct exp *exp) {
-	struct var_data *var = get_var(env, get_exp_name(exp));
+static inline bool exp_is_mutable(struct env *env, uint32_t exp) {
+	struct var_data *var = get_var(env, get_exp_name(env->ast, exp));
 	if (!var)
 		return false;
-		//raise_exp_semantic_error(ERR_NO_VAR, exp, env);
+		//raise_semantic_error(ERR_NO_VAR, exp, env);
 	return var->is_mutable;
 }
 
-static inline bool exp_is_arrayLit(const struct exp *exp) {
-	return exp && (exp->type == EXP_ARRAY_LIT) && (exp->array_lit->array != NULL);
+static inline bool exp_is_arrayLit(const struct flat_ast *ast, uint32_t exp) {
+	return exp && (ast->kind[exp] == FLAT_ARRAY_LIT) && (ast->a[exp] != FLAT_NONE);
 }
 
-static bool is_array(struct env *env, const struct exp *exp) {
+static bool is_array(struct env *env, uint32_t exp) {
 	return get_exp_depth(env, exp) > 0;
 }
 
-static inline bool setting_two_arrays(struct env *env, const struct exp *exp) {
-	if ((exp->type != EXP_ASSIGN_OP) && (exp->type != EXP_BINARY_OP))
+static inline bool setting_two_arrays(struct env *env, uint32_t exp) {
+	const struct flat_ast *ast = env->ast;
+	if ((ast->kind[exp] != FLAT_ASSIGN_OP) && (ast->kind[exp] != FLAT_BINARY_OP))
 		return false;
-	return is_array(env, exp->op->left) && is_array(env, exp->op->right) && (exp->op->op == OP_ASSIGN);
+	return is_array(env, ast->a[exp]) && is_array(env, ast->b[exp]) && (ast->op[exp] == OP_ASSIGN);
 }
 
-static inline void raise_error_if_invalid_depth(struct env *env, struct exp *exp, int depth) {
+static inline void raise_error_if_invalid_depth(struct env *env, uint32_t exp, int depth) {
 	
 }
 
-static inline void raise_error_if_immutable(struct env *env, const struct exp *exp) {
-	struct var_data *vd = get_var(env, get_exp_name(exp));
+static inline void raise_error_if_immutable(struct env *env, uint32_t exp) {
+	struct var_data *vd = get_var(env, get_exp_name(env->ast, exp));
 	if (vd && !vd->is_mutable)
-		raise_exp_semantic_error(ERR_IMMUT, exp, env);
+		raise_semantic_error(ERR_IMMUT, exp, env);
 }
 
 static inline bool op_must_be_assignable(enum operator op) {
 	return ((op == OP_INCREMENT) || (op == OP_DECREMENT));
 }
 
-static inline bool is_incrementable(struct env *env, const struct exp *exp) {
-	struct var_data *vd = get_var(env, get_exp_name(exp));
+static inline bool is_incrementable(struct env *env, uint32_t exp) {
+	struct var_data *vd = get_var(env, get_exp_name(env->ast, exp));
 	return vd->is_mutable && (vd->array_depth == 0);
 }
 
 // checker functions
-void check_exp_semantics(struct env *env, struct exp *exp) {
+void check_exp_semantics(struct env *env, uint32_t exp) {
 	if (!env || !exp)
 		return;
+	const struct flat_ast *ast = env->ast;
 
-	switch (exp->type) {
-	case EXP_NAME:
-		struct var_data *var = get_var(env, exp->name);
+	switch (ast->kind[exp]) {
+	case FLAT_NAME:
+		struct var_data *var = get_var(env, flat_name(ast, exp));
 		if (!var)
-			raise_exp_semantic_error(ERR_NO_VAR, exp, env);
+			raise_semantic_error(ERR_NO_VAR, exp, env);
 		break;
 	
-	case EXP_ASSIGN_OP:
-		struct exp *a_left = exp->op->left;
-		struct exp *a_right = exp->op->right;
+	case FLAT_ASSIGN_OP:
+		uint32_t a_left = ast->a[exp];
+		uint32_t a_right = ast->b[exp];
 		raise_error_if_immutable(env, a_left);
 		
 		if (get_exp_depth(env, a_right) != get_exp_depth(env, a_left))
-			raise_exp_semantic_error(ERR_INV_ARR, exp, env);
+			raise_semantic_error(ERR_INV_ARR, exp, env);
 
 		check_exp_semantics(env, a_left);
 		check_exp_semantics(env, a_right);
 		break;
-	case EXP_UNARY:
-		if (is_array(env, exp->unary->operand))
-			raise_exp_semantic_error(ERR_INV_ARR, exp->unary->operand, env);
+	case FLAT_PREFIX:
+	case FLAT_SUFFIX:
+		if (is_array(env, ast->a[exp]))
+			raise_semantic_error(ERR_INV_ARR, ast->a[exp], env);
 		
-		check_exp_semantics(env, exp->unary->operand);
+		check_exp_semantics(env, ast->a[exp]);
 		break;
-	case EXP_BINARY_OP:
-		struct exp *b_left = exp->op->left;
-		struct exp *b_right = exp->op->right;
+	case FLAT_BINARY_OP:
+		uint32_t b_left = ast->a[exp];
+		uint32_t b_right = ast->b[exp];
 		
 		if (is_array(env, b_left))
-			raise_exp_semantic_error(ERR_INV_ARR, b_left, env);
+			raise_semantic_error(ERR_INV_ARR, b_left, env);
 		else if (is_array(env, b_right))
-			raise_exp_semantic_error(ERR_INV_ARR, b_right, env);
+			raise_semantic_error(ERR_INV_ARR, b_right, env);
 		
 		check_exp_semantics(env, b_left);
 		check_exp_semantics(env, b_right);
 		break;
-	case EXP_ARRAY_REF:
-		if (!is_array(env, exp->array_ref->name))
-			raise_exp_semantic_error(ERR_INV_ARR, exp, env);
+	case FLAT_ARRAY_REF:
+		if (!is_array(env, ast->a[exp]))
+			raise_semantic_error(ERR_INV_ARR, exp, env);
 
-		check_exp_semantics(env, exp->array_ref->name);
-		check_exp_semantics(env, exp->array_ref->index);
+		check_exp_semantics(env, ast->a[exp]);
+		check_exp_semantics(env, ast->b[exp]);
 		break;
-	case EXP_ARRAY_LIT:
-		for (int i = 0; i < exp->array_lit->size; i++)
-			check_exp_semantics(env, exp->array_lit->array + i);
+	case FLAT_ARRAY_LIT:
+		for (uint32_t elem = ast->a[exp]; elem; elem = ast->next[elem])
+			check_exp_semantics(env, elem);
 		break;
-	case EXP_CALL:
-		if (exp->call->key == KW_PRINT)  {
-			//if(is_array(env, exp->call->arg))
-			//	raise_exp_semantic_error(ERR_INV_ARR, exp, env);
+	case FLAT_CALL:
+		if (ast->op[exp] == KW_PRINT)  {
+			//if(is_array(env, ast->a[exp]))
+			//	raise_semantic_error(ERR_INV_ARR, exp, env);
 			// I'm not sure if this should be an error. For now I'm going to say no, but
 			// TODO: confirm this is an error
-			check_exp_semantics(env, exp->call->arg);
+			check_exp_semantics(env, ast->a[exp]);
 		}
 		break;
-	case EXP_NUM:
+	case FLAT_NUM:
 		break;
 	default:
-		raise_exp_semantic_error(ERR_INV_EXP, exp, env);
+		raise_semantic_error(ERR_INV_EXP, exp, env);
 		break;
 	}
 }
 
-void check_stmt_semantics(struct env *env, struct stmt *stmt) {
-	if(!stmt)
-		return;
-
-	switch (stmt->type) {
-	case STMT_VAR:
-		bool is_mutable = stmt->var->is_mutable;
-		int depth = get_exp_name_depth(stmt->var->name);
-		char *name = get_exp_name(stmt->var->name);
-
-		if (get_exp_depth(env, stmt->var->value) > depth)
-			raise_exp_semantic_error(ERR_INV_ARR, stmt->var->value, env);
-
-		check_exp_semantics(env, stmt->var->value);
-
-		if (!define_var(env, name, is_mutable, depth))
-			raise_stmt_semantic_error(ERR_REDEF, stmt, env);
-
-		break;
-	case STMT_EXPR:
-		check_exp_semantics(env, stmt->exp);
-		break;
-	case STMT_IF:
-		if (is_array(env, stmt->ifStmt->cond))
-			raise_exp_semantic_error(ERR_INV_ARR, stmt->ifStmt->cond, env);
-		check_exp_semantics(env, stmt->ifStmt->cond);
-
-		struct env then_env;
-		setup_env(&then_env, env);
-		check_stmt_semantics(&then_env, stmt->ifStmt->thenStmt);
-		free_child_env(&then_env);
-
-		if (stmt->ifStmt->elseStmt) {
-			struct env else_env;
-			setup_env(&else_env, env);
-			check_stmt_semantics(&else_env, stmt->ifStmt->elseStmt);
-			free_child_env(&else_env);
+void check_stmt_semantics(struct env *env, uint32_t stmt) {
+	const struct flat_ast *ast = env->ast;
+
+	// the rest of the block is checked in the same env, so it's a loop
+	for (; stmt; stmt = ast->next[stmt]) {
+		switch (ast->kind[stmt]) {
+		case FLAT_VAR:
+		case FLAT_VAL:
+			uint32_t name = ast->a[stmt], value = ast->b[stmt];
+			bool is_mutable = (ast->kind[stmt] == FLAT_VAR);
+			int depth = get_exp_name_depth(ast, name);
+			char *var_name = get_exp_name(ast, name);
+
+			if (get_exp_depth(env, value) > depth)
+				raise_semantic_error(ERR_INV_ARR, value, env);
+
+			check_exp_semantics(env, value);
+
+			if (!define_var(env, var_name, is_mutable, depth))
+				raise_semantic_error(ERR_REDEF, stmt, env);
+
+			break;
+		case FLAT_EXPR:
+			check_exp_semantics(env, ast->a[stmt]);
+			break;
+		case FLAT_IF:
+			if (is_array(env, ast->a[stmt]))
+				raise_semantic_error(ERR_INV_ARR, ast->a[stmt], env);
+			check_exp_semantics(env, ast->a[stmt]);
+
+			struct env then_env;
+			setup_env(&then_env, env);
+			check_stmt_semantics(&then_env, ast->b[stmt]);
+			free_child_env(&then_env);
+
+			if (ast->c[stmt]) {
+				struct env else_env;
+				setup_env(&else_env, env);
+				check_stmt_semantics(&else_env, ast->c[stmt]);
+				free_child_env(&else_env);
+			}
+			break;
+		case FLAT_LOOP:
+			if (is_array(env, ast->a[stmt]))
+				raise_semantic_error(ERR_INV_ARR, ast->a[stmt], env);
+			check_exp_semantics(env, ast->a[stmt]);
+			struct env loop_env;
+			setup_env(&loop_env, env);
+			check_stmt_semantics(&loop_env, ast->b[stmt]);
+			free_child_env(&loop_env);
+			break;
+		default:
+			raise_semantic_error(ERR_INV_STMT, stmt, env);
+			break;
 		}
-		break;
-	case STMT_LOOP:
-		if (is_array(env, stmt->loop->cond))
-			raise_exp_semantic_error(ERR_INV_ARR, stmt->loop->cond, env);
-		check_exp_semantics(env, stmt->loop->cond);
-		struct env loop_env;
-		setup_env(&loop_env, env);
-		check_stmt_semantics(&loop_env, stmt->loop->body);
-		free_child_env(&loop_env);
-		break;
-	default:
-		raise_stmt_semantic_error(ERR_INV_STMT, stmt, env);
-		break;
 	}
-	if (stmt->next)
-		check_stmt_semantics(env, stmt->next);
 }
 
 void check_file_semantics(char *filename) {
-	struct stmt *root = parse_file(filename);
+	// the checker only needs the flat copy, which might be cached
+	struct flat_ast *ast = parse_file_flat(filename);
 
 	struct env env;
 	setup_env(&env, NULL);
-	env.root = root;
+	env.ast = ast;
 	env.filename = strdup(filename);
-	check_stmt_semantics(&env, root);
+	check_stmt_semantics(&env, FLAT_ROOT);
 	free_env(&env);
-}
\ No newline at end of file
+}
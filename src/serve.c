@@ -0,0 +1,559 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "interp.h"
+#include "serve.h"
+#include "utils.h"
+
+#define TAPE_BYTES (BUFF_SIZE * sizeof(int))
+
+struct cached_prog {
+	unsigned long long hash;
+	char *src;
+	int len;
+	struct bf_program prog;
+	int refs;
+	bool in_cache;	// false if the slot was busy, so it's freed with its last job
+};
+
+struct tenant {
+	char name[SERVE_TENANT_LEN];
+	size_t tape_bytes;		// held by this tenant's unfinished jobs
+	unsigned long long steps;	// run by its jobs this period
+	double period_start;		// in ms
+	struct job *head, *tail;	// runnable jobs
+	struct tenant *next_ready;
+	bool ready;			// on the ready ring
+};
+
+struct job {
+	struct tenant *tenant;
+	struct cached_prog *cached;
+	int *tape;
+	unsigned char *input;
+	struct interp_ctx ctx;
+
+	unsigned char *out;
+	size_t out_len, out_cap;
+	const char *error;
+
+	bool done;
+	pthread_cond_t done_cond;
+	struct job *next;
+};
+
+struct server_opts {
+	int workers;
+	unsigned long long quantum;
+	size_t max_tape;
+	unsigned long long max_steps;
+	unsigned long long tenant_steps;
+	size_t max_out;
+};
+
+static struct server_opts opts = {
+	SERVE_DEFAULT_WORKERS, SERVE_DEFAULT_QUANTUM, SERVE_DEFAULT_TAPES * TAPE_BYTES,
+	SERVE_DEFAULT_MAX_STEPS, SERVE_DEFAULT_TENANT_STEPS, SERVE_DEFAULT_MAX_OUT,
+};
+
+// the scheduler: one ring of tenants with runnable jobs, each
+// with its own queue. A worker runs one quantum of the front
+// tenant's front job, so every tenant gets the same share of
+// the pool no matter how many jobs it has queued. A tenant
+// that's used up its budget stays on the ring, but is passed
+// over until its next period.
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static struct tenant tenants[SERVE_MAX_TENANTS];
+static int num_tenants = 0;
+static struct tenant *ready_head = NULL, *ready_tail = NULL;
+static unsigned long long jobs_run = 0;
+static bool stopping = false;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct cached_prog *cache[SERVE_CACHE_SIZE];
+static unsigned long long cache_hits = 0, cache_misses = 0;
+
+static int listen_fd = -1;
+
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e3) + (ts.tv_nsec / 1e6);
+}
+
+static unsigned long long hash_src(const char *src, int len) {
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char) src[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static void free_cached(struct cached_prog *cp) {
+	bf_free_program(&cp->prog);
+	free(cp->src);
+	free(cp);
+}
+
+// returns the compiled program for src, compiling it on a miss.
+// Takes ownership of src.
+static enum err_type get_program(char *src, int len, struct cached_prog **out) {
+	unsigned long long hash = hash_src(src, len);
+	struct cached_prog **slot = cache + (hash % SERVE_CACHE_SIZE);
+
+	pthread_mutex_lock(&cache_lock);
+	struct cached_prog *cp = *slot;
+	if (cp && (cp->hash == hash) && (cp->len == len) && !memcmp(cp->src, src, len)) {
+		cp->refs++;
+		cache_hits++;
+		pthread_mutex_unlock(&cache_lock);
+		free(src);
+		*out = cp;
+		return ERR_OK;
+	}
+	cache_misses++;
+	pthread_mutex_unlock(&cache_lock);
+
+	// compile outside the lock, a big program shouldn't stall every other lookup
+	cp = calloc(1, sizeof(*cp));
+	if (!cp) {
+		free(src);
+		return ERR_NO_MEM;
+	}
+	cp->hash = hash;
+	cp->src = src;
+	cp->len = len;
+	cp->refs = 1;
+	enum err_type err = bf_compile(src, len, &cp->prog);
+	if (err != ERR_OK) {
+		free(src);
+		free(cp);
+		return err;
+	}
+
+	pthread_mutex_lock(&cache_lock);
+	struct cached_prog *old = *slot;
+	if (!old || (old->refs == 0)) {
+		if (old)
+			free_cached(old);
+		cp->in_cache = true;
+		*slot = cp;
+	}
+	pthread_mutex_unlock(&cache_lock);
+	*out = cp;
+	return ERR_OK;
+}
+
+static void put_program(struct cached_prog *cp) {
+	pthread_mutex_lock(&cache_lock);
+	bool dead = (--cp->refs == 0) && !cp->in_cache;
+	pthread_mutex_unlock(&cache_lock);
+	if (dead)
+		free_cached(cp);
+}
+
+// with sched_lock held. A tenant's budget starts over every
+// SERVE_BUDGET_PERIOD_MS, so running out only holds it up until then.
+static bool over_budget(struct tenant *t) {
+	double now = now_ms();
+	if (now - t->period_start >= SERVE_BUDGET_PERIOD_MS) {
+		t->period_start = now;
+		t->steps = 0;
+	}
+	return t->steps >= opts.tenant_steps;
+}
+
+// with sched_lock held. Once every slot's been used, a new tenant
+// takes the slot of one with no jobs left (every job holds tape, so
+// that's no tape), as long as it's within its budget, so going idle
+// doesn't start a tenant's budget over.
+static struct tenant *find_tenant(const char *name) {
+	struct tenant *idle = NULL;
+	for (int i = 0; i < num_tenants; i++) {
+		if (!strcmp(tenants[i].name, name))
+			return tenants + i;
+		if (!idle && !tenants[i].tape_bytes && !over_budget(tenants + i))
+			idle = tenants + i;
+	}
+
+	struct tenant *t = NULL;
+	if (num_tenants < SERVE_MAX_TENANTS)
+		t = tenants + num_tenants++;
+	else if (idle)
+		t = idle;
+	else
+		return NULL;
+	*t = (struct tenant) {0};
+	snprintf(t->name, sizeof(t->name), "%s", name);
+	return t;
+}
+
+// with sched_lock held
+static void make_ready(struct tenant *t) {
+	t->ready = true;
+	t->next_ready = NULL;
+	if (ready_tail)
+		ready_tail->next_ready = t;
+	else
+		ready_head = t;
+	ready_tail = t;
+	pthread_cond_signal(&work_ready);
+}
+
+// with sched_lock held
+static void push_job(struct job *job) {
+	struct tenant *t = job->tenant;
+	job->next = NULL;
+	if (t->tail)
+		t->tail->next = job;
+	else
+		t->head = job;
+	t->tail = job;
+	if (!t->ready)
+		make_ready(t);
+}
+
+// with sched_lock held. Takes the front job of the first tenant on
+// the ring that's within its budget, or returns NULL and sets *resume
+// to when the first of them gets a new one (0 if the ring's empty).
+static struct job *pop_job(double *resume) {
+	struct tenant *t = ready_head, *prev = NULL;
+	*resume = 0;
+	for (; t && over_budget(t); prev = t, t = t->next_ready) {
+		double next_period = t->period_start + SERVE_BUDGET_PERIOD_MS;
+		if (!*resume || (next_period < *resume))
+			*resume = next_period;
+	}
+	if (!t)
+		return NULL;
+
+	if (prev)
+		prev->next_ready = t->next_ready;
+	else
+		ready_head = t->next_ready;
+	if (ready_tail == t)
+		ready_tail = prev;
+	t->ready = false;
+
+	struct job *job = t->head;
+	t->head = job->next;
+	// back of the ring right away, so other workers can run its other jobs
+	if (t->head)
+		make_ready(t);
+	else
+		t->tail = NULL;
+	return job;
+}
+
+static bool append_output(struct job *job) {
+	size_t need = job->out_len + job->ctx.out_len;
+	if (need > opts.max_out)
+		return false;
+	if (need > job->out_cap) {
+		size_t cap = job->out_cap ? job->out_cap * 2 : INTERP_OUT_CAP;
+		while (cap < need)
+			cap *= 2;
+		unsigned char *out = realloc(job->out, cap);
+		if (!out)
+			return false;
+		job->out = out;
+		job->out_cap = cap;
+	}
+	memcpy(job->out + job->out_len, job->ctx.out, job->ctx.out_len);
+	job->out_len = need;
+	job->ctx.out_len = 0;
+	return true;
+}
+
+// runs one quantum of job. Returns true when it's finished.
+static bool run_slice(struct job *job) {
+	enum interp_status status;
+	do {
+		status = interp_resume(&job->ctx);
+		if (!append_output(job)) {
+			job->error = "output quota";
+			return true;
+		}
+	} while (status == INTERP_OUTPUT_READY);
+
+	if ((status != INTERP_DONE) && (job->ctx.steps >= opts.max_steps)) {
+		job->error = "cpu quota";
+		return true;
+	}
+	return status == INTERP_DONE;
+}
+
+static void *worker(void *arg) {
+	(void) arg;
+	pthread_mutex_lock(&sched_lock);
+	for (;;) {
+		struct job *job = NULL;
+		double resume;
+		while (!stopping && !(job = pop_job(&resume))) {
+			if (!resume) {
+				pthread_cond_wait(&work_ready, &sched_lock);
+				continue;
+			}
+			// every tenant with work is over budget, so wait for the first to get more
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			double wait_ms = resume - now_ms();
+			long long ns = until.tv_nsec + (long long) ((wait_ms > 0 ? wait_ms : 0) * 1e6);
+			until.tv_sec += ns / 1000000000;
+			until.tv_nsec = ns % 1000000000;
+			pthread_cond_timedwait(&work_ready, &sched_lock, &until);
+		}
+		if (stopping)
+			break;
+
+		struct tenant *t = job->tenant;
+		pthread_mutex_unlock(&sched_lock);
+
+		unsigned long long before = job->ctx.steps;
+		bool finished = run_slice(job);
+
+		pthread_mutex_lock(&sched_lock);
+		// a tenant that's used up its budget keeps its jobs, pop_job just passes it over
+		t->steps += job->ctx.steps - before;
+		if (finished) {
+			t->tape_bytes -= TAPE_BYTES;
+			jobs_run++;
+			job->done = true;
+			pthread_cond_signal(&job->done_cond);
+		} else {
+			push_job(job);
+		}
+	}
+	pthread_mutex_unlock(&sched_lock);
+	return NULL;
+}
+
+static bool read_full(FILE *in, void *buf, size_t len) {
+	return fread(buf, 1, len, in) == len;
+}
+
+static void write_full(int fd, const void *buf, size_t len) {
+	const char *p = buf;
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+static void reply_error(int fd, const char *reason) {
+	char line[SERVE_LINE_LEN];
+	int n = snprintf(line, sizeof(line), "ERR %s\n", reason);
+	write_full(fd, line, n);
+}
+
+// sets up and queues the job, then blocks until a worker finishes it
+static void run_job(int fd, const char *tenant, char *src, int src_len, unsigned char *input, int in_len) {
+	struct job job = {0};
+	job.input = input;
+
+	enum err_type err = get_program(src, src_len, &job.cached);
+	if (err != ERR_OK) {
+		reply_error(fd, (err == ERR_UNMATCHED_BRACKET) ? "unmatched bracket" : "out of memory");
+		return;
+	}
+
+	pthread_mutex_lock(&sched_lock);
+	struct tenant *t = find_tenant(tenant);
+	const char *reject = !t ? "too many tenants" :
+		(t->tape_bytes + TAPE_BYTES > opts.max_tape) ? "tape quota" :
+		over_budget(t) ? "tenant cpu quota" : NULL;
+	if (!reject)
+		t->tape_bytes += TAPE_BYTES;
+	pthread_mutex_unlock(&sched_lock);
+	if (reject) {
+		put_program(job.cached);
+		reply_error(fd, reject);
+		return;
+	}
+
+	job.tenant = t;
+	job.tape = calloc(BUFF_SIZE, sizeof(*job.tape));
+	if (!job.tape || (interp_init(&job.ctx, &job.cached->prog, NULL, job.tape) != ERR_OK)) {
+		job.error = "out of memory";
+	} else {
+		job.ctx.quantum = opts.quantum;
+		interp_feed(&job.ctx, input, in_len);
+		interp_feed_eof(&job.ctx);
+		pthread_cond_init(&job.done_cond, NULL);
+
+		pthread_mutex_lock(&sched_lock);
+		push_job(&job);
+		while (!job.done)
+			pthread_cond_wait(&job.done_cond, &sched_lock);
+		pthread_mutex_unlock(&sched_lock);
+
+		pthread_cond_destroy(&job.done_cond);
+		interp_free(&job.ctx);
+	}
+
+	if (job.error) {
+		reply_error(fd, job.error);
+	} else {
+		char line[SERVE_LINE_LEN];
+		int n = snprintf(line, sizeof(line), "OK %zu %llu\n", job.out_len, job.ctx.steps);
+		write_full(fd, line, n);
+		write_full(fd, job.out, job.out_len);
+	}
+
+	if (!job.done) {
+		pthread_mutex_lock(&sched_lock);
+		t->tape_bytes -= TAPE_BYTES;
+		pthread_mutex_unlock(&sched_lock);
+	}
+	free(job.out);
+	free(job.tape);
+	put_program(job.cached);
+}
+
+static void stop_server(void) {
+	pthread_mutex_lock(&sched_lock);
+	stopping = true;
+	pthread_cond_broadcast(&work_ready);
+	pthread_mutex_unlock(&sched_lock);
+	shutdown(listen_fd, SHUT_RDWR);
+}
+
+static void *connection(void *arg) {
+	int fd = (int) (long) arg;
+	FILE *in = fdopen(fd, "r");
+	if (!in) {
+		close(fd);
+		return NULL;
+	}
+
+	char line[SERVE_LINE_LEN];
+	while (fgets(line, sizeof(line), in)) {
+		char tenant[SERVE_TENANT_LEN];
+		int src_len, in_len;
+
+		if (!strcmp(line, "QUIT\n")) {
+			stop_server();
+			break;
+		} else if (!strcmp(line, "STATS\n")) {
+			pthread_mutex_lock(&sched_lock);
+			unsigned long long jobs = jobs_run;
+			int n_tenants = num_tenants;
+			pthread_mutex_unlock(&sched_lock);
+			pthread_mutex_lock(&cache_lock);
+			int n = snprintf(line, sizeof(line), "STATS %llu jobs, %llu hits, %llu misses, %d tenants\n",
+				jobs, cache_hits, cache_misses, n_tenants);
+			pthread_mutex_unlock(&cache_lock);
+			write_full(fd, line, n);
+			continue;
+		}
+
+		if ((sscanf(line, "RUN %31s %d %d", tenant, &src_len, &in_len) != 3) ||
+				(src_len < 0) || (src_len > SERVE_MAX_SRC) || (in_len < 0) || (in_len > SERVE_MAX_INPUT)) {
+			reply_error(fd, "bad request");
+			break;
+		}
+
+		char *src = malloc(src_len + 1);
+		unsigned char *input = malloc(in_len + 1);
+		if (!src || !input || !read_full(in, src, src_len) || !read_full(in, input, in_len)) {
+			free(src);
+			free(input);
+			break;
+		}
+		run_job(fd, tenant, src, src_len, input, in_len);
+		free(input);
+	}
+
+	fclose(in);
+	return NULL;
+}
+
+static int open_socket(const char *path) {
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	unlink(path);
+	if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) || (listen(fd, 128) < 0)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// usage: bfServe [-w workers] [-q quantum] [-m tape bytes] [-c max steps] [-b tenant steps] [-o max output] socket
+int main(int argc, char *argv[]) {
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-w") && (i + 1 < argc))
+			opts.workers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-q") && (i + 1 < argc))
+			opts.quantum = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-m") && (i + 1 < argc))
+			opts.max_tape = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+			opts.max_steps = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-b") && (i + 1 < argc))
+			opts.tenant_steps = strtoull(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "-o") && (i + 1 < argc))
+			opts.max_out = strtoull(argv[++i], NULL, 10);
+		else
+			path = argv[i];
+	}
+	if (!path || (opts.workers < 1))
+		raise_error(ERR_NO_ARGS);
+
+	signal(SIGPIPE, SIG_IGN);
+	listen_fd = open_socket(path);
+	if (listen_fd < 0)
+		raise_error(ERR_NO_FILE);
+
+	pthread_t *pool = calloc(opts.workers, sizeof(*pool));
+	if (!pool)
+		raise_error(ERR_NO_MEM);
+	for (int i = 0; i < opts.workers; i++)
+		pthread_create(pool + i, NULL, worker, NULL);
+	fprintf(stderr, "bfServe: listening on %s with %d workers\n", path, opts.workers);
+
+	for (;;) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, connection, (void *) (long) fd) != 0) {
+			close(fd);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+
+	stop_server();
+	for (int i = 0; i < opts.workers; i++)
+		pthread_join(pool[i], NULL);
+	free(pool);
+	close(listen_fd);
+	unlink(path);
+	return 0;
+}
@@ -12,117 +12,105 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include "arena.h"
 #include "stmt.h"
 #include "exp.h"
 #include "lexer.h"
 #include "utils.h"
+#include "walk.h"
 
-// freeing functions
+// the whole tree is in one arena, so it goes in one go
 void free_stmt(struct stmt *stmt) {
 	if (!stmt)
 		return;
+	ast_arena_free(ast_arena_of(stmt));
+}
+
+//print functions
+// print_stmt goes through ast_walk, so these print a node on the way
+// in, between its children, and on the way out (exps are print_exp's)
+static void print_stmt_pre(struct ast_node node, void *data) {
+	if (!node.is_stmt) {
+		print_exp_visitor.pre(node, data);
+		return;
+	}
+	const struct stmt *stmt = node.stmt;
 	switch (stmt->type) {
 	case STMT_EMPTY:
+		printf("EMPTY();\n");
 		break;
 	case STMT_VAR:
-		if (!stmt->var)
-			return;
-		free_exp(stmt->var->name);
-		stmt->var->name = NULL;
-		free_exp(stmt->var->value);
-		stmt->var->value = NULL;
-		free(stmt->var);
-		stmt->var = NULL;
+		printf("%s(", (stmt->var->is_mutable) ? "VAR" : "VAL");
 		break;
 	case STMT_LOOP:
-		if (!stmt->loop)
-			return;
-		free_exp(stmt->loop->cond);
-		stmt->loop->cond = NULL;
-		free_stmt(stmt->loop->body);
-		stmt->loop->body = NULL;
-		free(stmt->loop);
-		stmt->loop = NULL;
+		printf("LOOP(");
 		break;
 	case STMT_IF:
-		if (!stmt->ifStmt)
-			return;
-		free_exp(stmt->ifStmt->cond);
-		stmt->ifStmt->cond = NULL;
-		free_stmt(stmt->ifStmt->thenStmt);
-		stmt->ifStmt->thenStmt = NULL;
-		free_stmt(stmt->ifStmt->elseStmt);
-		stmt->ifStmt->elseStmt = NULL;
-		free(stmt->ifStmt);
-		stmt->ifStmt = NULL;
+		printf("IF(");
 		break;
 	case STMT_EXPR:
-		free_exp(stmt->exp);
-		stmt->exp = NULL;
+		printf("EXP_");
 		break;
 	}
+}
 
-	if (stmt->next != stmt) {
-		free_stmt(stmt->next);
-		stmt->next = NULL;
+static void print_stmt_in(struct ast_node node, int child, void *data) {
+	if (!node.is_stmt) {
+		print_exp_visitor.in(node, child, data);
+		return;
+	}
+	const struct stmt *stmt = node.stmt;
+	switch (stmt->type) {
+	case STMT_VAR:
+		if (stmt->var->value)
+			printf(", ");
+		break;
+	case STMT_LOOP:
+		printf((stmt->loop->body) ? ") {\n" : ");\n");
+		break;
+	case STMT_IF:
+		printf((child == 1) ? ") {\n" : "} else {\n");
+		break;
+	case STMT_EMPTY:
+	case STMT_EXPR:
+		break;
 	}
-	free(stmt);
 }
 
-//print functions
-void print_stmt(const struct stmt *stmt) {
-	if (!stmt)
+static void print_stmt_post(struct ast_node node, void *data) {
+	if (!node.is_stmt) {
+		print_exp_visitor.post(node, data);
 		return;
+	}
+	const struct stmt *stmt = node.stmt;
 	switch (stmt->type) {
 	case STMT_EMPTY:
-		printf("EMPTY();\n");
 		break;
 	case STMT_VAR:
-		char *name = (stmt->var->is_mutable) ? "VAR" : "VAL";
-		printf("%s(", name);
-		print_exp(stmt->var->name);
-		if (stmt->var->value) {
-			printf(", ");
-			print_exp(stmt->var->value);
-		}
 		printf(");\n");
 		break;
-		break;
 	case STMT_LOOP:
-		printf("LOOP(");
-		print_exp(stmt->loop->cond);
-		printf(")");
-		if (stmt->loop->body) {
-			printf(" {\n");
-			print_stmt(stmt->loop->body);
+		if (stmt->loop->body)
 			printf("}\n");
-		} else {
-			printf(";\n");
-		}
 		break;
 	case STMT_IF:
-		printf("IF(");
-		print_exp(stmt->ifStmt->cond);
-		printf(") {\n");
-		print_stmt(stmt->ifStmt->thenStmt);
-		printf("} else {\n");
-		print_stmt(stmt->ifStmt->elseStmt);
 		printf("}\n");
 		break;
 	case STMT_EXPR:
-		printf("EXP_");
-		print_exp(stmt->exp);
 		printf(";\n");
 		break;
 	}
+}
+
+static const struct ast_visitor print_stmt_visitor = {print_stmt_pre, print_stmt_in, print_stmt_post};
 
-	if (stmt->next != stmt)
-		print_stmt(stmt->next);
+void print_stmt(const struct stmt *stmt) {
+	ast_walk(stmt_node(stmt), &print_stmt_visitor, NULL);
 }
 
 
 struct stmt *init_stmt(struct lexer_ctx *lex) {
-	struct stmt *s = calloc(1, sizeof(*s));
+	struct stmt *s = ast_alloc(lex->arena, sizeof(*s));
 	if (!s)
 		raise_syntax_error(ERR_NO_MEM, lex);
 	
@@ -134,7 +122,7 @@ struct stmt *init_stmt(struct lexer_ctx *lex) {
 
 void init_varStmt(struct lexer_ctx *lex, struct stmt *stmt, bool is_mutable) {
 	stmt->type = STMT_VAR;
-	stmt->var = calloc(1, sizeof(*(stmt->var)));
+	stmt->var = ast_alloc(lex->arena, sizeof(*(stmt->var)));
 	stmt->line_num = lex->line_num;
 	stmt->start_col = lex->val.start_pos;
 	
@@ -145,7 +133,7 @@ void init_varStmt(struct lexer_ctx *lex, struct stmt *stmt, bool is_mutable) {
 
 void init_ifStmt(struct lexer_ctx *lex, struct stmt *stmt) {
 	stmt->type = STMT_IF;
-	stmt->ifStmt = calloc(1, sizeof(*(stmt->ifStmt)));
+	stmt->ifStmt = ast_alloc(lex->arena, sizeof(*(stmt->ifStmt)));
 	stmt->line_num = lex->line_num;
 	stmt->start_col = lex->val.start_pos;
 	
@@ -155,7 +143,7 @@ void init_ifStmt(struct lexer_ctx *lex, struct stmt *stmt) {
 
 void init_loopStmt(struct lexer_ctx *lex, struct stmt *stmt) {
 	stmt->type = STMT_LOOP;
-	stmt->loop = calloc(1, sizeof(*(stmt->loop)));
+	stmt->loop = ast_alloc(lex->arena, sizeof(*(stmt->loop)));
 	stmt->line_num = lex->line_num;
 	stmt->start_col = lex->val.start_pos;
 	
@@ -171,36 +159,31 @@ void init_expStmt(struct stmt *stmt, struct exp *exp) {
 }
 
 // for later error checking
-bool stmts_match(const struct stmt *stmt1, const struct stmt *stmt2) {
-	if (!stmt1 != !stmt2)
+static bool stmt_nodes_match(struct ast_node a, struct ast_node b) {
+	if (a.is_stmt != b.is_stmt)
 		return false;
-	else if (stmt1 == stmt2) //handles the two pointing to the same address and both being null
-		return true;
-	else if ((stmt1->type != stmt2->type) || !stmts_match(stmt1->next, stmt2->next))
+	if (!a.is_stmt)
+		return exp_nodes_match(a.exp, b.exp);
+	if (a.stmt->type != b.stmt->type)
 		return false;
 
-	switch (stmt1->type) {
+	switch (a.stmt->type) {
 	case STMT_EMPTY:
-		return true;
-	case STMT_VAR:
-		bool names_match = exps_match(stmt1->var->name, stmt2->var->name);
-		bool vals_match = exps_match(stmt1->var->value, stmt2->var->value);
-		bool muts_match = stmt1->var->is_mutable == stmt2->var->is_mutable;
-		return names_match && vals_match && muts_match;
 	case STMT_LOOP:
-		bool conds_match = exps_match(stmt1->loop->cond, stmt2->loop->cond);
-		bool bodys_match = stmts_match(stmt1->loop->body, stmt2->loop->body);
-		return conds_match && bodys_match;
 	case STMT_IF:
-		bool if_conds_match = exps_match(stmt1->ifStmt->cond, stmt2->ifStmt->cond);
-		bool thens_match = stmts_match(stmt1->ifStmt->thenStmt, stmt2->ifStmt->thenStmt);
-		bool elses_match = stmts_match(stmt1->ifStmt->elseStmt, stmt2->ifStmt->elseStmt);
-		return if_conds_match && thens_match && elses_match;
 	case STMT_EXPR:
-		return exps_match(stmt1->exp, stmt2->exp);
+		return true;
+	case STMT_VAR:
+		return a.stmt->var->is_mutable == b.stmt->var->is_mutable;
 	default:
 		raise_error(ERR_INV_STMT);
 		//ERR_INV_STMT
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+bool stmts_match(const struct stmt *stmt1, const struct stmt *stmt2) {
+	if (stmt1 == stmt2) //handles the two pointing to the same address and both being null
+		return true;
+	return ast_walks_match(stmt_node(stmt1), stmt_node(stmt2), stmt_nodes_match);
+}
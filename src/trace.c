@@ -0,0 +1,107 @@
+/** @file trace.c
+ *  @brief Functions for the execution trace ring buffer.
+ *
+ *  This contains the setup of the ring, the signal handlers
+ *  that dump it, and the dump itself. The hot part, trace_push,
+ *  is inline in trace.h.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+static const int fatal_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGINT, SIGTERM };
+#define NUM_FATAL_SIGNALS (sizeof(fatal_signals) / sizeof(fatal_signals[0]))
+
+volatile sig_atomic_t trace_dump_requested = 0;
+static struct trace_ring *live_ring = NULL;
+
+static void on_fatal(int sig) {
+	if (live_ring)
+		trace_dump(live_ring);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void on_sigusr2(int sig) {
+	(void) sig;
+	trace_dump_requested = 1;
+}
+
+struct trace_ring *trace_init(const struct bf_program *prog, unsigned long len, const char *path) {
+	uint64_t size = 1;
+	while (size < len)
+		size <<= 1;
+
+	struct trace_ring *ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+	ring->recs = calloc(size, sizeof(*ring->recs));
+	ring->fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if (!ring->recs || (ring->fd < 0)) {
+		trace_free(ring);
+		return NULL;
+	}
+	ring->mask = size - 1;
+	ring->prog = prog;
+
+	live_ring = ring;
+	for (size_t i = 0; i < NUM_FATAL_SIGNALS; i++)
+		signal(fatal_signals[i], on_fatal);
+	signal(SIGUSR2, on_sigusr2);
+	return ring;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+	const char *p = buf;
+	while (len) {
+		ssize_t n = write(fd, p, len);
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool trace_dump(const struct trace_ring *ring) {
+	uint64_t size = ring->mask + 1;
+	uint64_t num = (ring->total < size) ? ring->total : size;
+	uint64_t first = (ring->total - num) & ring->mask;
+
+	struct trace_header header;
+	memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+	header.version = TRACE_VERSION;
+	header.rec_size = sizeof(struct trace_rec);
+	header.num_ops = ring->prog->len;
+	header.total = ring->total;
+	header.num_recs = num;
+
+	// oldest first: the tail of the array, then the start of it
+	uint64_t tail = (first + num > size) ? size - first : num;
+	return (lseek(ring->fd, 0, SEEK_SET) == 0) && (ftruncate(ring->fd, 0) == 0) &&
+		write_all(ring->fd, &header, sizeof(header)) &&
+		write_all(ring->fd, ring->prog->ops, ring->prog->len * sizeof(*ring->prog->ops)) &&
+		write_all(ring->fd, ring->recs + first, tail * sizeof(*ring->recs)) &&
+		write_all(ring->fd, ring->recs, (num - tail) * sizeof(*ring->recs));
+}
+
+void trace_free(struct trace_ring *ring) {
+	if (!ring)
+		return;
+	if (live_ring == ring) {
+		live_ring = NULL;
+		for (size_t i = 0; i < NUM_FATAL_SIGNALS; i++)
+			signal(fatal_signals[i], SIG_DFL);
+		signal(SIGUSR2, SIG_DFL);
+	}
+	if (ring->fd >= 0)
+		close(ring->fd);
+	free(ring->recs);
+	free(ring);
+}
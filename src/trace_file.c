@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+#include "trace.h"
+#include "utils.h"
+
+static void op_text(const struct bf_op *op, char *buf, size_t len) {
+	switch (op->op) {
+	case BF_ADD:
+		snprintf(buf, len, "%c%d", (op->arg < 0) ? '-' : '+', abs(op->arg));
+		break;
+	case BF_MOVE:
+		snprintf(buf, len, "%c%d", (op->arg < 0) ? '<' : '>', abs(op->arg));
+		break;
+	case BF_OUT:
+		snprintf(buf, len, ".");
+		break;
+	case BF_IN:
+		snprintf(buf, len, ",");
+		break;
+	case BF_JZ:
+		snprintf(buf, len, "[");
+		break;
+	case BF_JNZ:
+		snprintf(buf, len, "]");
+		break;
+	case BF_CLEAR:
+		snprintf(buf, len, "[-]");
+		break;
+	case BF_END:
+		snprintf(buf, len, "end");
+		break;
+	case BF_TRAP:
+		snprintf(buf, len, "trap");
+		break;
+	case BF_PAR:
+		snprintf(buf, len, "par");
+		break;
+	}
+}
+
+// line_of[i] / col_of[i] for every source offset, if we have the source
+static void index_lines(const char *src, long len, int *line_of, int *col_of) {
+	int line = 1, col = 1;
+	for (long i = 0; i <= len; i++) {
+		line_of[i] = line;
+		col_of[i] = col++;
+		if ((i < len) && (src[i] == '\n')) {
+			line++;
+			col = 1;
+		}
+	}
+}
+
+// usage: bfTrace dump [source.bf] [-n last]
+int main(int argc, char *argv[]) {
+	const char *dump = NULL, *source = NULL;
+	unsigned long long last = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			last = strtoull(argv[++i], NULL, 10);
+		else if (!dump)
+			dump = argv[i];
+		else
+			source = argv[i];
+	}
+	if (!dump)
+		raise_error(ERR_NO_ARGS);
+
+	FILE *fp = fopen(dump, "rb");
+	if (!fp)
+		raise_error(ERR_NO_FILE);
+
+	struct trace_header header;
+	if ((fread(&header, sizeof(header), 1, fp) != 1) || memcmp(header.magic, TRACE_MAGIC, 4) ||
+			(header.version != TRACE_VERSION) || (header.rec_size != sizeof(struct trace_rec)))
+		raise_error(ERR_INV_VAL);
+
+	struct bf_op *ops = calloc(header.num_ops + 1, sizeof(*ops));
+	struct trace_rec *recs = calloc(header.num_recs + 1, sizeof(*recs));
+	if (!ops || !recs)
+		raise_error(ERR_NO_MEM);
+	if ((fread(ops, sizeof(*ops), header.num_ops, fp) != header.num_ops) ||
+			(fread(recs, sizeof(*recs), header.num_recs, fp) != header.num_recs))
+		raise_error(ERR_EOF);
+	fclose(fp);
+
+	long src_len = 0;
+	char *src = source ? bf_read_source(source, &src_len) : NULL;
+	int *line_of = src ? calloc(src_len + 1, sizeof(*line_of)) : NULL;
+	int *col_of = src ? calloc(src_len + 1, sizeof(*col_of)) : NULL;
+	if (source && (!src || !line_of || !col_of))
+		raise_error(src ? ERR_NO_MEM : ERR_NO_FILE);
+	if (src)
+		index_lines(src, src_len, line_of, col_of);
+
+	printf("trace: %llu steps run, last %llu recorded\n",
+		(unsigned long long) header.total, (unsigned long long) header.num_recs);
+
+	unsigned long long start = (last && (last < header.num_recs)) ? header.num_recs - last : 0;
+	unsigned long long first_step = header.total - header.num_recs + 1;
+	for (unsigned long long i = start; i < header.num_recs; i++) {
+		const struct trace_rec *rec = recs + i;
+		if (rec->pc >= header.num_ops)
+			raise_error(ERR_INV_VAL);
+		const struct bf_op *op = ops + rec->pc;
+
+		char text[32];
+		op_text(op, text, sizeof(text));
+		printf("%12llu  @%-6d %-6s ptr %-5u cell %d", first_step + i, op->src, text, rec->ptr, rec->cell);
+		if (src && (op->src <= src_len))
+			printf("  (line %d, col %d)", line_of[op->src], col_of[op->src]);
+		printf("\n");
+	}
+
+	free(line_of);
+	free(col_of);
+	free(src);
+	free(ops);
+	free(recs);
+	return 0;
+}
@@ -10,6 +10,7 @@
 #include "structs.h"
 #include "utils.h"
 #include "stmt.h"
+#include "flat_ast.h"
 #include "ir.h"
 #include "lexer.h"
 #include "semantics.h"
@@ -105,22 +106,23 @@ void _raise_syntax_error(enum err_type err, const char *func, const char *file,
 		fprintf(stderr, "  " ANSI_RED "%s" ANSI_RESET "\n", get_error_message(err));
 		
 		// Print the source line with line number
-		if (lex->line_buf && lex->line_buf[0]) {
+		const char *line_end = lex->line_start;
+		while (line_end && (line_end < lex->end) && (*line_end != '\n') && *line_end)
+			line_end++;
+		if (lex->line_start && (lex->ch != EOF)) {
 		fprintf(stderr, "\n");
 		
 		// Print line number in cyan
 		fprintf(stderr, ANSI_CYAN "%5d | " ANSI_RESET, lex->line_num);
 		
 		// Print the line
-		for (int i = 0; lex->line_buf[i] && lex->line_buf[i] != '\n'; i++) {
-			fputc(lex->line_buf[i], stderr);
-		}
+		fwrite(lex->line_start, 1, line_end - lex->line_start, stderr);
 		fprintf(stderr, "\n");
 		
 		// Print underline with proper offset for line number
 		fprintf(stderr, "      | ");
-		for (int i = 0; i < error_start; i++) {
-			fputc(lex->line_buf[i] == '\t' ? '\t' : ' ', stderr);
+		for (int i = 0; (i < error_start) && (lex->line_start + i < line_end); i++) {
+			fputc(lex->line_start[i] == '\t' ? '\t' : ' ', stderr);
 		}
 		
 		// Print underline in bold red
@@ -217,16 +219,13 @@ static void _raise_semantic_error(enum err_type err, int line_num, int start_col
 	error_exit_handler(err);
 }
 
-void _raise_exp_semantic_error(enum err_type err, const struct exp *exp, const char *func, const char *file, int line, struct env *env) {
-	_raise_semantic_error(err, exp->line_num, exp->start_col, func, file, line, env);
-}
-
-void _raise_stmt_semantic_error(enum err_type err, const struct stmt *stmt, const char *func, const char *file, int line, struct env *env) {
-	_raise_semantic_error(err, stmt->line_num, stmt->start_col, func, file, line, env);
+void _raise_node_semantic_error(enum err_type err, uint32_t node, const char *func, const char *file, int line, struct env *env) {
+	_raise_semantic_error(err, env->ast->line[node], env->ast->col[node], func, file, line, env);
 }
 
 void _raise_ir_error(enum err_type err, const char *func, const char *file, int line, struct ir_ctx *ctx) {
 	free_stmt(ctx->root);
+	free_flat_ast(ctx->ast);
 	free_ir_node(ctx->ir_root);
 	_raise_error(err, func, file, line);
 }
\ No newline at end of file
@@ -0,0 +1,200 @@
+/** @file walk.c
+ *  @brief Functions for walking the stmt tree without recursing.
+ *
+ *  This contains which children each kind of node has, the walk
+ *  itself (a loop over a stack of frames), and the two ways of
+ *  driving it: with a visitor, or two at once to compare trees.
+ *
+ *  @author Hawkins Peterson (hawkins03)
+ *  @bug No known bugs.
+ */
+
+#include <stdlib.h>
+#include "utils.h"
+#include "walk.h"
+
+static inline bool is_null(struct ast_node node) {
+	return node.is_stmt ? !node.stmt : !node.exp;
+}
+
+static int num_children(struct ast_node node) {
+	if (node.is_stmt) {
+		switch (node.stmt->type) {
+		case STMT_EMPTY:
+			return 0;
+		case STMT_EXPR:
+			return 1;
+		case STMT_VAR:
+		case STMT_LOOP:
+			return 2;
+		case STMT_IF:
+			return 3;
+		}
+		return 0;
+	}
+
+	switch (node.exp->type) {
+	case EXP_EMPTY:
+	case EXP_NAME:
+	case EXP_NUM:
+		return 0;
+	case EXP_UNARY:
+	case EXP_CALL:
+		return 1;
+	case EXP_ASSIGN_OP:
+	case EXP_BINARY_OP:
+	case EXP_ARRAY_REF:
+		return 2;
+	case EXP_ARRAY_LIT:
+		return node.exp->array_lit->size;
+	}
+	return 0;
+}
+
+// child i of node, which num_children says is there
+static struct ast_node child_of(struct ast_node node, int i) {
+	if (node.is_stmt) {
+		const struct stmt *stmt = node.stmt;
+		switch (stmt->type) {
+		case STMT_VAR:
+			return exp_node(i ? stmt->var->value : stmt->var->name);
+		case STMT_LOOP:
+			return i ? stmt_node(stmt->loop->body) : exp_node(stmt->loop->cond);
+		case STMT_IF:
+			if (!i)
+				return exp_node(stmt->ifStmt->cond);
+			return stmt_node((i == 1) ? stmt->ifStmt->thenStmt : stmt->ifStmt->elseStmt);
+		case STMT_EXPR:
+			return exp_node(stmt->exp);
+		case STMT_EMPTY:
+			break;
+		}
+		return stmt_node(NULL);
+	}
+
+	const struct exp *exp = node.exp;
+	switch (exp->type) {
+	case EXP_ASSIGN_OP:
+	case EXP_BINARY_OP:
+		return exp_node(i ? exp->op->right : exp->op->left);
+	case EXP_UNARY:
+		return exp_node(exp->unary->operand);
+	case EXP_CALL:
+		return exp_node(exp->call->arg);
+	case EXP_ARRAY_REF:
+		return exp_node(i ? exp->array_ref->index : exp->array_ref->name);
+	case EXP_ARRAY_LIT:
+		return exp_node(exp->array_lit->array + i);
+	case EXP_EMPTY:
+	case EXP_NAME:
+	case EXP_NUM:
+		break;
+	}
+	return exp_node(NULL);
+}
+
+static void push(struct ast_walk *walk, struct ast_node node) {
+	if (walk->num_frames >= walk->frames_cap) {
+		size_t cap = walk->frames_cap ? walk->frames_cap * 2 : WALK_START_CAP;
+		struct walk_frame *frames = realloc(walk->frames, cap * sizeof(*frames));
+		if (!frames)
+			raise_error(ERR_NO_MEM);
+		walk->frames = frames;
+		walk->frames_cap = cap;
+	}
+	walk->frames[walk->num_frames++] = (struct walk_frame) { .node = node, .pos = 0 };
+}
+
+void ast_walk_start(struct ast_walk *walk, struct ast_node root) {
+	walk->frames = NULL;
+	walk->num_frames = walk->frames_cap = 0;
+	if (!is_null(root))
+		push(walk, root);
+}
+
+// a frame's pos goes 0 for the WALK_PRE, then two for each child
+// (a WALK_IN if it's not the first, then going into it), then the WALK_POST
+bool ast_walk_next(struct ast_walk *walk, struct walk_step *step) {
+	while (walk->num_frames) {
+		struct walk_frame *top = walk->frames + walk->num_frames - 1;
+		struct ast_node node = top->node;
+		int pos = top->pos++, children = num_children(node);
+
+		if (!pos) {
+			*step = (struct walk_step) { .event = WALK_PRE, .node = node };
+			return true;
+		}
+		if (pos > 2 * children) {
+			*step = (struct walk_step) { .event = WALK_POST, .node = node, .child = children };
+			// the statement after it takes its frame (the root is looped to itself at first)
+			const struct stmt *next = node.is_stmt ? node.stmt->next : NULL;
+			if (next && (next != node.stmt))
+				*top = (struct walk_frame) { .node = stmt_node(next), .pos = 0 };
+			else
+				walk->num_frames--;
+			return true;
+		}
+
+		int child = (pos - 1) / 2;
+		if (pos % 2) {
+			if (child) {
+				*step = (struct walk_step) { .event = WALK_IN, .node = node, .child = child };
+				return true;
+			}
+		} else {
+			struct ast_node next = child_of(node, child);
+			if (!is_null(next))
+				push(walk, next);
+		}
+	}
+	return false;
+}
+
+void ast_walk_end(struct ast_walk *walk) {
+	free(walk->frames);
+	walk->frames = NULL;
+	walk->num_frames = walk->frames_cap = 0;
+}
+
+void ast_walk(struct ast_node root, const struct ast_visitor *visitor, void *data) {
+	struct ast_walk walk;
+	struct walk_step step;
+	ast_walk_start(&walk, root);
+	while (ast_walk_next(&walk, &step)) {
+		switch (step.event) {
+		case WALK_PRE:
+			if (visitor->pre)
+				visitor->pre(step.node, data);
+			break;
+		case WALK_IN:
+			if (visitor->in)
+				visitor->in(step.node, step.child, data);
+			break;
+		case WALK_POST:
+			if (visitor->post)
+				visitor->post(step.node, data);
+			break;
+		}
+	}
+	ast_walk_end(&walk);
+}
+
+bool ast_walks_match(struct ast_node a, struct ast_node b, bool (*match)(struct ast_node, struct ast_node)) {
+	struct ast_walk walk_a, walk_b;
+	struct walk_step step_a, step_b;
+	ast_walk_start(&walk_a, a);
+	ast_walk_start(&walk_b, b);
+
+	bool same, more;
+	do {
+		more = ast_walk_next(&walk_a, &step_a);
+		same = (more == ast_walk_next(&walk_b, &step_b));
+		if (same && more)
+			same = (step_a.event == step_b.event) && (step_a.child == step_b.child) &&
+				((step_a.event != WALK_PRE) || match(step_a.node, step_b.node));
+	} while (same && more);
+
+	ast_walk_end(&walk_a);
+	ast_walk_end(&walk_b);
+	return same;
+}